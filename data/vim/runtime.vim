@@ -3,6 +3,17 @@
 let g:eovim_running = 1
 
 function! Eovim(request, ...)
+   " Attached through a socket (eovim --server), there is no standard output
+   " to write to
+   if exists('g:eovim_channel')
+      if (a:0 == 0)
+         call rpcnotify(g:eovim_channel, 'eovim', [a:request])
+      else
+         call rpcnotify(g:eovim_channel, 'eovim', [a:request, a:000])
+      endif
+      return
+   endif
+
    let l:file = '/dev/stdout'
    if (a:0 == 0)
       call writefile(msgpackdump([[2, 'eovim', [[a:request]]]]), l:file, 'ab')
@@ -11,17 +22,41 @@ function! Eovim(request, ...)
    endif
 endfunction
 
-let g:eovim_theme_bell_enabled = 0
-let g:eovim_theme_react_to_key_presses = 1
-let g:eovim_theme_react_to_caps_lock = 1
-let g:eovim_cursor_cuts_ligatures = 1
+command! -nargs=+ Eovim call Eovim(<f-args>)
+
+" Eovim talks to neovim through its standard input and output
+function! s:EovimChannel()
+   for l:chan in nvim_list_chans()
+      if get(l:chan, 'stream', '') ==# 'stdio'
+         return l:chan.id
+      endif
+   endfor
+   return 0
+endfunction
+
+" Eovim loads its configuration when it receives this (blocking) request,
+" before anything is displayed
+augroup EovimStartup
+   autocmd!
+   autocmd VimEnter * call rpcrequest(s:EovimChannel(), 'vimenter')
+augroup END
+
+" Eovim may attach (eovim --server) to a neovim that has already sourced the
+" user's configuration: the defaults below must not replace it
+let g:eovim_theme_bell_enabled = get(g:, 'eovim_theme_bell_enabled', 0)
+let g:eovim_theme_react_to_key_presses = get(g:, 'eovim_theme_react_to_key_presses', 1)
+let g:eovim_theme_react_to_caps_lock = get(g:, 'eovim_theme_react_to_caps_lock', 1)
+let g:eovim_cursor_cuts_ligatures = get(g:, 'eovim_cursor_cuts_ligatures', 1)
+
+let g:eovim_cursor_animated = get(g:, 'eovim_cursor_animated', 1)
+let g:eovim_cursor_animation_duration = get(g:, 'eovim_cursor_animation_duration', 0.05)
+let g:eovim_cursor_animation_style = get(g:, 'eovim_cursor_animation_style', 'accelerate')
 
-let g:eovim_cursor_animated = 1
-let g:eovim_cursor_animation_duration = 0.05
-let g:eovim_cursor_animation_style = 'accelerate'
+let g:eovim_render_immediately = get(g:, 'eovim_render_immediately', 0)
 
 
-let g:eovim_theme_completion_styles = {
+if !exists('g:eovim_theme_completion_styles')
+   let g:eovim_theme_completion_styles = {
 	\ 'default': 'font_weight=bold color=#ffffff',
 	\ 'm': 'color=#ff00ff',
 	\ 'v': 'color=#00ffff',
@@ -29,25 +64,28 @@ let g:eovim_theme_completion_styles = {
 	\ 't': 'color=#0000ff',
 	\ 'd': 'color=#0000ff',
 	\}
+endif
 
 
-highlight EovimCmdlineDefault gui=bold guifg=#a7a7ff guibg=#00007f
-highlight EovimCmdlineSearch gui=bold guifg=#ffffa7 guibg=#7f7f00
-highlight EovimCmdlineReverseSearch gui=bold guifg=#ffcca7 guibg=#7f3500
-highlight EovimCmdlineCommand gui=bold guifg=#ffa7d9 guibg=#7f0048
+highlight default EovimCmdlineDefault gui=bold guifg=#a7a7ff guibg=#00007f
+highlight default EovimCmdlineSearch gui=bold guifg=#ffffa7 guibg=#7f7f00
+highlight default EovimCmdlineReverseSearch gui=bold guifg=#ffcca7 guibg=#7f3500
+highlight default EovimCmdlineCommand gui=bold guifg=#ffa7d9 guibg=#7f0048
 
-let g:eovim_theme_cmdline_styles = {
+if !exists('g:eovim_theme_cmdline_styles')
+   let g:eovim_theme_cmdline_styles = {
 	\ 'default': 'EovimCmdlineDefault',
 	\ '/': 'EovimCmdlineSearch',
 	\ '?': 'EovimCmdlineReverseSearch',
 	\ ':': 'EovimCmdlineCommand',
 	\}
+endif
 
 
-let g:eovim_ext_tabline = 1
-let g:eovim_ext_popupmenu = 1
-let g:eovim_ext_cmdline = 1
-let g:eovim_ext_multigrid = 0
+let g:eovim_ext_tabline = get(g:, 'eovim_ext_tabline', 1)
+let g:eovim_ext_popupmenu = get(g:, 'eovim_ext_popupmenu', 1)
+let g:eovim_ext_cmdline = get(g:, 'eovim_ext_cmdline', 1)
+let g:eovim_ext_multigrid = get(g:, 'eovim_ext_multigrid', 0)
 
 augroup Eovim
    autocmd User EovimReady :
@@ -0,0 +1,49 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#ifndef __EOVIM_ARENA_H__
+#define __EOVIM_ARENA_H__
+
+#include <Eina.h>
+#include <stddef.h>
+
+/**
+ * @file arena.h
+ *
+ * A bump allocator for the data that only lives while a batch of events is
+ * decoded (e.g. NUL-terminated copies of msgpack strings). It is reset at the
+ * end of each batch. When a batch needs more than the arena holds, the
+ * excess is allocated on the heap, and the arena grows on the next reset, so
+ * the following batches don't allocate anything.
+ */
+
+struct arena {
+	char *mem;
+	size_t size; /**< Bytes available in mem */
+	size_t used; /**< Bytes of mem handed out since the last reset */
+	size_t wanted; /**< Bytes asked for since the last reset */
+	struct arena_block *overflow; /**< Allocated when mem was full */
+};
+
+/**
+ * @return @p size bytes, suitably aligned for any type, that are valid until
+ *   the next arena_reset(), or NULL on failure
+ */
+void *arena_alloc(struct arena *arena, size_t size);
+
+/**
+ * @return A NUL-terminated copy of the @p size bytes of @p str, that is valid
+ *   until the next arena_reset(), or NULL on failure
+ */
+char *arena_strndup(struct arena *arena, const char *str, size_t size);
+
+/**
+ * Invalidate everything that was allocated from @p arena
+ */
+void arena_reset(struct arena *arena);
+
+/**
+ * Release the memory of @p arena. It can be used again afterwards.
+ */
+void arena_free(struct arena *arena);
+
+#endif /* ! __EOVIM_ARENA_H__ */
@@ -0,0 +1,50 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#ifndef __EOVIM_FONT_CACHE_H__
+#define __EOVIM_FONT_CACHE_H__
+
+#include <Eina.h>
+#include <Evas.h>
+
+/**
+ * @file font_cache.h
+ *
+ * Measuring the cells of a font means loading it in a textgrid, and laying a
+ * line of the textblock out. The metrics of each font, size and linegap that
+ * was measured are kept, and saved on disk with Eet when eovim exits, so
+ * zooming back and forth, or starting eovim again, measures nothing.
+ *
+ * The metrics also depend on how the canvas renders the fonts (its DPI, the
+ * scale and the hinting) and on the file fontconfig resolves the font to:
+ * they are part of the key, so a change of screen or an upgrade of the font
+ * measures the cells again.
+ */
+
+struct font_metrics {
+	unsigned int cell_w; /**< Width of a cell, in pixels */
+	unsigned int cell_h; /**< Height of a cell of a textgrid, in pixels */
+	unsigned int line_h; /**< Height of a line of a textblock, or 0 if not measured */
+};
+
+Eina_Bool font_cache_init(void);
+void font_cache_shutdown(void);
+
+/**
+ * @param[in] obj An object of the canvas the font is rendered on
+ * @param[in] font The name of the font, as the textblock style wants it
+ * @param[in] size The size of the font
+ * @param[in] linegap The extra space between the lines of a textblock
+ * @param[out] metrics Filled with the metrics that were measured
+ * @return EINA_TRUE if the metrics are known, EINA_FALSE otherwise
+ */
+Eina_Bool font_cache_get(const Evas_Object *obj, const char *font, unsigned int size,
+			 unsigned int linegap, struct font_metrics *metrics);
+
+/**
+ * Remember the @p metrics of a font, for this instance and the next ones. The
+ * parameters are those of font_cache_get().
+ */
+void font_cache_set(const Evas_Object *obj, const char *font, unsigned int size,
+		    unsigned int linegap, const struct font_metrics *metrics);
+
+#endif /* ! __EOVIM_FONT_CACHE_H__ */
@@ -26,6 +26,7 @@ struct gui {
 	} font;
 
 	union color default_fg;
+	unsigned int width_flags; /**< enum unicode_width_flags, from 'ambiwidth' and 'emoji' */
 
 	/* Configuration parameters of the theme */
 	struct {
@@ -36,15 +37,32 @@ struct gui {
 		Eina_Bool cursor_animated;
 		double cursor_animation_duration;
 		Ecore_Pos_Map cursor_animation_style;
+		/* Apply the grid changes as soon as neovim flushes them, instead
+		 * of once per frame */
+		Eina_Bool render_immediately;
 	} theme;
 
 	struct nvim *nvim;
-	Eina_Inarray *tabs;
+	Eina_Inarray *tabs; /**< The tabs, as they are ordered in the tabline */
+	unsigned int tabs_updated; /**< Tabs already visited by the current update */
+	Eina_Bool tabs_shown;
 
 	/** Keep track of how many times gui_busy_set() was called. This prevents
     * useless calls to the theme or nested set issues */
 	int busy_count;
 
+	/* Idle power mode: while the window is unfocused or iconified, nothing
+	 * animates, and the main loop only wakes up when neovim talks */
+	struct {
+		Ecore_Idle_Exiter *exiter; /**< Counts the wakeups of the main loop */
+		uint64_t wakeups; /**< Wakeups since the GUI was created */
+		uint64_t reported; /**< Wakeups at the time of the last report */
+		double since; /**< Time of the last report */
+		Eina_Bool focused;
+		Eina_Bool iconified;
+		Eina_Bool idle;
+	} power;
+
 	/** True when the caps lock warning is on, False otherwise */
 	Eina_Bool capslock_warning;
 	unsigned int active_tab; /**< Identifier of the active tab */
@@ -68,13 +86,29 @@ void gui_shutdown(void);
 void gui_completion_shutdown(void);
 void gui_wildmenu_shutdown(void);
 
-void gui_wildmenu_append(struct gui *gui, Eina_Stringshare *item);
+/**
+ * Allocate the storage of the wildmenu items that are about to be appended,
+ * like gui_completion_reserve() does. The items shown until now are removed.
+ *
+ * @param[in] count How many items will be appended
+ * @param[in] bytes The size of all their strings (without terminators)
+ */
+Eina_Bool gui_wildmenu_reserve(struct gui *gui, unsigned int count, size_t bytes);
+void gui_wildmenu_append(struct gui *gui, const char *item, uint32_t size);
 void gui_wildmenu_show(struct gui *gui, unsigned int pos);
 
+/**
+ * Allocate the storage of the completion items that are about to be appended.
+ * It replaces the items that were stored until now.
+ *
+ * @param[in] count How many items will be appended
+ * @param[in] bytes The size of all their strings (without terminators)
+ */
+Eina_Bool gui_completion_reserve(struct gui *gui, unsigned int count, size_t bytes);
 void gui_completion_append(struct gui *gui, const char *word, uint32_t word_size, const char *kind,
 			   uint32_t kind_size, const char *menu, uint32_t menu_size,
 			   const char *info, uint32_t info_size);
-void gui_completion_show(struct gui *gui, unsigned int col, unsigned int row);
+void gui_completion_show(struct gui *gui, t_int grid, unsigned int col, unsigned int row);
 
 Eina_Bool gui_add(struct gui *gui, struct nvim *nvim);
 void gui_del(struct gui *gui);
@@ -101,8 +135,21 @@ void gui_title_set(struct gui *gui, const char *title);
 void gui_font_set(struct gui *gui, const char *font_name, unsigned int font_size);
 void gui_font_size_update(struct gui *gui, long new_size);
 
-void gui_tabs_reset(struct gui *gui);
-void gui_tabs_add(struct gui *gui, const char *name, unsigned int id, Eina_Bool active);
+/**
+ * Start an update of the tabline. Each tab, from left to right, is then given
+ * to gui_tabs_update(), and gui_tabs_update_end() closes the update.
+ *
+ * Tabs are identified by their neovim handle: their widgets are kept across
+ * updates, and only what changed is modified.
+ */
+void gui_tabs_update_begin(struct gui *gui);
+void gui_tabs_update(struct gui *gui, Eina_Stringshare *name, unsigned int id, Eina_Bool active);
+
+/**
+ * Remove the tabs that were not given to gui_tabs_update() since the update
+ * started
+ */
+void gui_tabs_update_end(struct gui *gui);
 void gui_tabs_show(struct gui *gui);
 void gui_tabs_hide(struct gui *gui);
 
@@ -110,6 +157,16 @@ void gui_caps_lock_alert(struct gui *gui);
 void gui_caps_lock_dismiss(struct gui *gui);
 Eina_Bool gui_caps_lock_warning_get(const struct gui *gui);
 
+/**
+ * Report how often the main loop woke up since the last call
+ *
+ * @param[out] total Wakeups since the GUI was created
+ * @param[out] per_minute Wakeups per minute since the last call (or since the
+ *   GUI was created, for the first one)
+ * @return EINA_TRUE if the window is in idle power mode
+ */
+Eina_Bool gui_wakeups_get(struct gui *gui, uint64_t *total, double *per_minute);
+
 void gui_ready_set(struct gui *gui);
 void gui_mode_update(struct gui *gui, const struct mode *mode);
 Eina_Bool gui_cmdline_enabled_get(const struct gui *gui);
@@ -3,6 +3,7 @@
 #ifndef __MPACK_HELPER_H__
 #define __MPACK_HELPER_H__
 
+#include "eovim/arena.h"
 #include <Eina.h>
 #include <msgpack.h>
 
@@ -51,6 +52,16 @@
 		eina_stringshare_add_length((Obj)->via.str.ptr, (Obj)->via.str.size);              \
 	})
 
+/**
+ * Retrieve a NUL-terminated copy of the string of a msgpack object @a Obj,
+ * allocated in @a Arena (see arena.h). It is NULL if the copy failed.
+ */
+#define MPACK_STRING_ARENA_EXTRACT(Obj, Arena, OnFail)                                             \
+	({                                                                                         \
+		MPACK_STRING_CHECK(Obj, OnFail);                                                   \
+		arena_strndup(Arena, (Obj)->via.str.ptr, (Obj)->via.str.size);                     \
+	})
+
 #define MPACK_STRING_OBJ_EXTRACT(Obj, OnFail)                                                      \
 	({                                                                                         \
 		MPACK_STRING_CHECK(Obj, OnFail);                                                   \
@@ -92,4 +103,14 @@ static inline Eina_Bool _msgpack_streq(const msgpack_object_str *const str, cons
 #define _MSGPACK_STREQ(MsgPackStr, StaticStr)                                                      \
 	_msgpack_streq(MsgPackStr, "" StaticStr "", sizeof(StaticStr) - 1u)
 
+/**
+ * Exact comparison of a msgpack string @p str with a string @p with of @p len
+ * bytes. Sizes are compared first, so most mismatches bail out early.
+ */
+static inline Eina_Bool _msgpack_str_is(const msgpack_object_str *const str, const char *const with,
+					const size_t len)
+{
+	return (str->size == len) && (0 == memcmp(str->ptr, with, len));
+}
+
 #endif /* ! __MPACK_HELPER_H__ */
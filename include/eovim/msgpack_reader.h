@@ -0,0 +1,125 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#ifndef __EOVIM_MSGPACK_READER_H__
+#define __EOVIM_MSGPACK_READER_H__
+
+#include <Eina.h>
+#include <msgpack.h>
+#include <stdint.h>
+
+/**
+ * @file msgpack_reader.h
+ *
+ * A reader of msgpack data, that decodes the bytes as they come without
+ * building any msgpack_object. Strings point within the read data. It is used
+ * on the hot path of the redraw events, where msgpack_unpacker_next() would
+ * allocate a full tree of objects for each notification.
+ *
+ * The functions below do not advance the reader when they fail, which happens
+ * when the data is of another type or is truncated.
+ */
+
+struct mpack_reader {
+	const uint8_t *ptr; /**< Next byte to be read */
+	const uint8_t *end; /**< End of the data (exclusive) */
+};
+
+static inline void mpack_reader_init(struct mpack_reader *const reader, const void *const data,
+				     const size_t size)
+{
+	reader->ptr = data;
+	reader->end = reader->ptr + size;
+}
+
+/** Read the header of an array, which holds @p size elements */
+Eina_Bool mpack_reader_array(struct mpack_reader *reader, uint32_t *size);
+
+/** Read a (positive or negative) integer */
+Eina_Bool mpack_reader_int(struct mpack_reader *reader, int64_t *value);
+
+/** Read a string (STR or BIN). @p str points within the read data. */
+Eina_Bool mpack_reader_str(struct mpack_reader *reader, msgpack_object_str *str);
+
+/** Skip an object, whatever its type, including all of its children */
+Eina_Bool mpack_reader_skip(struct mpack_reader *reader);
+
+enum mpack_scan_status {
+	MPACK_SCAN_DONE, /**< The object was entirely received */
+	MPACK_SCAN_TRUNCATED, /**< More bytes are needed */
+	MPACK_SCAN_INVALID, /**< The bytes are not msgpack */
+};
+
+/**
+ * The progress in the scan of an object that may not have been received
+ * entirely. It is relative to the start of the object, which may move in
+ * memory between two scans (e.g. when a buffer is reallocated).
+ */
+struct mpack_scan {
+	size_t offset; /**< Bytes of the object already scanned */
+	uint64_t pending; /**< Objects that remain to be scanned from there */
+};
+
+static inline void mpack_scan_init(struct mpack_scan *const scan)
+{
+	scan->offset = 0u;
+	scan->pending = 1u;
+}
+
+/**
+ * Find the end of the object that starts at @p data, resuming a previous scan.
+ * The bytes that were scanned already are not read again, so an object that
+ * arrives in many pieces costs one pass over it.
+ *
+ * @param[in] data The start of the object
+ * @param[in] size The bytes of the object received so far
+ * @param[in,out] scan The progress of the scan. Once the object is done, its
+ *   offset is the size of the object.
+ */
+enum mpack_scan_status mpack_scan(const void *data, size_t size, struct mpack_scan *scan);
+
+/**
+ * A buffer of the bytes received from a peer, cut into messages. It owns the
+ * bytes, so the messages can be decoded in place, or handed to
+ * msgpack_unpack_next(), without relying on the internals of the unpacker of
+ * msgpack-c. The message that is not entirely received yet is kept, and its
+ * scan resumes when more bytes arrive.
+ */
+struct mpack_stream {
+	char *data;
+	size_t size; /**< Bytes allocated */
+	size_t used; /**< Bytes received */
+	size_t off; /**< Start of the next message */
+	struct mpack_scan scan; /**< Progress in the scan of the next message */
+};
+
+void mpack_stream_init(struct mpack_stream *stream);
+void mpack_stream_flush(struct mpack_stream *stream);
+
+/**
+ * Make room for @p size bytes to be received at the end of @p stream
+ *
+ * @param[out] capacity How many bytes may be written, at least @p size
+ * @return Where to write the bytes, or NULL on allocation failure
+ */
+char *mpack_stream_reserve(struct mpack_stream *stream, size_t size, size_t *capacity);
+
+/** Account for @p size bytes written where mpack_stream_reserve() said */
+static inline void mpack_stream_consumed(struct mpack_stream *const stream, const size_t size)
+{
+	stream->used += size;
+}
+
+/**
+ * Get the next message of @p stream, if it was entirely received
+ *
+ * @param[out] msg The first byte of the message. It stays valid until the next
+ *   call to mpack_stream_reserve().
+ * @param[out] size The size of the message
+ * @return MPACK_SCAN_DONE if a message was extracted, MPACK_SCAN_TRUNCATED if
+ *   more bytes must be received first, MPACK_SCAN_INVALID if the stream is
+ *   not msgpack. It cannot be recovered from there.
+ */
+enum mpack_scan_status mpack_stream_next(struct mpack_stream *stream, const char **msg,
+					 size_t *size);
+
+#endif /* ! __EOVIM_MSGPACK_READER_H__ */
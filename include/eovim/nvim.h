@@ -4,12 +4,15 @@
 #define __EOVIM_NVIM_H__
 
 #include <eovim/types.h>
+#include <eovim/arena.h>
 #include <eovim/nvim_helper.h>
 #include <eovim/gui.h>
+#include <eovim/msgpack_reader.h>
 
 #include <Eina.h>
 #include <Ecore.h>
 #include <msgpack.h>
+#include <stdio.h>
 
 #define NVIM_VERSION_MAJOR(Nvim) ((Nvim)->version.major)
 #define NVIM_VERSION_MINOR(Nvim) ((Nvim)->version.minor)
@@ -19,26 +22,87 @@
 	(NVIM_VERSION_MAJOR(Nvim) == (Major) && NVIM_VERSION_MINOR(Nvim) == (Minor) &&             \
 	 NVIM_VERSION_PATCH(Nvim) == (Patch))
 
+struct nvim_io_stats {
+	uint64_t received; /**< Bytes received from neovim */
+	uint64_t copied; /**< Bytes that have been copied before being unpacked */
+	double since; /**< Timestamp of the last report */
+};
+
+/* How the packed messages are sent to neovim: through the pipe to its
+ * standard input, or through a socket (--server). What neovim sends is read
+ * from read_fd in both cases. */
+struct nvim_transport {
+	/* All the bytes must be sent, or be queued until they can be */
+	Eina_Bool (*send)(void *data, const void *bytes, size_t size);
+	void (*free)(void *data); /**< Optional */
+	void *data;
+};
+
 struct nvim {
 	struct gui gui;
 	struct version version; /**< The neovim's version */
 	uint64_t channel;
 	const struct options *opts;
 
-	Ecore_Exe *exe;
+	Ecore_Exe *exe; /**< NULL when attached to a server, or replayed */
+	struct nvim_transport transport; /**< Unset when the stream is replayed */
+	FILE *record; /**< Where the received bytes are copied (--record) */
 
-	Ecore_Event_Handler *event_handlers[4];
-	Eina_Inlist *requests;
+	/* Read end of the pipe connected to neovim's standard output, or the
+	 * socket. When it is negative, we rely on the ECORE_EXE_EVENT_DATA event
+	 * instead */
+	int read_fd;
+	Ecore_Fd_Handler *read_handler;
+	struct nvim_io *io; /**< Reads and unpacks in a thread (--io-thread) */
+	struct nvim_io_stats io_stats;
 
-	msgpack_unpacker unpacker;
+	/* Milestones of the startup, in nanoseconds (see profile_time_get()).
+	 * They are zero until they are reached. */
+	struct {
+		uint64_t start; /**< nvim_new() was called */
+		uint64_t spawned; /**< The neovim process was spawned, or connected to */
+		uint64_t answered; /**< Neovim sent its capabilities */
+		uint64_t flushed; /**< The grids were flushed for the first time */
+	} startup;
+
+	Ecore_Event_Handler *event_handlers[4];
 
-	/* The following msgpack structures must be handled on the main loop only */
+	/* Requests waiting for a response from neovim. They are stored in a ring
+	 * whose size is a power of two, at the index (uid & mask). Uids are
+	 * monotonic, so two pending requests only collide when the oldest has
+	 * been waiting for as many requests as the ring can hold. The ring then
+	 * grows. */
+	struct {
+		struct request **ring;
+		uint32_t mask;
+		unsigned int in_flight; /**< Count of requests waiting for a response */
+		Ecore_Timer *timer; /**< Watches the requests that take too long */
+	} requests;
+
+	struct mpack_stream stream; /**< What neovim sent, cut into messages */
+	struct arena arena; /**< Temporary decoding data, reset after each batch */
+
+	/* The following msgpack structures must be handled on the main loop only.
+	 * Messages are packed in the buffer one after the other, and the buffer
+	 * is sent to neovim once per main loop iteration. */
 	msgpack_sbuffer sbuffer;
 	msgpack_packer packer;
 	uint32_t request_id;
+	Ecore_Idle_Enterer *flush_handler; /**< Set when a flush is scheduled */
+
+	/* Inputs (keys, mouse) that have not been packed yet. They are sent in a
+	 * single nvim_input request when the buffer is flushed, or before
+	 * another request is packed, so their order is kept. */
+	struct {
+		Eina_Strbuf *pending;
+		size_t motion_at; /**< Offset of the last input, if it is a motion */
+		Eina_Bool has_motion; /**< The last pending input is a motion */
+	} input;
 
 	Eina_Hash *modes;
 
+	/* Map of highlight group names to the identifiers of their styles, plus
+	 * one (NULL being a missing group) */
 	Eina_Hash *hl_groups;
 
 	/* Map of strings that associates to a kind identifier (used by completion) to
@@ -58,6 +122,15 @@ struct nvim {
 	} features;
 };
 
+/**
+ * Create a neovim instance, and its window
+ *
+ * @param[in] opts Eovim's options
+ * @param[in] args NULL-terminated list of arguments forwarded to neovim. When
+ *   @p args itself is NULL, no neovim process is spawned: the messages neovim
+ *   would have sent are provided by nvim_replay() instead.
+ * @return The neovim handle, or NULL on failure
+ */
 struct nvim *nvim_new(const struct options *opts, const char *const args[]);
 void nvim_free(struct nvim *nvim);
 uint32_t nvim_next_uid_get(struct nvim *nvim);
@@ -66,14 +139,69 @@ Eina_Bool nvim_mouse_enabled_get(const struct nvim *nvim);
 void nvim_attach(struct nvim *nvim);
 
 /**
- * Flush the msgpack buffer to the neovim instance, by writing to its standard
- * input
+ * Neovim closed its output stream. A spawned neovim is about to terminate,
+ * which is handled by ECORE_EXE_EVENT_DEL. The connection to a server is
+ * lost, and the window is closed.
+ *
+ * @param[in] nvim The neovim handle
+ */
+void nvim_output_closed(struct nvim *nvim);
+
+/**
+ * Flush the msgpack buffer to the neovim instance, through its transport
  *
  * @param[in] nvim The neovim handle
  * @return EINA_TRUE on success, EINA_FALSE on failure.
  */
 Eina_Bool nvim_flush(struct nvim *nvim);
 
+/**
+ * Schedule a flush of the msgpack buffer (see nvim_flush()) when the main loop
+ * is done with its current iteration. All the messages packed in the meantime
+ * are sent with a single write.
+ *
+ * @param[in] nvim The neovim handle
+ */
+void nvim_flush_schedule(struct nvim *nvim);
+
+/**
+ * Process @p size bytes of a msgpack stream as if they had been sent by
+ * neovim, e.g. a stream recorded with --record. The bytes don't have to end
+ * on a message boundary: incomplete messages are completed by the next call.
+ *
+ * @param[in] nvim The neovim handle
+ * @param[in] data The msgpack data
+ * @param[in] size Size of @p data, in bytes
+ * @return EINA_TRUE on success, EINA_FALSE on memory failure
+ */
+Eina_Bool nvim_replay(struct nvim *nvim, const void *data, size_t size);
+
+/**
+ * Check that @p obj is a msgpack-rpc message: a request, a response or a
+ * notification. This does not touch @p nvim, and can be called from any
+ * thread.
+ */
+Eina_Bool nvim_message_check(const msgpack_object *obj);
+
+/**
+ * Process the message @p obj, which passed nvim_message_check(). This must be
+ * called on the main loop.
+ */
+void nvim_message_handle(struct nvim *nvim, const msgpack_object *obj);
+
+/**
+ * Process the @p size bytes at @p data, which hold whole messages one after
+ * the other, as cut by mpack_stream_next(). Redraw notifications are decoded
+ * in place. This must be called on the main loop.
+ *
+ * @return EINA_FALSE if a message could not be processed
+ */
+Eina_Bool nvim_messages_handle(struct nvim *nvim, const char *data, size_t size);
+
+/* Account for bytes received from neovim, for --record and the statistics */
+void nvim_record(struct nvim *nvim, const void *data, size_t size);
+void nvim_io_stats_update(struct nvim *nvim, size_t received, size_t copied);
+
 struct mode *nvim_mode_new(void);
 void nvim_mode_free(struct mode *mode);
 
@@ -13,6 +13,31 @@ Eina_Bool nvim_api_get_api_info(struct nvim *nvim, f_nvim_api_cb cb, void *data)
 Eina_Bool nvim_api_ui_try_resize(struct nvim *nvim, unsigned int width, unsigned height);
 Eina_Bool nvim_api_ui_ext_set(struct nvim *nvim, const char *key, Eina_Bool enabled);
 Eina_Bool nvim_api_input(struct nvim *nvim, const char *input, size_t input_size);
+
+/**
+ * Same as nvim_api_input(), for inputs of which only the latest matters, such
+ * as mouse drags. If the previous pending input was a motion too, it is
+ * replaced by @p input instead of being sent.
+ */
+Eina_Bool nvim_api_input_motion(struct nvim *nvim, const char *input, size_t input_size);
+
+/**
+ * Send a mouse event that happened in the grid @p grid. This is required to
+ * designate grids other than the main one, with ext_multigrid.
+ *
+ * @param[in] button "left", "right", "middle" or "wheel"
+ * @param[in] action "press", "drag" or "release". For the wheel, "up" or "down"
+ */
+Eina_Bool nvim_api_input_mouse(struct nvim *nvim, const char *button, const char *action,
+			       t_int grid, unsigned int row, unsigned int col);
+
+/**
+ * Pack the pending inputs in a single nvim_input request. This is done
+ * automatically when the msgpack buffer is flushed.
+ *
+ * @param[in] nvim The neovim handle
+ */
+void nvim_api_input_pack(struct nvim *nvim);
 Eina_Bool nvim_api_get_var(struct nvim *nvim, const char *var, f_nvim_api_cb func, void *func_data);
 
 Eina_Bool nvim_api_eval(struct nvim *nvim, const char *input, size_t input_size, f_nvim_api_cb func,
@@ -23,11 +48,69 @@ Eina_Bool nvim_api_command_output(struct nvim *nvim, const char *input, size_t i
 Eina_Bool nvim_api_command(struct nvim *nvim, const char *input, size_t input_size,
 			   f_nvim_api_cb func, void *func_data);
 
+/**
+ * Run a multi-line vimscript @p src, as if it was sourced from a file. Its
+ * output is not captured.
+ */
+Eina_Bool nvim_api_exec(struct nvim *nvim, const char *src, size_t src_size, f_nvim_api_cb func,
+			void *func_data);
+
+/**
+ * @defgroup Batches Batches of API calls
+ *
+ * The calls of a batch are sent in a single nvim_call_atomic() request, and
+ * answered all at once. The callback of each call is then called with its own
+ * result, in order. When a call fails, neovim does not run the next ones, and
+ * their callbacks are not called.
+ *
+ * @{
+ */
+struct nvim_api_batch;
+
+struct nvim_api_batch *nvim_api_batch_new(struct nvim *nvim);
+
+/**
+ * Add a call to @p batch
+ *
+ * @param[in] batch The batch of calls
+ * @param[in] method Name of the API function. It MUST live as long as the
+ *   program (e.g. a literal).
+ * @param[in] args_count Number of arguments of the call
+ * @param[in] func Callback called with the result of the call. May be NULL.
+ * @param[in] func_data Context passed to @p func
+ * @return The packer where exactly @p args_count arguments MUST be packed,
+ *   or NULL on failure
+ */
+msgpack_packer *nvim_api_batch_call(struct nvim_api_batch *batch, const char *method,
+				    uint32_t args_count, f_nvim_api_cb func, void *func_data);
+
+/**
+ * Add the retrieval of the global variable @p var to @p batch. Unlike with
+ * nvim_api_get_var(), a variable that is not set does not fail: @p func is
+ * just not called.
+ */
+Eina_Bool nvim_api_batch_get_var(struct nvim_api_batch *batch, const char *var, f_nvim_api_cb func,
+				 void *func_data);
+
+/**
+ * Send the calls of @p batch. The batch is released, whatever happens.
+ */
+Eina_Bool nvim_api_batch_send(struct nvim_api_batch *batch);
+/** @} */
+
 struct request *nvim_api_request_find(const struct nvim *nvim, uint32_t req_id);
 void nvim_api_request_free(struct nvim *nvim, struct request *req);
 void nvim_api_request_call(struct nvim *nvim, const struct request *req,
 			   const msgpack_object *result);
 
+/**
+ * Drop all the requests that are still waiting for a response. Their
+ * callbacks are not called.
+ *
+ * @param[in] nvim The neovim handle
+ */
+void nvim_api_requests_free(struct nvim *nvim);
+
 Eina_Bool nvim_api_init(void);
 void nvim_api_shutdown(void);
 
@@ -0,0 +1,48 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#ifndef __EOVIM_NVIM_CACHE_H__
+#define __EOVIM_NVIM_CACHE_H__
+
+#include "eovim/types.h"
+#include <Eina.h>
+#include <limits.h>
+
+/**
+ * @file nvim_cache.h
+ *
+ * The capabilities of neovim (its version, and the UI options it supports)
+ * only change with its binary. They are cached on disk, with Eet, after they
+ * have been decoded from nvim_get_api_info(). The cache is keyed by the path
+ * of the neovim program, its size and its modification time.
+ */
+
+Eina_Bool nvim_cache_init(void);
+void nvim_cache_shutdown(void);
+
+/**
+ * Get the path of a cache file
+ *
+ * @param[in] name The name of the file (e.g. api-info.eet)
+ * @param[out] file The path of the file
+ * @param[out] dir The directory of the file, which may not exist yet
+ * @return EINA_TRUE on success, EINA_FALSE if there is no cache directory
+ */
+Eina_Bool nvim_cache_file_get(const char *name, char file[PATH_MAX], char dir[PATH_MAX]);
+
+/**
+ * Fill the version and the features of @p nvim from the cache
+ *
+ * @param[in,out] nvim The neovim handle
+ * @return EINA_TRUE if the cache was valid for the neovim program that runs,
+ *   EINA_FALSE otherwise. @p nvim is left untouched in the latter case.
+ */
+Eina_Bool nvim_cache_load(struct nvim *nvim);
+
+/**
+ * Store the version and the features of @p nvim in the cache
+ *
+ * @param[in] nvim The neovim handle
+ */
+void nvim_cache_save(const struct nvim *nvim);
+
+#endif /* ! __EOVIM_NVIM_CACHE_H__ */
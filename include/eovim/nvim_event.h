@@ -7,14 +7,31 @@
 #include <msgpack.h>
 
 struct method;
+struct mpack_reader;
 
 Eina_Bool nvim_event_init(void);
 void nvim_event_shutdown(void);
 
-const struct method *nvim_event_method_find(Eina_Stringshare *method_name);
+const struct method *nvim_event_method_find(const msgpack_object_str *method_name);
 Eina_Bool nvim_event_method_dispatch(struct nvim *nvim, const struct method *method,
-				     Eina_Stringshare *command, const msgpack_object_array *args);
+				     const msgpack_object_str *command,
+				     const msgpack_object_array *args);
 
+/**
+ * Decode the @p count arguments of the command @p command directly from the
+ * msgpack data of @p reader, if the command supports it.
+ *
+ * @param[out] streamed Set to EINA_FALSE if the command cannot be decoded this
+ *   way. The caller must then fall back on nvim_event_method_dispatch(), and
+ *   @p reader is left untouched.
+ * @return EINA_TRUE on success, EINA_FALSE on failure. On failure, @p reader
+ *   may have been advanced in the middle of the arguments.
+ */
+Eina_Bool nvim_event_method_stream(struct nvim *nvim, const struct method *method,
+				   const msgpack_object_str *command, struct mpack_reader *reader,
+				   uint32_t count, Eina_Bool *streamed);
+
+const char *nvim_event_method_name_get(const struct method *method);
 Eina_Bool nvim_event_method_batch_end(struct nvim *nvim, const struct method *method);
 
 #endif /* ! __EOVIM_EVENT_H__ */
@@ -0,0 +1,37 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#ifndef __EOVIM_NVIM_IO_H__
+#define __EOVIM_NVIM_IO_H__
+
+#include "eovim/types.h"
+#include <Eina.h>
+
+/**
+ * @file nvim_io.h
+ *
+ * With --io-thread, a thread reads neovim's output and cuts it into messages,
+ * so the main loop does not wait behind the reads and the scan of a redraw
+ * flood to handle inputs. The thread validates the messages, and hands them
+ * to the main loop through a lock-free single-producer, single-consumer ring,
+ * in a chunk per read. They are then decoded as they would have been without
+ * the thread: in place for the redraw notifications.
+ */
+
+/**
+ * Start reading neovim's output from @p fd in a thread
+ *
+ * @param[in] nvim The neovim handle
+ * @param[in] fd The read end of the pipe connected to neovim's output, or
+ *   the socket. It must be non-blocking, and it stays owned by the caller.
+ *   When it is closed, nvim_output_closed() is called from the main loop.
+ * @return The I/O thread, or NULL on failure
+ */
+struct nvim_io *nvim_io_new(struct nvim *nvim, int fd);
+
+/**
+ * Stop the I/O thread, and wait for it. The messages that were not processed
+ * are dropped.
+ */
+void nvim_io_free(struct nvim_io *io);
+
+#endif /* ! __EOVIM_NVIM_IO_H__ */
@@ -0,0 +1,32 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#ifndef __EOVIM_NVIM_SOCKET_H__
+#define __EOVIM_NVIM_SOCKET_H__
+
+#include "eovim/types.h"
+#include <Eina.h>
+
+/**
+ * @file nvim_socket.h
+ *
+ * With --server, eovim does not spawn neovim, but attaches to one that
+ * listens on a Unix socket or a TCP port (nvim --listen ADDR), e.g. on a
+ * build host. The messages are already packed in a single buffer that is
+ * sent once per main loop iteration, so the socket receives a few large
+ * writes rather than many small ones, which also suits compressed tunnels.
+ * When the socket is full, the remainder is queued and written when the
+ * socket can take it, without ever blocking the main loop.
+ */
+
+/**
+ * Connect to the neovim listening at @p addr
+ *
+ * @param[in] addr A path to a Unix socket, or HOST:PORT for TCP. IPv6 hosts
+ *   are written within brackets (e.g. [::1]:6666).
+ * @param[out] transport Set to send the messages through the socket
+ * @return The non-blocking socket, to read what neovim sends from, or -1 on
+ *   failure. It is owned by the caller, and must outlive @p transport.
+ */
+int nvim_socket_connect(const char *addr, struct nvim_transport *transport);
+
+#endif /* ! __EOVIM_NVIM_SOCKET_H__ */
@@ -0,0 +1,161 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#ifndef __EOVIM_PROFILE_H__
+#define __EOVIM_PROFILE_H__
+
+#include <Eina.h>
+#include <Evas.h>
+#include <stdint.h>
+
+/**
+ * @file profile.h
+ *
+ * The profiler records monotonic timings of the redraw pipeline: unpacking,
+ * decoding of each event, batches, flushes and the rendering of the canvas.
+ * It is enabled with the --profile command-line option. When disabled, each
+ * probe costs a single (predicted) branch.
+ *
+ * The heap allocations of the whole process can be counted as well (with the
+ * glibc only), and attributed to the scope of the pipeline the thread that
+ * made them was in. This replaces the allocator, so it is only built in
+ * eovim-bench, and in eovim when configured with WITH_ALLOC_PROFILE.
+ */
+
+enum profile_counter {
+	PROFILE_COUNTER_BYTES_RECEIVED, /**< Bytes read from neovim */
+	PROFILE_COUNTER_CELLS_WRITTEN, /**< Cells written in the grid */
+	PROFILE_COUNTER_EVENTS, /**< Redraw events decoded */
+	PROFILE_COUNTER_WAKEUPS, /**< Wakeups of the main loop */
+	PROFILE_COUNTER_BATCHES, /**< Batches of events decoded */
+	PROFILE_COUNTER_BATCHES_ALLOCATING, /**< Batches that allocated on the heap */
+	PROFILE_COUNTER_LAST /* Sentinel */
+};
+
+enum profile_scope {
+	PROFILE_SCOPE_OTHER, /**< Anything else, e.g. the inputs and the widgets */
+	PROFILE_SCOPE_UNPACK, /**< Reading and unpacking neovim's output */
+	PROFILE_SCOPE_DECODE, /**< Decoding the events of a batch */
+	PROFILE_SCOPE_FLUSH, /**< Applying a flush to the grids */
+	PROFILE_SCOPE_RENDER, /**< Rendering the canvas */
+	PROFILE_SCOPE_LAST /* Sentinel */
+};
+
+/* Don't use this directly. Use the PROFILE_*() macros instead */
+extern Eina_Bool _profile_enabled;
+
+Eina_Bool profile_init(void);
+void profile_shutdown(void);
+
+/**
+ * Enable the profiler. This must be done before the modules are initialized.
+ */
+void profile_enable(void);
+
+/**
+ * @return The current monotonic time, in nanoseconds
+ */
+uint64_t profile_time_get(void);
+
+/**
+ * Record a sample that started at @p start and ends now.
+ *
+ * @param[in] name Name of the probe. It is looked up by address, so it MUST
+ *   be a string that lives as long as the program (e.g. a literal).
+ * @param[in] start Time at which the sample started (see profile_time_get())
+ */
+void profile_record(const char *name, uint64_t start);
+
+void profile_count(enum profile_counter counter, uint64_t value);
+
+/**
+ * @return The value accumulated so far by @p counter
+ */
+uint64_t profile_counter_get(enum profile_counter counter);
+
+/**
+ * Make the allocations of the calling thread count for @p scope
+ *
+ * @return The scope the thread was in, to be restored with
+ *   profile_scope_leave()
+ */
+enum profile_scope profile_scope_enter(enum profile_scope scope);
+void profile_scope_leave(enum profile_scope previous);
+
+/**
+ * @return EINA_TRUE if the heap allocations are counted in this executable
+ */
+Eina_Bool profile_allocations_counted(void);
+
+/**
+ * @param[in] scope The scope to report, or PROFILE_SCOPE_LAST for all of them
+ * @return How many heap allocations were made in @p scope so far
+ */
+uint64_t profile_allocations_get(enum profile_scope scope);
+
+/**
+ * Enter the decoding of a batch. It is counted as allocating if the calling
+ * thread allocated anything on the heap before profile_batch_end(), whatever
+ * the scope.
+ *
+ * @return What profile_batch_end() needs
+ */
+uint64_t profile_batch_begin(void);
+void profile_batch_end(uint64_t begin);
+
+/**
+ * Retrieve the samples recorded by a probe
+ *
+ * @param[in] name Name of the probe. Unlike profile_record(), it is compared
+ *   by value.
+ * @param[out] count How many samples were recorded
+ * @param[out] total Their total duration, in nanoseconds
+ * @return EINA_FALSE if no sample was recorded for @p name
+ */
+Eina_Bool profile_probe_get(const char *name, uint64_t *count, uint64_t *total);
+
+/**
+ * Time the rendering of the canvas @p evas
+ */
+void profile_evas_attach(Evas *evas);
+
+/**
+ * Print the statistics gathered so far on the standard error
+ */
+void profile_dump(void);
+
+#define PROFILE_START(Var)                                                                         \
+	const uint64_t Var = (EINA_UNLIKELY(_profile_enabled)) ? profile_time_get() : UINT64_C(0)
+
+#define PROFILE_STOP(Name, Var)                                                                    \
+	do {                                                                                       \
+		if (EINA_UNLIKELY(_profile_enabled))                                               \
+			profile_record(Name, Var);                                                 \
+	} while (0)
+
+#define PROFILE_SCOPE_ENTER(Var, Scope)                                                            \
+	const enum profile_scope Var = (EINA_UNLIKELY(_profile_enabled))                           \
+					       ? profile_scope_enter(Scope)                        \
+					       : PROFILE_SCOPE_OTHER
+
+#define PROFILE_SCOPE_LEAVE(Var)                                                                   \
+	do {                                                                                       \
+		if (EINA_UNLIKELY(_profile_enabled))                                               \
+			profile_scope_leave(Var);                                                  \
+	} while (0)
+
+#define PROFILE_BATCH_START(Var)                                                                   \
+	const uint64_t Var = (EINA_UNLIKELY(_profile_enabled)) ? profile_batch_begin() : UINT64_C(0)
+
+#define PROFILE_BATCH_STOP(Var)                                                                    \
+	do {                                                                                       \
+		if (EINA_UNLIKELY(_profile_enabled))                                               \
+			profile_batch_end(Var);                                                    \
+	} while (0)
+
+#define PROFILE_COUNT(Counter, Value)                                                              \
+	do {                                                                                       \
+		if (EINA_UNLIKELY(_profile_enabled))                                               \
+			profile_count(Counter, Value);                                             \
+	} while (0)
+
+#endif /* ! __EOVIM_PROFILE_H__ */
@@ -18,35 +18,120 @@ struct termview_style {
 	Eina_Bool strikethrough;
 };
 
+/** Latencies between a key press and the render of neovim's answer */
+struct termview_latency {
+	unsigned int samples; /**< How many of the last keys were timed */
+	double last; /**< Latency of the last key, in milliseconds */
+	double p50; /**< Median latency, in milliseconds */
+	double p99; /**< 99th percentile, in milliseconds */
+	double max; /**< Highest latency, in milliseconds */
+};
+
 Eina_Bool termview_init(void);
 void termview_shutdown(void);
 Evas_Object *termview_add(Evas_Object *parent, struct nvim *nvim);
-void termview_matrix_set(Evas_Object *obj, unsigned int cols, unsigned int rows);
+void termview_matrix_set(Evas_Object *obj, t_int grid_id, unsigned int cols, unsigned int rows);
 void termview_cell_size_get(const Evas_Object *obj, unsigned int *w, unsigned int *h);
 void termview_size_get(const Evas_Object *obj, unsigned int *cols, unsigned int *rows);
-void termview_clear(Evas_Object *obj);
-void termview_cursor_goto(Evas_Object *obj, unsigned int to_x, unsigned int to_y);
-void termview_cell_geometry_get(const Evas_Object *obj, unsigned int cell_x, unsigned int cell_y,
-				int *px, int *py, int *pw, int *ph);
+void termview_clear(Evas_Object *obj, t_int grid_id);
+void termview_cursor_goto(Evas_Object *obj, t_int grid_id, unsigned int to_x, unsigned int to_y);
+
+/**
+ * Cells the NUL-terminated (UTF-8) @p text takes when it is drawn with the
+ * font of the grids. Glyphs that are wider than neovim counts them (e.g.
+ * fallback fonts) take the cells they really cover.
+ */
+unsigned int termview_text_width_get(Evas_Object *obj, const char *text);
+
+/**
+ * Retrieve the geometry of a cell of a grid, relatively to the main grid
+ */
+void termview_cell_geometry_get(const Evas_Object *obj, t_int grid_id, unsigned int cell_x,
+				unsigned int cell_y, int *px, int *py, int *pw, int *ph);
 
 void termview_cursor_mode_set(Evas_Object *obj, const struct mode *mode);
 
 struct termview_style *termview_style_get(Evas_Object *obj, t_int style_id);
+
+/**
+ * Apply the pending style changes to the textblock style. This is done
+ * automatically when the termview is flushed.
+ *
+ * @param[in] obj The termview object
+ */
 void termview_style_update(Evas_Object *obj);
 
-void termview_scroll(Evas_Object *obj, int top, int bot, int left, int right, int rows);
+/**
+ * Notify the termview that the kind styles (see nvim->kind_styles) have
+ * changed. They will be taken into account at the next style update.
+ *
+ * @param[in] obj The termview object
+ */
+void termview_kind_styles_changed(Evas_Object *obj);
+
+void termview_scroll(Evas_Object *obj, t_int grid_id, int top, int bot, int left, int right,
+		     int rows);
 
 void termview_default_colors_set(Evas_Object *obj, union color fg, union color bg, union color sp);
 
+/**
+ * Compute the statistics of the key-to-render latencies of the last keys
+ *
+ * @param[in] obj The termview object
+ * @param[out] latency The statistics. They are all zero when no key was timed.
+ */
+void termview_latency_get(const Evas_Object *obj, struct termview_latency *latency);
+
 void termview_font_set(Evas_Object *obj, Eina_Stringshare *font_name, unsigned int font_size);
 
-void termview_line_edit(Evas_Object *obj, unsigned int row, unsigned int col, const char *text,
-			size_t text_len, t_int style_id, size_t repeat);
+void termview_line_edit(Evas_Object *obj, t_int grid_id, unsigned int row, unsigned int col,
+			const char *text, size_t text_len, t_int style_id, size_t repeat);
 
 void termview_flush(Evas_Object *obj);
 void termview_linespace_set(Evas_Object *obj, unsigned int linespace);
 void termview_redraw_end(Evas_Object *obj);
 
-void termview_style_changed(Evas_Object *obj);
+/**
+ * Notify the termview that the style with identifier @p style_id has changed.
+ * Changes are batched, and applied at the next style update.
+ *
+ * @param[in] obj The termview object
+ * @param[in] style_id Identifier of the style that was modified
+ */
+void termview_style_changed(Evas_Object *obj, t_int style_id);
+
+/**
+ * Release the grid @p grid_id. Neovim will not use it anymore. The main grid
+ * cannot be destroyed.
+ *
+ * @param[in] obj The termview object
+ * @param[in] grid_id Identifier of the grid
+ */
+void termview_grid_destroy(Evas_Object *obj, t_int grid_id);
+
+/**
+ * Show the grid @p grid_id over the main grid, with its top-left corner at
+ * the cell (@p row, @p col) of the main grid. This is only meaningful with
+ * ext_multigrid.
+ *
+ * @param[in] obj The termview object
+ * @param[in] grid_id Identifier of the grid (not the main one)
+ * @param[in] row Row of the main grid the grid starts at
+ * @param[in] col Column of the main grid the grid starts at
+ * @param[in] floating If EINA_TRUE, the grid is drawn over all the other
+ *   ones. Otherwise, it is a window, which never overlaps other windows.
+ */
+void termview_grid_position_set(Evas_Object *obj, t_int grid_id, int row, int col,
+				Eina_Bool floating);
+
+/**
+ * Show the floating grid @p grid_id, so its corner (as designated by
+ * @p south and @p east) is at the position (@p row, @p col) of the grid
+ * @p anchor_grid_id.
+ */
+void termview_grid_float_set(Evas_Object *obj, t_int grid_id, t_int anchor_grid_id,
+			     Eina_Bool south, Eina_Bool east, double row, double col);
+
+void termview_grid_hide(Evas_Object *obj, t_int grid_id);
 
 #endif /* ! __EOVIM_TERMVIEW_H__ */
@@ -11,9 +11,14 @@ struct nvim;
 struct gui;
 struct wildmenu;
 struct options;
+struct mpack_reader;
+struct nvim_io;
+struct nvim_transport;
 
 typedef int64_t t_int;
 typedef Eina_Bool (*f_event_cb)(struct nvim *nvim, const msgpack_object_array *args);
+typedef Eina_Bool (*f_event_stream_cb)(struct nvim *nvim, struct mpack_reader *reader,
+				       uint32_t count);
 typedef void (*f_nvim_api_cb)(struct nvim *nvim, void *data, const msgpack_object *result);
 
 #define COLOR_DEFAULT UINT32_C(0)
@@ -71,6 +76,11 @@ struct options {
 
 	Eina_Bool fullscreen;
 	Eina_Bool maximized; /**< Eovim will run in a maximized window */
+	Eina_Bool profile; /**< Time the redraw pipeline */
+	char *renderer; /**< "textblock" (default) or "textgrid" */
+	char *record; /**< File where neovim's output is recorded, or NULL */
+	Eina_Bool io_thread; /**< Read and unpack neovim's output in a thread */
+	char *server; /**< Address of the neovim to attach to, or NULL to spawn one */
 };
 
 #endif /* ! __EOVIM_TYPES_H__ */
@@ -0,0 +1,29 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#ifndef __EOVIM_UNICODE_H__
+#define __EOVIM_UNICODE_H__
+
+#include <Eina.h>
+
+/**
+ * @file unicode.h
+ *
+ * How many cells a codepoint takes, as neovim counts them. East Asian wide
+ * and fullwidth characters take two cells, combining characters none. The
+ * width of the ambiguous characters and of the emoji depends on the options
+ * 'ambiwidth' and 'emoji'.
+ */
+
+enum unicode_width_flags {
+	UNICODE_AMBIGUOUS_WIDE = (1 << 0), /**< 'ambiwidth' is "double" */
+	UNICODE_EMOJI_WIDE = (1 << 1), /**< 'emoji' is set */
+};
+
+/**
+ * @param[in] cp A codepoint
+ * @param[in] flags Bitwise OR of enum unicode_width_flags
+ * @return The cells @p cp takes: 0, 1 or 2
+ */
+unsigned int unicode_width_get(Eina_Unicode cp, unsigned int flags);
+
+#endif /* ! __EOVIM_UNICODE_H__ */
@@ -0,0 +1,83 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#include "eovim/arena.h"
+#include "eovim/log.h"
+
+/* Smallest arena that is allocated, so small batches never make it grow */
+#define ARENA_SIZE_MIN 4096u
+
+#define ARENA_ALIGN (_Alignof(max_align_t))
+
+/* Header of the blocks allocated when the arena is full. The union keeps the
+ * memory that follows aligned as malloc() would have. */
+struct arena_block {
+	union {
+		struct arena_block *next;
+		max_align_t align;
+	};
+};
+
+void *arena_alloc(struct arena *const arena, size_t size)
+{
+	size = (size + ARENA_ALIGN - 1u) & ~(ARENA_ALIGN - 1u);
+	arena->wanted += size;
+	if (EINA_LIKELY(arena->size - arena->used >= size)) {
+		void *const ptr = arena->mem + arena->used;
+		arena->used += size;
+		return ptr;
+	}
+
+	struct arena_block *const block = malloc(sizeof(*block) + size);
+	if (EINA_UNLIKELY(!block)) {
+		CRI("Failed to allocate memory (%zu bytes)", size);
+		return NULL;
+	}
+	block->next = arena->overflow;
+	arena->overflow = block;
+	return block + 1;
+}
+
+char *arena_strndup(struct arena *const arena, const char *const str, const size_t size)
+{
+	char *const copy = arena_alloc(arena, size + 1u);
+	if (EINA_LIKELY(copy != NULL)) {
+		memcpy(copy, str, size);
+		copy[size] = '\0';
+	}
+	return copy;
+}
+
+static void _arena_overflow_free(struct arena *const arena)
+{
+	for (struct arena_block *block = arena->overflow, *next; block; block = next) {
+		next = block->next;
+		free(block);
+	}
+	arena->overflow = NULL;
+}
+
+void arena_reset(struct arena *const arena)
+{
+	if (arena->overflow) {
+		_arena_overflow_free(arena);
+
+		/* Grow, with some slack, so the next batches like this one fit */
+		const size_t size = MAX(arena->wanted + arena->wanted / 2u, ARENA_SIZE_MIN);
+		char *const mem = malloc(size);
+		if (EINA_LIKELY(mem != NULL)) {
+			free(arena->mem);
+			arena->mem = mem;
+			arena->size = size;
+		}
+	}
+	arena->used = 0u;
+	arena->wanted = 0u;
+}
+
+void arena_free(struct arena *const arena)
+{
+	_arena_overflow_free(arena);
+	free(arena->mem);
+	arena->mem = NULL;
+	arena->size = arena->used = arena->wanted = 0u;
+}
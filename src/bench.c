@@ -0,0 +1,490 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+/* eovim-bench replays streams recorded with "eovim --record FILE" through the
+ * whole redraw pipeline (unpacking, decoding, termview and Evas rendering),
+ * without neovim, and on an offscreen canvas. It reports the throughput of
+ * the pipeline, the cost of a flush, and how many allocations were made (see
+ * profile.h). The first iteration warms the caches and arenas up: the
+ * allocations of the next ones are those of the steady state, which can be
+ * bounded with --max-allocations, e.g. to gate a CI job.
+ *
+ * The results can also be written in JSON with --json, and compared with
+ * those of a previous run with --baseline: a file whose flushes became
+ * slower than --threshold percents fails the run. This is what the
+ * perf-gate target does, on the streams written by eovim-stress. */
+
+#include <eovim/keymap.h>
+#include <eovim/nvim.h>
+#include <eovim/nvim_api.h>
+#include <eovim/version.h>
+#include <eovim/nvim_request.h>
+#include <eovim/nvim_event.h>
+#include <eovim/termview.h>
+#include <eovim/main.h>
+#include <eovim/log.h>
+#include <eovim/profile.h>
+#include <eovim/nvim_cache.h>
+#include <eovim/font_cache.h>
+
+#include <Ecore_Getopt.h>
+
+#include <errno.h>
+
+/* Replayed streams are cut in slices of this size, as if each one had been
+ * read from neovim's output in one go */
+#define BENCH_SLICE_SIZE 65536u
+
+int _eovim_log_domain = -1;
+
+static Eina_Strbuf *_edje_file = NULL;
+
+/* What is reported for each replayed file */
+struct result {
+	const char *name; /**< Base name of the file, which the baseline refers to */
+	size_t bytes;
+	unsigned int iterations;
+	double seconds;
+	uint64_t events;
+	uint64_t flushes;
+	double us_per_flush;
+	uint64_t allocations;
+	uint64_t batches;
+	uint64_t batches_allocating;
+	double warm_allocations; /**< Per batch, past the first iteration */
+};
+
+struct module {
+	const char *const name;
+	Eina_Bool (*const init)(void);
+	void (*const shutdown)(void);
+};
+
+/* Same modules as eovim itself, initialized in the same order */
+static const struct module _modules[] = {
+#define MODULE(name_)                                                                              \
+	{                                                                                          \
+		.name = #name_, .init = &name_##_init, .shutdown = &name_##_shutdown               \
+	}
+
+	MODULE(profile),      MODULE(keymap),	      MODULE(nvim_api),	    MODULE(nvim_request),
+	MODULE(nvim_event),   MODULE(gui_wildmenu), MODULE(gui_completion), MODULE(termview),
+	MODULE(nvim_cache),   MODULE(font_cache),
+
+#undef MODULE
+};
+
+static const char *const _renderers[] = { "textblock", "textgrid", NULL };
+
+static const Ecore_Getopt options_desc = {
+	"eovim-bench",
+	"%prog [options] file...",
+	EOVIM_VERSION,
+	"(c) 2017-2020 Jean Guyomarc'h and others",
+	"MIT",
+	"Replay streams recorded with 'eovim --record FILE' on an offscreen canvas,\n"
+	"and report how fast they were processed.",
+	EINA_TRUE,
+	{ ECORE_GETOPT_STORE_UINT('n', "iterations", "How many times each file is replayed"),
+	  ECORE_GETOPT_CHOICE('\0', "renderer", "Evas object that renders the grids", _renderers),
+	  ECORE_GETOPT_STORE_DOUBLE('\0', "max-allocations",
+				    "Fail if the batches make more heap allocations than this on "
+				    "average, once warmed up"),
+	  ECORE_GETOPT_CALLBACK_ARGS('g', "geometry",
+				     "Dimensions of the offscreen window, in cells (e.g. 120x40)",
+				     "COLUMNSxROWS", &ecore_getopt_callback_size_parse, NULL),
+	  ECORE_GETOPT_STORE_STR('j', "json", "Also write the results in this JSON file"),
+	  ECORE_GETOPT_STORE_STR('b', "baseline",
+				 "Compare the flush times with those of this file, which was "
+				 "written by --json"),
+	  ECORE_GETOPT_STORE_DOUBLE('t', "threshold",
+				    "Fail if a flush is slower than in the baseline by more than "
+				    "this percentage (default: 20)"),
+	  ECORE_GETOPT_VERSION('V', "version"), ECORE_GETOPT_HELP('h', "help"),
+	  ECORE_GETOPT_SENTINEL }
+};
+
+/*============================================================================*
+ *                                   Replay                                   *
+ *============================================================================*/
+
+static Eina_Bool _replay(struct nvim *nvim, const char *path, unsigned int iterations,
+			 struct result *result)
+{
+	Eina_File *const file = eina_file_open(path, EINA_FALSE);
+	if (EINA_UNLIKELY(!file)) {
+		CRI("Failed to open '%s'", path);
+		return EINA_FALSE;
+	}
+	const size_t size = eina_file_size_get(file);
+	const uint8_t *const data = eina_file_map_all(file, EINA_FILE_SEQUENTIAL);
+	if (EINA_UNLIKELY(!data)) {
+		CRI("Failed to map '%s'", path);
+		eina_file_close(file);
+		return EINA_FALSE;
+	}
+
+	Evas *const evas = evas_object_evas_get(nvim->gui.win);
+	const uint64_t events = profile_counter_get(PROFILE_COUNTER_EVENTS);
+	const uint64_t allocations = profile_allocations_get(PROFILE_SCOPE_LAST);
+	const uint64_t batches = profile_counter_get(PROFILE_COUNTER_BATCHES);
+	const uint64_t allocating = profile_counter_get(PROFILE_COUNTER_BATCHES_ALLOCATING);
+	uint64_t warm_allocations = allocations, warm_batches = batches;
+	/* The cost of applying the flushes to the grids, and not that of
+	 * decoding the "flush" events, which also apply them here */
+	uint64_t flushes, flush_time;
+	profile_probe_get("termview flush", &flushes, &flush_time);
+
+	Eina_Bool ok = EINA_TRUE;
+	const uint64_t start = profile_time_get();
+	for (unsigned int i = 0u; ok && (i < iterations); i++) {
+		for (size_t off = 0u; ok && (off < size); off += BENCH_SLICE_SIZE) {
+			ok = nvim_replay(nvim, data + off, MIN(size - off, BENCH_SLICE_SIZE));
+			evas_render(evas);
+		}
+		if (i == 0u) {
+			warm_allocations = profile_allocations_get(PROFILE_SCOPE_LAST);
+			warm_batches = profile_counter_get(PROFILE_COUNTER_BATCHES);
+		}
+	}
+	const double elapsed = (double)(profile_time_get() - start) / 1e9;
+
+	uint64_t total_flushes, total_flush_time;
+	profile_probe_get("termview flush", &total_flushes, &total_flush_time);
+	flushes = total_flushes - flushes;
+	flush_time = total_flush_time - flush_time;
+	const uint64_t replayed = profile_counter_get(PROFILE_COUNTER_EVENTS) - events;
+	const uint64_t allocated = profile_allocations_get(PROFILE_SCOPE_LAST) - allocations;
+	const uint64_t replayed_batches = profile_counter_get(PROFILE_COUNTER_BATCHES) - batches;
+	const uint64_t allocating_batches =
+		profile_counter_get(PROFILE_COUNTER_BATCHES_ALLOCATING) - allocating;
+
+	/* Once warmed up, i.e. past the first iteration */
+	const uint64_t warm_allocated =
+		profile_allocations_get(PROFILE_SCOPE_LAST) - warm_allocations;
+	const uint64_t warm_replayed = profile_counter_get(PROFILE_COUNTER_BATCHES) - warm_batches;
+
+	const char *const slash = strrchr(path, '/');
+	*result = (struct result){
+		.name = (slash) ? slash + 1 : path,
+		.bytes = size,
+		.iterations = iterations,
+		.seconds = elapsed,
+		.events = replayed,
+		.flushes = flushes,
+		.us_per_flush = (flushes) ? (double)flush_time / 1000.0 / (double)flushes : 0.0,
+		.allocations = allocated,
+		.batches = replayed_batches,
+		.batches_allocating = allocating_batches,
+		.warm_allocations =
+			(warm_replayed) ? (double)warm_allocated / (double)warm_replayed : 0.0,
+	};
+
+	eina_file_map_free(file, (void *)data);
+	eina_file_close(file);
+	return ok;
+}
+
+static void _result_print(const char *path, const struct result *r)
+{
+	const double elapsed = MAX(r->seconds, 1e-9);
+
+	printf("%s: %zu bytes, replayed %u times in %.3f s\n", path, r->bytes, r->iterations,
+	       r->seconds);
+	printf("  %-12s %.1f MB/s\n", "throughput",
+	       (double)r->bytes * (double)r->iterations / 1e6 / elapsed);
+	printf("  %-12s %" PRIu64 " (%.0f events/s)\n", "events", r->events,
+	       (double)r->events / elapsed);
+	printf("  %-12s %" PRIu64 " (%.1f us/flush)\n", "flushes", r->flushes, r->us_per_flush);
+	printf("  %-12s %" PRIu64 " (%.2f per event)\n", "allocations", r->allocations,
+	       (r->events) ? (double)r->allocations / (double)r->events : 0.0);
+	printf("  %-12s %" PRIu64 " (%" PRIu64 " allocated)\n", "batches", r->batches,
+	       r->batches_allocating);
+	printf("  %-12s %.2f allocations per batch\n", "warmed up", r->warm_allocations);
+}
+
+/*============================================================================*
+ *                                  Results                                   *
+ *============================================================================*/
+
+/* The names are those of the files, which are not escaped: eovim-stress and
+ * the perf-gate target only write plain names */
+static Eina_Bool _json_write(const char *path, const char *renderer,
+			     const struct result *results, unsigned int count)
+{
+	FILE *const file = fopen(path, "w");
+	if (EINA_UNLIKELY(!file)) {
+		CRI("Failed to open '%s': %s", path, strerror(errno));
+		return EINA_FALSE;
+	}
+
+	fprintf(file, "{\n  \"version\": \"%s\",\n  \"renderer\": \"%s\",\n  \"results\": [",
+		EOVIM_VERSION, renderer);
+	/* The files that could not be replayed have no name */
+	const char *sep = "";
+	for (unsigned int i = 0u; i < count; i++) {
+		const struct result *const r = &results[i];
+		const double elapsed = MAX(r->seconds, 1e-9);
+		if (!r->name)
+			continue;
+
+		fprintf(file, "%s\n    {\n", sep);
+		sep = ",";
+		fprintf(file, "      \"name\": \"%s\",\n", r->name);
+		fprintf(file, "      \"bytes\": %zu,\n", r->bytes);
+		fprintf(file, "      \"iterations\": %u,\n", r->iterations);
+		fprintf(file, "      \"seconds\": %.6f,\n", r->seconds);
+		fprintf(file, "      \"mb_per_s\": %.3f,\n",
+			(double)r->bytes * (double)r->iterations / 1e6 / elapsed);
+		fprintf(file, "      \"events\": %" PRIu64 ",\n", r->events);
+		fprintf(file, "      \"flushes\": %" PRIu64 ",\n", r->flushes);
+		fprintf(file, "      \"us_per_flush\": %.3f,\n", r->us_per_flush);
+		fprintf(file, "      \"allocations\": %" PRIu64 ",\n", r->allocations);
+		fprintf(file, "      \"batches\": %" PRIu64 ",\n", r->batches);
+		fprintf(file, "      \"allocations_per_batch\": %.3f\n", r->warm_allocations);
+		fprintf(file, "    }");
+	}
+	fprintf(file, "\n  ]\n}\n");
+
+	if (EINA_UNLIKELY(fclose(file) != 0)) {
+		CRI("Failed to write '%s'", path);
+		return EINA_FALSE;
+	}
+	return EINA_TRUE;
+}
+
+/* Find the flush time of @p name in a file written by _json_write(). This is
+ * no JSON parser: it only reads back what _json_write() writes. */
+static Eina_Bool _baseline_get(const char *json, const char *name, double *us_per_flush)
+{
+	char needle[PATH_MAX];
+	const int len = snprintf(needle, sizeof(needle), "\"name\": \"%s\"", name);
+	if (EINA_UNLIKELY((len < 0) || ((size_t)len >= sizeof(needle))))
+		return EINA_FALSE;
+
+	const char *const entry = strstr(json, needle);
+	if (!entry)
+		return EINA_FALSE;
+	const char *const end = strchr(entry, '}');
+	const char *const key = strstr(entry, "\"us_per_flush\":");
+	if ((!key) || (end && (key > end)))
+		return EINA_FALSE;
+
+	char *parsed;
+	const char *const value = key + sizeof("\"us_per_flush\":") - 1u;
+	*us_per_flush = strtod(value, &parsed);
+	return parsed != value;
+}
+
+/* Whether the baseline was written with @p renderer, which its timings
+ * depend on */
+static Eina_Bool _baseline_renderer_is(const char *json, const char *renderer)
+{
+	static const char key[] = "\"renderer\": \"";
+	const char *const value = strstr(json, key);
+	if (!value)
+		return EINA_FALSE;
+
+	const size_t len = strlen(renderer);
+	return (!strncmp(value + sizeof(key) - 1u, renderer, len)) &&
+	       (value[sizeof(key) - 1u + len] == '"');
+}
+
+static Eina_Bool _baseline_check(const char *path, const char *renderer, double threshold,
+				 const struct result *results, unsigned int count)
+{
+	Eina_File *const file = eina_file_open(path, EINA_FALSE);
+	if (EINA_UNLIKELY(!file)) {
+		CRI("Failed to open the baseline '%s'. Write one with --json", path);
+		return EINA_FALSE;
+	}
+	/* The map is not nul-terminated */
+	const size_t size = eina_file_size_get(file);
+	char *const json = malloc(size + 1u);
+	const void *const data = eina_file_map_all(file, EINA_FILE_SEQUENTIAL);
+	if (EINA_UNLIKELY((!json) || (!data))) {
+		CRI("Failed to read the baseline '%s'", path);
+		free(json);
+		if (data)
+			eina_file_map_free(file, (void *)data);
+		eina_file_close(file);
+		return EINA_FALSE;
+	}
+	memcpy(json, data, size);
+	json[size] = '\0';
+	eina_file_map_free(file, (void *)data);
+	eina_file_close(file);
+
+	Eina_Bool ok = EINA_TRUE;
+	if (!_baseline_renderer_is(json, renderer)) {
+		fprintf(stderr, "%s: the baseline was not written with the %s renderer\n", path,
+			renderer);
+		ok = EINA_FALSE;
+		goto end;
+	}
+	for (unsigned int i = 0u; i < count; i++) {
+		const struct result *const r = &results[i];
+		double base;
+		if (!r->name)
+			continue;
+		/* A new or renamed file has to be added to the baseline first */
+		if (!_baseline_get(json, r->name, &base)) {
+			fprintf(stderr, "%s: no flush time in the baseline '%s'\n", r->name, path);
+			ok = EINA_FALSE;
+			continue;
+		}
+
+		const double change = (base > 0.0) ? (r->us_per_flush / base - 1.0) * 100.0 : 0.0;
+		printf("%s: %.1f us/flush, %+.1f%% from the baseline (%.1f us/flush)\n", r->name,
+		       r->us_per_flush, change, base);
+		if (change > threshold) {
+			fprintf(stderr,
+				"%s: flushes are %.1f%% slower, more than the %.1f%% allowed\n",
+				r->name, change, threshold);
+			ok = EINA_FALSE;
+		}
+	}
+end:
+	free(json);
+	return ok;
+}
+
+Eina_Bool main_in_tree_is(void)
+{
+	return EINA_TRUE;
+}
+
+const char *main_edje_file_get(void)
+{
+	return eina_strbuf_string_get(_edje_file);
+}
+
+/* Nothing is ever displayed: render in memory. The same EINA_LOG_BACKTRACE
+ * workaround as eovim's is applied (see main.c). */
+static void __attribute__((constructor)) __constructor(void)
+{
+	setenv("ELM_DISPLAY", "buffer", 0);
+	setenv("ELM_ACCEL", "none", 0);
+	setenv("EINA_LOG_BACKTRACE", "-1", 0);
+	eina_log_domain_level_set("efreet_cache", 0);
+}
+
+EAPI_MAIN int elm_main(int argc, char **argv);
+EAPI_MAIN int elm_main(int argc, char **argv)
+{
+	struct options opts = {
+		.geometry = { 0, 0, 120, 40 },
+		.nvim = "nvim",
+		.theme = "default",
+		.profile = EINA_TRUE,
+		.renderer = "textblock",
+	};
+	unsigned int iterations = 10u;
+	double max_allocations = -1.0;
+	const char *json = NULL;
+	const char *baseline = NULL;
+	double threshold = 20.0;
+	Eina_Bool quit = EINA_FALSE;
+	Ecore_Getopt_Value values[] = { ECORE_GETOPT_VALUE_UINT(iterations),
+					ECORE_GETOPT_VALUE_STR(opts.renderer),
+					ECORE_GETOPT_VALUE_DOUBLE(max_allocations),
+					ECORE_GETOPT_VALUE_PTR_CAST(opts.geometry),
+					ECORE_GETOPT_VALUE_STR(json),
+					ECORE_GETOPT_VALUE_STR(baseline),
+					ECORE_GETOPT_VALUE_DOUBLE(threshold),
+					ECORE_GETOPT_VALUE_BOOL(quit),
+					ECORE_GETOPT_VALUE_BOOL(quit),
+					ECORE_GETOPT_VALUE_NONE };
+
+	int return_code = EXIT_FAILURE;
+
+	_eovim_log_domain = eina_log_domain_register("eovim", EINA_COLOR_RED);
+	if (EINA_UNLIKELY(_eovim_log_domain < 0)) {
+		EINA_LOG_CRIT("Failed to create log domain");
+		goto end;
+	}
+
+	const int args = ecore_getopt_parse(&options_desc, values, argc, argv);
+	if (args < 0) {
+		CRI("Failed to parser command-line options");
+		goto log_unregister;
+	}
+	if (quit) {
+		return_code = EXIT_SUCCESS;
+		goto log_unregister;
+	}
+	if (args >= argc) {
+		CRI("No recording to replay. Record one with: eovim --record FILE");
+		goto log_unregister;
+	}
+
+	_edje_file = eina_strbuf_new();
+	if (EINA_UNLIKELY(!_edje_file)) {
+		CRI("Failed to create Strbuf");
+		goto log_unregister;
+	}
+	eina_strbuf_append_printf(_edje_file, "%s/themes/%s.edj", BUILD_DATA_DIR, opts.theme);
+
+	/* The flushes and events are counted by the profiler */
+	profile_enable();
+
+	const struct module *const mod_last = &(_modules[EINA_C_ARRAY_LENGTH(_modules) - 1]);
+	const struct module *mod_it;
+	for (mod_it = _modules; mod_it <= mod_last; mod_it++) {
+		if (EINA_UNLIKELY(mod_it->init() != EINA_TRUE)) {
+			CRI("Failed to initialize module '%s'", mod_it->name);
+			goto modules_shutdown;
+		}
+	}
+
+	/* No neovim process is spawned: the recordings stand for it */
+	struct nvim *const nvim = nvim_new(&opts, NULL);
+	if (EINA_UNLIKELY(!nvim)) {
+		CRI("Failed to create a NeoVim instance");
+		goto modules_shutdown;
+	}
+
+	/* Flushes are applied when they are decoded, and not on the next frame,
+	 * so they are all timed, and never depend on the animator */
+	nvim->gui.theme.render_immediately = EINA_TRUE;
+
+	const unsigned int count = (unsigned int)(argc - args);
+	struct result *const results = calloc(count, sizeof(*results));
+	if (EINA_UNLIKELY(!results)) {
+		CRI("Failed to allocate memory");
+		goto nvim_free;
+	}
+
+	return_code = EXIT_SUCCESS;
+	for (unsigned int i = 0u; i < count; i++) {
+		const char *const path = argv[args + (int)i];
+		struct result *const r = &results[i];
+		if (!_replay(nvim, path, iterations, r))
+			return_code = EXIT_FAILURE;
+		if (!r->name)
+			continue;
+		_result_print(path, r);
+		if ((max_allocations >= 0.0) && (r->warm_allocations > max_allocations)) {
+			fprintf(stderr,
+				"%s: %.2f allocations per batch, more than the %.2f allowed\n",
+				path, r->warm_allocations, max_allocations);
+			return_code = EXIT_FAILURE;
+		}
+	}
+	if (json && (!_json_write(json, opts.renderer, results, count)))
+		return_code = EXIT_FAILURE;
+	if (baseline && (!_baseline_check(baseline, opts.renderer, threshold, results, count)))
+		return_code = EXIT_FAILURE;
+
+	free(results);
+nvim_free:
+	nvim_free(nvim);
+modules_shutdown:
+	for (--mod_it; mod_it >= _modules; mod_it--)
+		mod_it->shutdown();
+	eina_strbuf_free(_edje_file);
+log_unregister:
+	eina_log_domain_unregister(_eovim_log_domain);
+end:
+	return return_code;
+}
+ELM_MAIN()
@@ -27,41 +27,46 @@ Eina_Bool nvim_event_cmdline_show(struct nvim *nvim, const msgpack_object_array
 	//const int64_t level =
 	//   MPACK_INT64_EXTRACT(&params->ptr[5], del_prompt);
 
-	/* Create the string buffer, which will hold the content of the cmdline */
-	Eina_Strbuf *const buf = eina_strbuf_new();
-	if (EINA_UNLIKELY(!buf)) {
-		CRI("Failed to allocate memory");
-		goto del_prompt;
-	}
-
-	/* Add to the content of the command-line the number of spaces the text
-	 * should be indented of */
-	for (size_t i = 0; i < (size_t)indent; i++)
-		eina_strbuf_append_char(buf, ' ');
-
+	/* The content of the command-line is made of chunks. Check them first,
+	 * so they can be copied in a single string from the decoding arena */
+	size_t size = (indent > 0) ? (size_t)indent : 0u;
 	for (unsigned int i = 0; i < content->size; i++) {
 		const msgpack_object_array *const cont =
-			MPACK_ARRAY_EXTRACT(&content->ptr[i], goto del_buf);
+			MPACK_ARRAY_EXTRACT(&content->ptr[i], goto del_prompt);
+		if (EINA_UNLIKELY(cont->size < 2u)) {
+			CRI("Invalid chunk of command-line content");
+			goto del_prompt;
+		}
 
 		/* The map will contain highlight attributes */
 		//const msgpack_object_map *const map =
-		//   MPACK_MAP_EXTRACT(&cont->ptr[0], goto del_buf);
+		//   MPACK_MAP_EXTRACT(&cont->ptr[0], goto del_prompt);
 
-		/* Extract the content of the command-line */
-		const msgpack_object *const cont_o = &(cont->ptr[1]);
-		MPACK_STRING_CHECK(cont_o, goto del_buf);
-		const msgpack_object_str *const str = &(cont_o->via.str);
-		eina_strbuf_append_length(buf, str->ptr, str->size);
+		MPACK_STRING_CHECK(&cont->ptr[1], goto del_prompt);
+		size += cont->ptr[1].via.str.size;
+	}
+	char *const text = arena_alloc(&nvim->arena, size + 1u);
+	if (EINA_UNLIKELY(!text))
+		goto del_prompt;
+
+	/* Add to the content of the command-line the number of spaces the text
+	 * should be indented of */
+	char *it = text;
+	for (t_int i = 0; i < indent; i++)
+		*(it++) = ' ';
+	for (unsigned int i = 0; i < content->size; i++) {
+		const msgpack_object_str *const str = &(content->ptr[i].via.array.ptr[1].via.str);
+		memcpy(it, str->ptr, str->size);
+		it += str->size;
 	}
+	*it = '\0';
 
-	gui_cmdline_show(&nvim->gui, eina_strbuf_string_get(buf), prompt, firstc);
+	gui_cmdline_show(&nvim->gui, text, prompt, firstc);
 
 	/* Set the cursor position within the command-line */
 	gui_cmdline_cursor_pos_set(&nvim->gui, (size_t)pos);
 
 	ret = EINA_TRUE;
-del_buf:
-	eina_strbuf_free(buf);
 del_prompt:
 	eina_stringshare_del(prompt);
 del_firstc:
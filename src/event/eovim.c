@@ -1,9 +1,47 @@
 /* This file is part of Eovim, which is under the MIT License ****************/
 
 #include "event.h"
+#include "eovim/profile.h"
+#include "eovim/nvim_api.h"
 
 Eina_Bool nvim_event_eovim_reload(struct nvim *const nvim,
 				  const msgpack_object_array *const args EINA_UNUSED)
 {
 	return nvim_helper_config_reload(nvim);
 }
+
+Eina_Bool nvim_event_eovim_profile(struct nvim *const nvim EINA_UNUSED,
+				   const msgpack_object_array *const args EINA_UNUSED)
+{
+	profile_dump();
+	return EINA_TRUE;
+}
+
+Eina_Bool nvim_event_eovim_latency(struct nvim *const nvim,
+				   const msgpack_object_array *const args EINA_UNUSED)
+{
+	struct termview_latency lat;
+	termview_latency_get(nvim->gui.termview, &lat);
+
+	char cmd[256];
+	const int len = snprintf(cmd, sizeof(cmd),
+				 "let g:eovim_latency = {'samples': %u, 'last': %.3f, "
+				 "'p50': %.3f, 'p99': %.3f, 'max': %.3f}",
+				 lat.samples, lat.last, lat.p50, lat.p99, lat.max);
+	return nvim_api_command(nvim, cmd, (size_t)len, NULL, NULL);
+}
+
+Eina_Bool nvim_event_eovim_wakeups(struct nvim *const nvim,
+				   const msgpack_object_array *const args EINA_UNUSED)
+{
+	uint64_t total;
+	double per_minute;
+	const Eina_Bool idle = gui_wakeups_get(&nvim->gui, &total, &per_minute);
+
+	char cmd[256];
+	const int len = snprintf(cmd, sizeof(cmd),
+				 "let g:eovim_wakeups = {'total': %" PRIu64 ", "
+				 "'per_minute': %.1f, 'idle': %i}",
+				 total, per_minute, (int)idle);
+	return nvim_api_command(nvim, cmd, (size_t)len, NULL, NULL);
+}
@@ -13,6 +13,7 @@
 #include "eovim/nvim.h"
 #include "eovim/nvim_event.h"
 #include "eovim/msgpack_helper.h"
+#include "eovim/msgpack_reader.h"
 #include "eovim/log.h"
 
 /*
@@ -72,6 +73,7 @@ Eina_Bool arg_uint_get(const msgpack_object *obj, unsigned int *arg);
 Eina_Bool arg_color_get(const msgpack_object *obj, union color *arg);
 Eina_Bool arg_stringshare_get(const msgpack_object *obj, Eina_Stringshare **arg);
 Eina_Bool arg_bool_get(const msgpack_object *obj, Eina_Bool *arg);
+Eina_Bool arg_double_get(const msgpack_object *obj, double *arg);
 
 /*****************************************************************************/
 
@@ -98,8 +100,6 @@ Eina_Bool nvim_event_option_set(struct nvim *nvim, const msgpack_object_array *a
 
 /*****************************************************************************/
 
-Eina_Bool event_linegrid_init(void);
-void event_linegrid_shutdown(void);
 Eina_Bool nvim_event_default_colors_set(struct nvim *nvim, const msgpack_object_array *args);
 Eina_Bool nvim_event_hl_attr_define(struct nvim *nvim, const msgpack_object_array *args);
 Eina_Bool nvim_event_hl_group_set(struct nvim *nvim, const msgpack_object_array *args);
@@ -107,10 +107,23 @@ Eina_Bool nvim_event_grid_resize(struct nvim *nvim, const msgpack_object_array *
 Eina_Bool nvim_event_grid_clear(struct nvim *nvim, const msgpack_object_array *args);
 Eina_Bool nvim_event_grid_cursor_goto(struct nvim *nvim, const msgpack_object_array *args);
 Eina_Bool nvim_event_grid_line(struct nvim *nvim, const msgpack_object_array *args);
+Eina_Bool nvim_event_grid_line_stream(struct nvim *nvim, struct mpack_reader *reader,
+				      uint32_t count);
 Eina_Bool nvim_event_grid_scroll(struct nvim *nvim, const msgpack_object_array *args);
 
 /*****************************************************************************/
 
+Eina_Bool nvim_event_grid_destroy(struct nvim *nvim, const msgpack_object_array *args);
+Eina_Bool nvim_event_win_pos(struct nvim *nvim, const msgpack_object_array *args);
+Eina_Bool nvim_event_win_float_pos(struct nvim *nvim, const msgpack_object_array *args);
+Eina_Bool nvim_event_win_external_pos(struct nvim *nvim, const msgpack_object_array *args);
+Eina_Bool nvim_event_win_hide(struct nvim *nvim, const msgpack_object_array *args);
+Eina_Bool nvim_event_win_close(struct nvim *nvim, const msgpack_object_array *args);
+Eina_Bool nvim_event_msg_set_pos(struct nvim *nvim, const msgpack_object_array *args);
+Eina_Bool nvim_event_win_viewport(struct nvim *nvim, const msgpack_object_array *args);
+
+/*****************************************************************************/
+
 Eina_Bool nvim_event_popupmenu_show(struct nvim *nvim, const msgpack_object_array *args);
 Eina_Bool nvim_event_popupmenu_hide(struct nvim *nvim, const msgpack_object_array *args);
 Eina_Bool nvim_event_popupmenu_select(struct nvim *nvim, const msgpack_object_array *args);
@@ -118,6 +131,9 @@ Eina_Bool nvim_event_popupmenu_select(struct nvim *nvim, const msgpack_object_ar
 /*****************************************************************************/
 
 Eina_Bool nvim_event_eovim_reload(struct nvim *nvim, const msgpack_object_array *args);
+Eina_Bool nvim_event_eovim_profile(struct nvim *nvim, const msgpack_object_array *args);
+Eina_Bool nvim_event_eovim_latency(struct nvim *nvim, const msgpack_object_array *args);
+Eina_Bool nvim_event_eovim_wakeups(struct nvim *nvim, const msgpack_object_array *args);
 
 /*****************************************************************************/
 
@@ -2,12 +2,6 @@
 
 #include "event.h"
 
-/** Function type used to decode an attribute */
-typedef Eina_Bool (*f_hl_attr_decode)(const msgpack_object *, struct termview_style *);
-
-/** Hash table that maps attributes names to decoding functions */
-static Eina_Hash *_attributes;
-
 /* The are quite a lot of attributes, which would lead to DEDIOUS hand-crafted
  * code. I'm not usually a fan of generating codes via macros, but I think
  * there is real gain here
@@ -26,14 +20,22 @@ static Eina_Hash *_attributes;
 	X(strikethrough, arg_bool_get, strikethrough)                                              \
 	/**/
 
-#define GEN_DECODERS(Kw, DecodeFunc, FieldName)                                                    \
-	static Eina_Bool _attr_##Kw##_cb(const msgpack_object *const obj,                          \
-					 struct termview_style *const style)                       \
-	{                                                                                          \
-		return DecodeFunc(obj, &style->FieldName);                                         \
-	}
-ATTRIBUTES(GEN_DECODERS)
-#undef GEN_DECODERS
+/* Decode the attribute named @p key into @p style. There are only a handful
+ * of attributes: comparing the (small) key against each of them is cheaper
+ * than hashing it, and does not require the key to be interned. */
+static Eina_Bool _attribute_decode(const msgpack_object_str *const key,
+				   const msgpack_object *const obj,
+				   struct termview_style *const style)
+{
+#define GEN_DECODER(Kw, DecodeFunc, FieldName)                                                     \
+	if (_msgpack_str_is(key, #Kw, sizeof(#Kw) - 1u))                                           \
+		return DecodeFunc(obj, &style->FieldName);
+	ATTRIBUTES(GEN_DECODER)
+#undef GEN_DECODER
+
+	WRN("Unhandled attribute '%.*s'", (int)key->size, key->ptr);
+	return EINA_TRUE;
+}
 
 Eina_Bool nvim_event_default_colors_set(struct nvim *const nvim,
 					const msgpack_object_array *const args)
@@ -72,13 +74,11 @@ static Eina_Bool hi_name_set(struct nvim *const nvim, const t_int id,
 			     const msgpack_object *const hi_name)
 {
 	Eina_Stringshare *const key = MPACK_STRING_EXTRACT(hi_name, return EINA_FALSE);
-	const struct termview_style *const style = termview_style_get(nvim->gui.termview, id);
-	if (EINA_UNLIKELY(!style)) {
-		ERR("Failed find style with id %" PRIi64, id);
-		return EINA_FALSE;
-	}
 
-	eina_hash_set(nvim->hl_groups, key, style);
+	/* Styles are stored by their identifier, not by address: the termview
+	 * may move them around when it grows its storage. The identifier is
+	 * offset by one, so that style 0 is not mistaken for NULL. */
+	eina_hash_set(nvim->hl_groups, key, (void *)(uintptr_t)(id + 1));
 	return EINA_TRUE;
 }
 
@@ -125,14 +125,11 @@ Eina_Bool nvim_event_hl_attr_define(struct nvim *const nvim, const msgpack_objec
 		const msgpack_object *o_key, *o_val;
 		unsigned int it;
 		MPACK_MAP_ITER (map, it, o_key, o_val) {
-			Eina_Stringshare *const key = MPACK_STRING_EXTRACT(o_key, goto fail);
-			const f_hl_attr_decode func = eina_hash_find(_attributes, key);
-			if (EINA_UNLIKELY(!func))
-				WRN("Unhandled attribute '%s'", key);
-			else
-				ret &= func(o_val, style);
-			eina_stringshare_del(key);
+			const msgpack_object_str *const key =
+				MPACK_STRING_OBJ_EXTRACT(o_key, goto fail);
+			ret &= _attribute_decode(key, o_val, style);
 		}
+		termview_style_changed(nvim->gui.termview, id);
 
 		/* Extract the 'info' argument */
 		const msgpack_object_array *const info_arr =
@@ -150,7 +147,6 @@ Eina_Bool nvim_event_hl_attr_define(struct nvim *const nvim, const msgpack_objec
 				ret &= hi_name_set(nvim, id, o_val);
 		}
 	}
-	termview_style_changed(nvim->gui.termview);
 
 	return ret;
 fail:
@@ -180,13 +176,10 @@ Eina_Bool nvim_event_grid_resize(struct nvim *const nvim, const msgpack_object_a
 
 		t_int grid_id, width, height;
 		GET_ARG(opt, 0, t_int, &grid_id);
-		/* TODO: for now, we don't implement multi_grid, so we just consider the
-		 * grid ID ALWAYS refers to THE termview */
-		EINA_SAFETY_ON_FALSE_RETURN_VAL(grid_id == 1, EINA_FALSE);
 		GET_ARG(opt, 1, t_int, &width);
 		GET_ARG(opt, 2, t_int, &height);
 
-		termview_matrix_set(nvim->gui.termview, (unsigned)width, (unsigned)height);
+		termview_matrix_set(nvim->gui.termview, grid_id, (unsigned)width, (unsigned)height);
 	}
 	return EINA_TRUE;
 
@@ -211,10 +204,7 @@ Eina_Bool nvim_event_grid_clear(struct nvim *const nvim, const msgpack_object_ar
 
 		t_int grid_id;
 		GET_ARG(opt, 0, t_int, &grid_id);
-		/* TODO: for now, we don't implement multi_grid, so we just consider the
-		 * grid ID ALWAYS refers to THE termview */
-		EINA_SAFETY_ON_FALSE_RETURN_VAL(grid_id == 1, EINA_FALSE);
-		termview_clear(nvim->gui.termview);
+		termview_clear(nvim->gui.termview, grid_id);
 	}
 	return EINA_TRUE;
 
@@ -238,12 +228,9 @@ Eina_Bool nvim_event_grid_cursor_goto(struct nvim *const nvim,
 
 	t_int grid_id, row, col;
 	GET_ARG(opt, 0, t_int, &grid_id);
-	/* TODO: for now, we don't implement multi_grid, so we just consider the
-	 * grid ID ALWAYS refers to THE termview */
-	EINA_SAFETY_ON_FALSE_RETURN_VAL(grid_id == 1, EINA_FALSE);
 	GET_ARG(opt, 1, t_int, &row);
 	GET_ARG(opt, 2, t_int, &col);
-	termview_cursor_goto(nvim->gui.termview, (unsigned)col, (unsigned)row);
+	termview_cursor_goto(nvim->gui.termview, grid_id, (unsigned)col, (unsigned)row);
 
 	return EINA_TRUE;
 
@@ -269,9 +256,6 @@ Eina_Bool nvim_event_grid_line(struct nvim *const nvim, const msgpack_object_arr
 
 		t_int grid_id, row, col;
 		GET_ARG(opt, 0, t_int, &grid_id);
-		/* TODO: for now, we don't implement multi_grid, so we just
-		 * consider the grid ID ALWAYS refers to THE termview */
-		EINA_SAFETY_ON_FALSE_RETURN_VAL(grid_id == 1, EINA_FALSE);
 		GET_ARG(opt, 1, t_int, &row);
 		GET_ARG(opt, 2, t_int, &col);
 
@@ -294,10 +278,14 @@ Eina_Bool nvim_event_grid_line(struct nvim *const nvim, const msgpack_object_arr
 				GET_ARG(info, 1, t_int, &style_id);
 			if (info->size >= 3)
 				GET_ARG(info, 2, t_int, &repeat);
+			if (EINA_UNLIKELY(repeat <= 0)) {
+				ERR("Invalid repeat count in grid_line event");
+				goto fail;
+			}
 
-			termview_line_edit(nvim->gui.termview, (unsigned int)row, (unsigned int)col,
-					   str->ptr, (size_t)str->size, (uint32_t)style_id,
-					   (size_t)repeat);
+			termview_line_edit(nvim->gui.termview, grid_id, (unsigned int)row,
+					   (unsigned int)col, str->ptr, (size_t)str->size,
+					   (uint32_t)style_id, (size_t)repeat);
 
 			col += repeat;
 		}
@@ -308,6 +296,61 @@ fail:
 	return EINA_FALSE;
 }
 
+Eina_Bool nvim_event_grid_line_stream(struct nvim *const nvim, struct mpack_reader *const reader,
+				      const uint32_t count)
+{
+	/* This is nvim_event_grid_line(), but reading the msgpack data in place.
+	 * grid_line makes most of the redraw events, and this spares building
+	 * an object for each of their cells. */
+	for (uint32_t i = 0u; i < count; i++) {
+		uint32_t size, cells_count;
+		t_int grid_id, row, col;
+		if (EINA_UNLIKELY(!mpack_reader_array(reader, &size) || (size < 4u) ||
+				  !mpack_reader_int(reader, &grid_id) ||
+				  !mpack_reader_int(reader, &row) ||
+				  !mpack_reader_int(reader, &col) ||
+				  !mpack_reader_array(reader, &cells_count)))
+			goto fail;
+
+		/* If the style is not mentionned for a cell argument, we must
+		 * re-use the last style seen */
+		t_int style_id = INT64_C(0);
+
+		for (uint32_t j = 0u; j < cells_count; j++) {
+			uint32_t info_size;
+			msgpack_object_str str;
+			t_int repeat = INT64_C(1);
+			if (EINA_UNLIKELY(!mpack_reader_array(reader, &info_size) ||
+					  (info_size < 1u) || !mpack_reader_str(reader, &str)))
+				goto fail;
+			if ((info_size >= 2u) && EINA_UNLIKELY(!mpack_reader_int(reader, &style_id)))
+				goto fail;
+			if ((info_size >= 3u) && EINA_UNLIKELY(!mpack_reader_int(reader, &repeat)))
+				goto fail;
+			if (EINA_UNLIKELY(repeat <= 0))
+				goto fail;
+			for (uint32_t k = 3u; k < info_size; k++)
+				if (EINA_UNLIKELY(!mpack_reader_skip(reader)))
+					goto fail;
+
+			termview_line_edit(nvim->gui.termview, grid_id, (unsigned int)row,
+					   (unsigned int)col, str.ptr, (size_t)str.size,
+					   (uint32_t)style_id, (size_t)repeat);
+			col += repeat;
+		}
+
+		/* Arguments that may be added by future versions of neovim */
+		for (uint32_t k = 4u; k < size; k++)
+			if (EINA_UNLIKELY(!mpack_reader_skip(reader)))
+				goto fail;
+	}
+	return EINA_TRUE;
+
+fail:
+	CRI("Malformed grid_line event");
+	return EINA_FALSE;
+}
+
 Eina_Bool nvim_event_grid_scroll(struct nvim *const nvim, const msgpack_object_array *const args)
 {
 	/* We expect this:
@@ -324,9 +367,6 @@ Eina_Bool nvim_event_grid_scroll(struct nvim *const nvim, const msgpack_object_a
 
 		t_int grid_id, top, bot, left, right, rows, cols;
 		GET_ARG(opt, 0, t_int, &grid_id);
-		/* TODO: for now, we don't implement multi_grid, so we just
-		 * consider the grid ID ALWAYS refers to THE termview */
-		EINA_SAFETY_ON_FALSE_RETURN_VAL(grid_id == 1, EINA_FALSE);
 		GET_ARG(opt, 1, t_int, &top);
 		GET_ARG(opt, 2, t_int, &bot);
 		GET_ARG(opt, 3, t_int, &left);
@@ -335,59 +375,11 @@ Eina_Bool nvim_event_grid_scroll(struct nvim *const nvim, const msgpack_object_a
 		GET_ARG(opt, 6, t_int, &cols);
 		EINA_SAFETY_ON_FALSE_RETURN_VAL(cols == 0, EINA_FALSE);
 
-		termview_scroll(nvim->gui.termview, (int)top, (int)bot, (int)left, (int)right,
-				(int)rows);
-	}
-	return EINA_TRUE;
-
-fail:
-	return EINA_FALSE;
-}
-
-Eina_Bool event_linegrid_init(void)
-{
-	struct hl_attr {
-		const char *const name;
-		const f_hl_attr_decode func;
-	};
-
-	const struct hl_attr attrs[] = {
-#define GEN_ATTR(kw, _, __)                                                                        \
-	{                                                                                          \
-		.name = #kw,                                                                       \
-		.func = &_attr_##kw##_cb,                                                          \
-	},
-		ATTRIBUTES(GEN_ATTR)
-#undef GEN_ATTR
-	};
-
-	_attributes = eina_hash_stringshared_new(NULL);
-	if (EINA_UNLIKELY(!_attributes)) {
-		CRI("Failed to create hash table");
-		return EINA_FALSE;
-	}
-
-	for (size_t i = 0; i < EINA_C_ARRAY_LENGTH(attrs); i++) {
-		Eina_Stringshare *const str = eina_stringshare_add(attrs[i].name);
-		if (EINA_UNLIKELY(!str)) {
-			CRI("Failed to register stringshare");
-			goto fail;
-		}
-
-		if (EINA_UNLIKELY(!eina_hash_direct_add(_attributes, str, attrs[i].func))) {
-			CRI("Failed to add item in hash");
-			eina_stringshare_del(str);
-			goto fail;
-		}
+		termview_scroll(nvim->gui.termview, grid_id, (int)top, (int)bot, (int)left,
+				(int)right, (int)rows);
 	}
 	return EINA_TRUE;
 
 fail:
-	eina_hash_free(_attributes);
 	return EINA_FALSE;
 }
-
-void event_linegrid_shutdown(void)
-{
-	eina_hash_free(_attributes);
-}
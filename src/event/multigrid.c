@@ -0,0 +1,187 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#include "event.h"
+
+/* With ext_multigrid, neovim draws each window in a grid of its own. These
+ * events tell where the grids are, relatively to the main grid (1). The
+ * contents of the grids are sent with the linegrid events. */
+
+Eina_Bool nvim_event_grid_destroy(struct nvim *const nvim, const msgpack_object_array *const args)
+{
+	/* We expect this:
+	 *   ["grid_destroy", grid]
+	 *
+	 * Example:
+	 *   ["grid_destroy", [3]]
+	 */
+	CHECK_BASE_ARGS_COUNT(args, >=, 1u);
+	for (uint32_t i = 1u; i < args->size; i++) {
+		const msgpack_object_array *const opt =
+			MPACK_ARRAY_EXTRACT(&args->ptr[i], goto fail);
+		CHECK_ARGS_COUNT(opt, >=, 1);
+
+		t_int grid_id;
+		GET_ARG(opt, 0, t_int, &grid_id);
+		termview_grid_destroy(nvim->gui.termview, grid_id);
+	}
+	return EINA_TRUE;
+
+fail:
+	return EINA_FALSE;
+}
+
+Eina_Bool nvim_event_win_pos(struct nvim *const nvim, const msgpack_object_array *const args)
+{
+	/* We expect this:
+	 *   ["win_pos", grid, win, start_row, start_col, width, height]
+	 *
+	 * Example:
+	 *   ["win_pos", [2, <Window 1000>, 0, 0, 80, 38]]
+	 *
+	 * The size of the window is the size of its grid: we don't need it.
+	 */
+	CHECK_BASE_ARGS_COUNT(args, >=, 1u);
+	for (uint32_t i = 1u; i < args->size; i++) {
+		const msgpack_object_array *const opt =
+			MPACK_ARRAY_EXTRACT(&args->ptr[i], goto fail);
+		CHECK_ARGS_COUNT(opt, >=, 4);
+
+		t_int grid_id, row, col;
+		GET_ARG(opt, 0, t_int, &grid_id);
+		GET_ARG(opt, 2, t_int, &row);
+		GET_ARG(opt, 3, t_int, &col);
+		termview_grid_position_set(nvim->gui.termview, grid_id, (int)row, (int)col,
+					   EINA_FALSE);
+	}
+	return EINA_TRUE;
+
+fail:
+	return EINA_FALSE;
+}
+
+Eina_Bool nvim_event_win_float_pos(struct nvim *const nvim, const msgpack_object_array *const args)
+{
+	/* We expect this:
+	 *   ["win_float_pos", grid, win, anchor, anchor_grid, anchor_row,
+	 *                     anchor_col, focusable(, zindex)]
+	 *
+	 * Example:
+	 *   ["win_float_pos", [4, <Window 1001>, "NW", 2, 3.0, 10.0, true, 50]]
+	 *
+	 * anchor is the corner of the floating window that is placed at
+	 * (anchor_row, anchor_col) of anchor_grid: "NW", "NE", "SW" or "SE".
+	 * Floating windows are stacked in the order neovim places them, so we
+	 * don't care about zindex.
+	 */
+	CHECK_BASE_ARGS_COUNT(args, >=, 1u);
+	for (uint32_t i = 1u; i < args->size; i++) {
+		const msgpack_object_array *const opt =
+			MPACK_ARRAY_EXTRACT(&args->ptr[i], goto fail);
+		CHECK_ARGS_COUNT(opt, >=, 6);
+
+		t_int grid_id, anchor_grid;
+		double row, col;
+		GET_ARG(opt, 0, t_int, &grid_id);
+		const msgpack_object_str *const anchor =
+			MPACK_STRING_OBJ_EXTRACT(&opt->ptr[2], goto fail);
+		GET_ARG(opt, 3, t_int, &anchor_grid);
+		GET_ARG(opt, 4, double, &row);
+		GET_ARG(opt, 5, double, &col);
+		if (EINA_UNLIKELY(anchor->size != 2)) {
+			ERR("Invalid anchor '%.*s'", (int)anchor->size, anchor->ptr);
+			goto fail;
+		}
+
+		const Eina_Bool south = (anchor->ptr[0] == 'S');
+		const Eina_Bool east = (anchor->ptr[1] == 'E');
+		termview_grid_float_set(nvim->gui.termview, grid_id, anchor_grid, south, east, row,
+					col);
+	}
+	return EINA_TRUE;
+
+fail:
+	return EINA_FALSE;
+}
+
+Eina_Bool nvim_event_win_external_pos(struct nvim *const nvim EINA_UNUSED,
+				      const msgpack_object_array *const args EINA_UNUSED)
+{
+	/* We don't ask for ext_windows: this should never be received */
+	DBG("Unimplemented");
+	return EINA_TRUE;
+}
+
+static Eina_Bool _grids_hide(struct nvim *const nvim, const msgpack_object_array *const args)
+{
+	CHECK_BASE_ARGS_COUNT(args, >=, 1u);
+	for (uint32_t i = 1u; i < args->size; i++) {
+		const msgpack_object_array *const opt =
+			MPACK_ARRAY_EXTRACT(&args->ptr[i], goto fail);
+		CHECK_ARGS_COUNT(opt, >=, 1);
+
+		t_int grid_id;
+		GET_ARG(opt, 0, t_int, &grid_id);
+		termview_grid_hide(nvim->gui.termview, grid_id);
+	}
+	return EINA_TRUE;
+
+fail:
+	return EINA_FALSE;
+}
+
+Eina_Bool nvim_event_win_hide(struct nvim *const nvim, const msgpack_object_array *const args)
+{
+	/* We expect this:
+	 *   ["win_hide", grid]
+	 *
+	 * The window is hidden, but its grid is kept around. It is shown again
+	 * with the next win_pos or win_float_pos.
+	 */
+	return _grids_hide(nvim, args);
+}
+
+Eina_Bool nvim_event_win_close(struct nvim *const nvim, const msgpack_object_array *const args)
+{
+	/* We expect this:
+	 *   ["win_close", grid]
+	 *
+	 * The grid itself is released by grid_destroy
+	 */
+	return _grids_hide(nvim, args);
+}
+
+Eina_Bool nvim_event_msg_set_pos(struct nvim *const nvim, const msgpack_object_array *const args)
+{
+	/* We expect this:
+	 *   ["msg_set_pos", grid, row, scrolled, sep_char]
+	 *
+	 * Example:
+	 *   ["msg_set_pos", [3, 36, false, " "]]
+	 *
+	 * The messages grid spans the whole width of the screen, and is drawn
+	 * over the windows.
+	 */
+	CHECK_BASE_ARGS_COUNT(args, >=, 1u);
+	for (uint32_t i = 1u; i < args->size; i++) {
+		const msgpack_object_array *const opt =
+			MPACK_ARRAY_EXTRACT(&args->ptr[i], goto fail);
+		CHECK_ARGS_COUNT(opt, >=, 2);
+
+		t_int grid_id, row;
+		GET_ARG(opt, 0, t_int, &grid_id);
+		GET_ARG(opt, 1, t_int, &row);
+		termview_grid_position_set(nvim->gui.termview, grid_id, (int)row, 0, EINA_TRUE);
+	}
+	return EINA_TRUE;
+
+fail:
+	return EINA_FALSE;
+}
+
+Eina_Bool nvim_event_win_viewport(struct nvim *const nvim EINA_UNUSED,
+				  const msgpack_object_array *const args EINA_UNUSED)
+{
+	/* This tells which lines of the buffer are displayed in a window. We
+	 * have no scrollbars, so we have no use for this. */
+	return EINA_TRUE;
+}
@@ -1,6 +1,7 @@
 /* This file is part of Eovim, which is under the MIT License ****************/
 
 #include "event.h"
+#include "eovim/unicode.h"
 
 /** Dictionary that associates a callback handler to each option name */
 static Eina_Hash *_options = NULL;
@@ -41,16 +42,30 @@ static Eina_Bool _arabicshape_set(struct nvim *nvim EINA_UNUSED,
 	return EINA_TRUE;
 }
 
-static Eina_Bool _ambiwidth_set(struct nvim *nvim EINA_UNUSED,
-				const msgpack_object *value EINA_UNUSED)
+static Eina_Bool _ambiwidth_set(struct nvim *const nvim, const msgpack_object *const value)
 {
-	/* XXX unimplemented for now */
+	/* Neovim lays the grid out itself: this only tells how wide the text
+	 * eovim lays out on its own (e.g. the completion) is */
+	const msgpack_object_str *const val = MPACK_STRING_OBJ_EXTRACT(value, return EINA_FALSE);
+	const Eina_Bool wide = (val->size == 6u) && (!strncmp(val->ptr, "double", 6u));
+	if (wide)
+		nvim->gui.width_flags |= UNICODE_AMBIGUOUS_WIDE;
+	else
+		nvim->gui.width_flags &= ~(unsigned int)UNICODE_AMBIGUOUS_WIDE;
 	return EINA_TRUE;
 }
 
-static Eina_Bool _emoji_set(struct nvim *nvim EINA_UNUSED, const msgpack_object *value EINA_UNUSED)
+static Eina_Bool _emoji_set(struct nvim *const nvim, const msgpack_object *const value)
 {
-	/* XXX unimplemented for now */
+	if (EINA_UNLIKELY(value->type != MSGPACK_OBJECT_BOOLEAN)) {
+		ERR("A boolean is expected for 'emoji'");
+		return EINA_FALSE;
+	}
+
+	if (value->via.boolean)
+		nvim->gui.width_flags |= UNICODE_EMOJI_WIDE;
+	else
+		nvim->gui.width_flags &= ~(unsigned int)UNICODE_EMOJI_WIDE;
 	return EINA_TRUE;
 }
 
@@ -13,15 +13,22 @@ static Eina_Bool wildmenu_show(struct nvim *const nvim, const ssize_t selected,
 		col = 0;
 	}
 
-	/* Go through all the items to be added to the wildmenu, and populate
-	 * the UI interface */
+	/* Go through all the items to be added to the wildmenu, so their names
+	 * can be stored in a single block of memory, then populate the UI */
+	size_t bytes = 0u;
 	for (unsigned int i = 0; i < args->size; i++) {
 		CHECK_TYPE(&args->ptr[i], MSGPACK_OBJECT_ARRAY, EINA_FALSE);
 		const msgpack_object_array *const item = &(args->ptr[i].via.array);
 		CHECK_ARGS_COUNT(item, ==, 4);
-		Eina_Stringshare *const name =
-			MPACK_STRING_EXTRACT(&item->ptr[0], return EINA_FALSE);
-		gui_wildmenu_append(gui, name);
+		MPACK_STRING_CHECK(&item->ptr[0], return EINA_FALSE);
+		bytes += item->ptr[0].via.str.size;
+	}
+	if (EINA_UNLIKELY(!gui_wildmenu_reserve(gui, args->size, bytes)))
+		return EINA_FALSE;
+
+	for (unsigned int i = 0; i < args->size; i++) {
+		const msgpack_object_str *const name = &(args->ptr[i].via.array.ptr[0].via.str);
+		gui_wildmenu_append(gui, name->ptr, name->size);
 	}
 	gui_wildmenu_show(gui, (unsigned int)col);
 	gui_active_popupmenu_select_nth(gui, selected);
@@ -65,24 +72,33 @@ Eina_Bool nvim_event_popupmenu_show(struct nvim *const nvim, const msgpack_objec
 
 	gui_completion_reset(gui);
 
-	/* If we are here, this is the popupmenu used by completions */
+	/* If we are here, this is the popupmenu used by completions. Check the
+	 * items first, so they can all be stored in a single block of memory */
+	size_t bytes = 0u;
 	for (unsigned int i = 0u; i < data->size; i++) {
 		CHECK_TYPE(&data->ptr[i], MSGPACK_OBJECT_ARRAY, EINA_FALSE);
 		const msgpack_object_array *const completion = &(data->ptr[i].via.array);
 		CHECK_ARGS_COUNT(completion, >=, 4);
 
-		MPACK_STRING_CHECK(&completion->ptr[0], goto fail); /* word */
-		MPACK_STRING_CHECK(&completion->ptr[1], goto fail); /* kind */
-		MPACK_STRING_CHECK(&completion->ptr[2], goto fail); /* menu */
-		MPACK_STRING_CHECK(&completion->ptr[3], goto fail); /* info */
+		for (unsigned int j = 0u; j < 4u; j++) {
+			/* word, kind, menu, info */
+			MPACK_STRING_CHECK(&completion->ptr[j], goto fail);
+			bytes += completion->ptr[j].via.str.size;
+		}
+	}
+	if (EINA_UNLIKELY(!gui_completion_reserve(gui, data->size, bytes)))
+		goto fail;
 
+	for (unsigned int i = 0u; i < data->size; i++) {
+		const msgpack_object_array *const completion = &(data->ptr[i].via.array);
 		gui_completion_append(
 			gui, completion->ptr[0].via.str.ptr, completion->ptr[0].via.str.size,
 			completion->ptr[1].via.str.ptr, completion->ptr[1].via.str.size,
 			completion->ptr[2].via.str.ptr, completion->ptr[2].via.str.size,
 			completion->ptr[3].via.str.ptr, completion->ptr[3].via.str.size);
 	}
-	gui_completion_show(gui, (unsigned int)col, (unsigned int)row);
+	/* Without ext_multigrid, the position is in the main grid */
+	gui_completion_show(gui, (grid > 0) ? grid : 1, (unsigned int)col, (unsigned int)row);
 	gui_active_popupmenu_select_nth(gui, selected);
 
 	return EINA_TRUE;
@@ -61,16 +61,17 @@ Eina_Bool nvim_event_tabline_update(struct nvim *nvim, const msgpack_object_arra
 		return EINA_FALSE;
 	}
 
-	gui_tabs_reset(gui);
-
 	/* If we have no tabs or just one, we consider we have no tab at all,
     * and update the UI accordingly. And we stop here. */
 	if (tabs->size <= 1) {
+		gui_tabs_update_begin(gui);
+		gui_tabs_update_end(gui);
 		gui_tabs_hide(gui);
 		return EINA_TRUE;
 	}
 
-	gui_tabs_show(gui);
+	/* The tabs that are still there keep their widgets */
+	gui_tabs_update_begin(gui);
 
 	for (unsigned int i = 0; i < tabs->size; i++) {
 		const msgpack_object *const o_tab = &tabs->ptr[i];
@@ -94,12 +95,17 @@ Eina_Bool nvim_event_tabline_update(struct nvim *nvim, const msgpack_object_arra
 
 		if ((!tab_name) || (tab_id == UINT8_MAX)) {
 			ERR("Failed to extract tab information");
+			eina_stringshare_del(tab_name);
 			continue;
 		}
-		gui_tabs_add(gui, tab_name, tab_id, (tab_id == current) ? EINA_TRUE : EINA_FALSE);
+		gui_tabs_update(gui, tab_name, tab_id, (tab_id == current) ? EINA_TRUE : EINA_FALSE);
+		eina_stringshare_del(tab_name);
 	}
 
+	gui_tabs_update_end(gui);
+	gui_tabs_show(gui);
 	return EINA_TRUE;
 fail:
+	gui_tabs_update_end(gui);
 	return EINA_FALSE;
 }
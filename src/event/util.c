@@ -72,3 +72,20 @@ Eina_Bool arg_bool_get(const msgpack_object *const obj, Eina_Bool *const arg)
 	*arg = obj->via.boolean;
 	return EINA_TRUE;
 }
+
+Eina_Bool arg_double_get(const msgpack_object *const obj, double *const arg)
+{
+	switch (obj->type) {
+	case MSGPACK_OBJECT_FLOAT32: /* Fall through */
+	case MSGPACK_OBJECT_FLOAT64:
+		*arg = obj->via.f64;
+		return EINA_TRUE;
+	case MSGPACK_OBJECT_POSITIVE_INTEGER: /* Fall through */
+	case MSGPACK_OBJECT_NEGATIVE_INTEGER:
+		*arg = (double)obj->via.i64;
+		return EINA_TRUE;
+	default:
+		CRI("Expected a number for argument. Got 0x%x", obj->type);
+		return EINA_FALSE;
+	}
+}
@@ -0,0 +1,264 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#include "eovim/font_cache.h"
+#include "eovim/nvim_cache.h"
+#include "eovim/log.h"
+
+#include <Eet.h>
+#include <Ecore_File.h>
+#include <Ecore_Evas.h>
+#include <Elementary.h>
+#include <fontconfig/fontconfig.h>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Bump this when the layout of the cache entry, or of its name, changes */
+#define CACHE_FORMAT 2u
+
+/* Each entry is named after the font, its size, the linegap, how the canvas
+ * renders it, and the file it is loaded from. The file is read when metrics
+ * are first wanted, and written in a temporary file that then replaces the
+ * cache, as nvim_cache.c does. */
+struct cache_entry {
+	unsigned int format;
+	unsigned int cell_w;
+	unsigned int cell_h;
+	unsigned int line_h;
+};
+
+static Eet_Data_Descriptor *_edd = NULL;
+static Eina_Hash *_entries = NULL; /**< Names to struct cache_entry */
+static Eina_Hash *_files = NULL; /**< Font names to the fingerprints of their file */
+static Eina_Bool _loaded = EINA_FALSE;
+static Eina_Bool _dirty = EINA_FALSE; /**< Entries were added since the load */
+
+/* The path and modification time of the file fontconfig resolves @p font to.
+ * Matching is not free: it is done once per font name. */
+static const char *_font_file_get(const char *const font)
+{
+	const char *fingerprint = eina_hash_find(_files, font);
+	if (fingerprint)
+		return fingerprint;
+
+	char buf[PATH_MAX + 32];
+	buf[0] = '\0';
+	FcPattern *const pattern = FcNameParse((const FcChar8 *)font);
+	if (EINA_LIKELY(pattern != NULL)) {
+		FcResult result;
+		FcChar8 *file;
+		struct stat st;
+
+		FcConfigSubstitute(NULL, pattern, FcMatchPattern);
+		FcDefaultSubstitute(pattern);
+		FcPattern *const match = FcFontMatch(NULL, pattern, &result);
+		if (match && (FcPatternGetString(match, FC_FILE, 0, &file) == FcResultMatch) &&
+		    (stat((const char *)file, &st) == 0))
+			snprintf(buf, sizeof(buf), "%s@%lld", (const char *)file,
+				 (long long)st.st_mtime);
+		if (match)
+			FcPatternDestroy(match);
+		FcPatternDestroy(pattern);
+	}
+	if (buf[0] == '\0')
+		WRN("Failed to find the file of font '%s'", font);
+
+	/* Fonts that cannot be resolved are remembered as well */
+	char *const copy = strdup(buf);
+	if (EINA_UNLIKELY((!copy) || (!eina_hash_add(_files, font, copy)))) {
+		CRI("Failed to remember the file of font '%s'", font);
+		free(copy);
+		return NULL;
+	}
+	return copy;
+}
+
+static Eina_Bool _entry_name_get(char *const name, const size_t size, const Evas_Object *const obj,
+				 const char *const font, const unsigned int font_size,
+				 const unsigned int linegap)
+{
+	Evas *const evas = evas_object_evas_get(obj);
+	int xdpi = 0, ydpi = 0;
+
+	const char *const file = _font_file_get(font);
+	if (EINA_UNLIKELY(!file))
+		return EINA_FALSE;
+	Ecore_Evas *const ee = ecore_evas_ecore_evas_get(evas);
+	if (ee)
+		ecore_evas_screen_dpi_get(ee, &xdpi, &ydpi);
+
+	/* The font goes last: fontconfig styles are written after a colon */
+	const int len = snprintf(name, size, "%u/%u/%ix%i/%.3f/%i/%s/%s", font_size, linegap, xdpi,
+				 ydpi, elm_config_scale_get(), (int)evas_font_hinting_get(evas),
+				 file, font);
+	return (len > 0) && ((size_t)len < size);
+}
+
+static void _load(void)
+{
+	char file[PATH_MAX], dir[PATH_MAX];
+
+	_loaded = EINA_TRUE;
+	if (!nvim_cache_file_get("fonts.eet", file, dir))
+		return;
+	Eet_File *const ef = eet_open(file, EET_FILE_MODE_READ);
+	if (!ef)
+		return;
+
+	int count = 0;
+	char **const names = eet_list(ef, "*", &count);
+	for (int i = 0; i < count; i++) {
+		struct cache_entry *const entry = eet_data_read(ef, _edd, names[i]);
+		if (!entry)
+			continue;
+		if ((entry->format != CACHE_FORMAT) ||
+		    EINA_UNLIKELY(!eina_hash_add(_entries, names[i], entry)))
+			free(entry);
+	}
+	free(names);
+	eet_close(ef);
+	DBG("%u font metrics were cached", (unsigned int)eina_hash_population(_entries));
+}
+
+Eina_Bool font_cache_get(const Evas_Object *const obj, const char *const font,
+			 const unsigned int size, const unsigned int linegap,
+			 struct font_metrics *const metrics)
+{
+	char name[PATH_MAX * 2];
+
+	if (!_loaded)
+		_load();
+	if (EINA_UNLIKELY(!_entry_name_get(name, sizeof(name), obj, font, size, linegap)))
+		return EINA_FALSE;
+	const struct cache_entry *const entry = eina_hash_find(_entries, name);
+	if (!entry)
+		return EINA_FALSE;
+
+	metrics->cell_w = entry->cell_w;
+	metrics->cell_h = entry->cell_h;
+	metrics->line_h = entry->line_h;
+	return EINA_TRUE;
+}
+
+void font_cache_set(const Evas_Object *const obj, const char *const font, const unsigned int size,
+		    const unsigned int linegap, const struct font_metrics *const metrics)
+{
+	char name[PATH_MAX * 2];
+
+	if (EINA_UNLIKELY(!_entry_name_get(name, sizeof(name), obj, font, size, linegap)))
+		return;
+	struct cache_entry *entry = eina_hash_find(_entries, name);
+	if (!entry) {
+		entry = malloc(sizeof(*entry));
+		if (EINA_UNLIKELY(!entry)) {
+			CRI("Failed to allocate memory");
+			return;
+		}
+		if (EINA_UNLIKELY(!eina_hash_add(_entries, name, entry))) {
+			CRI("Failed to add font metrics in hash");
+			free(entry);
+			return;
+		}
+	} else if ((entry->cell_w == metrics->cell_w) && (entry->cell_h == metrics->cell_h) &&
+		   (entry->line_h == metrics->line_h))
+		return;
+
+	entry->format = CACHE_FORMAT;
+	entry->cell_w = metrics->cell_w;
+	entry->cell_h = metrics->cell_h;
+	entry->line_h = metrics->line_h;
+	_dirty = EINA_TRUE;
+}
+
+static Eina_Bool _entry_write_cb(const Eina_Hash *const hash EINA_UNUSED, const void *const key,
+				 void *const data, void *const fdata)
+{
+	Eet_File *const ef = fdata;
+	return eet_data_write(ef, _edd, key, data, EINA_FALSE) > 0;
+}
+
+static void _save(void)
+{
+	char file[PATH_MAX], dir[PATH_MAX], tmp[PATH_MAX];
+
+	if (!nvim_cache_file_get("fonts.eet", file, dir))
+		return;
+	const int len = snprintf(tmp, sizeof(tmp), "%s.%i", file, (int)getpid());
+	if (EINA_UNLIKELY((len < 0) || ((size_t)len >= sizeof(tmp))))
+		return;
+	if (EINA_UNLIKELY(!ecore_file_mkpath(dir))) {
+		ERR("Failed to create directory '%s'", dir);
+		return;
+	}
+
+	Eet_File *const ef = eet_open(tmp, EET_FILE_MODE_WRITE);
+	if (EINA_UNLIKELY(!ef)) {
+		ERR("Failed to open '%s' for writing", tmp);
+		return;
+	}
+	eina_hash_foreach(_entries, &_entry_write_cb, ef);
+	if ((eet_close(ef) != EET_ERROR_NONE) || (rename(tmp, file) != 0)) {
+		ERR("Failed to write the cache '%s'", file);
+		unlink(tmp);
+	}
+}
+
+Eina_Bool font_cache_init(void)
+{
+	if (EINA_UNLIKELY(eet_init() <= 0)) {
+		CRI("Failed to initialize Eet");
+		return EINA_FALSE;
+	}
+
+	Eet_Data_Descriptor_Class eddc;
+	EET_EINA_FILE_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct cache_entry);
+	_edd = eet_data_descriptor_file_new(&eddc);
+	if (EINA_UNLIKELY(!_edd)) {
+		CRI("Failed to create data descriptor");
+		goto shutdown;
+	}
+	_entries = eina_hash_string_superfast_new(&free);
+	if (EINA_UNLIKELY(!_entries)) {
+		CRI("Failed to create hash");
+		goto del_edd;
+	}
+	_files = eina_hash_string_superfast_new(&free);
+	if (EINA_UNLIKELY(!_files)) {
+		CRI("Failed to create hash");
+		goto del_entries;
+	}
+
+#define ADD_BASIC(Field, Type)                                                                     \
+	EET_DATA_DESCRIPTOR_ADD_BASIC(_edd, struct cache_entry, #Field, Field, Type)
+	ADD_BASIC(format, EET_T_UINT);
+	ADD_BASIC(cell_w, EET_T_UINT);
+	ADD_BASIC(cell_h, EET_T_UINT);
+	ADD_BASIC(line_h, EET_T_UINT);
+#undef ADD_BASIC
+
+	return EINA_TRUE;
+
+del_entries:
+	eina_hash_free(_entries);
+	_entries = NULL;
+del_edd:
+	eet_data_descriptor_free(_edd);
+	_edd = NULL;
+shutdown:
+	eet_shutdown();
+	return EINA_FALSE;
+}
+
+void font_cache_shutdown(void)
+{
+	if (_dirty)
+		_save();
+	eina_hash_free(_files);
+	_files = NULL;
+	eina_hash_free(_entries);
+	_entries = NULL;
+	eet_data_descriptor_free(_edd);
+	_edd = NULL;
+	_loaded = _dirty = EINA_FALSE;
+	eet_shutdown();
+}
@@ -14,9 +14,86 @@ static const char CMDLINE_INFO_TEXT_PART[] = "eovim.cmdline_info:text";
 struct cmdline {
 	struct gui *gui;
 	Eina_Strbuf *buf;
+
+	/* Neovim sends the whole command-line on each keystroke. What is
+	 * displayed is kept, so only what changed is edited in the entry,
+	 * instead of laying out the whole text again. */
+	Eina_Strbuf *content;
+
+	/* Styles are only applied when the kind of the command-line changes,
+	 * as they also cause the whole text to be laid out again */
+	Eina_Stringshare *firstc;
+	Eina_Stringshare *info;
+
 	Eina_Bool enabled;
 };
 
+static inline Eina_Bool _utf8_continuation_is(const char c)
+{
+	return ((unsigned char)c & 0xC0) == 0x80;
+}
+
+/* Number of characters in the @p len first bytes of @p str */
+static size_t _utf8_chars_count(const char *const str, const size_t len)
+{
+	size_t chars = 0u;
+	for (size_t i = 0u; i < len; i++)
+		chars += !_utf8_continuation_is(str[i]);
+	return chars;
+}
+
+static void _content_update(struct cmdline *const cmd, const char *const content)
+{
+	const char *const old = eina_strbuf_string_get(cmd->content);
+	const size_t old_len = eina_strbuf_length_get(cmd->content);
+	const size_t new_len = strlen(content);
+	const size_t len = MIN(old_len, new_len);
+
+	/* Find the common head and tail of both texts, which never end or start
+	 * in the middle of a character */
+	size_t head = 0u;
+	while ((head < len) && (old[head] == content[head]))
+		head++;
+	while ((head > 0u) && (((head < new_len) && _utf8_continuation_is(content[head])) ||
+			       ((head < old_len) && _utf8_continuation_is(old[head]))))
+		head--;
+
+	size_t tail = 0u;
+	while ((tail < len - head) && (old[old_len - tail - 1u] == content[new_len - tail - 1u]))
+		tail++;
+	while ((tail > 0u) && _utf8_continuation_is(content[new_len - tail]))
+		tail--;
+
+	if ((head == old_len) && (head == new_len))
+		return;
+
+	/* Select what was between the head and the tail, and replace it with
+	 * what is now there. The part is an entry: Edje edits its textblock
+	 * itself, so the text it keeps stays right. */
+	Evas_Object *const edje = cmd->gui->edje;
+	const int from = (int)_utf8_chars_count(old, head);
+	const size_t removed = old_len - tail - head;
+	edje_object_part_text_select_none(edje, CMDLINE_TEXT_PART);
+	edje_object_part_text_cursor_pos_set(edje, CMDLINE_TEXT_PART, EDJE_CURSOR_MAIN, from);
+	if (removed > 0u) {
+		const int to = from + (int)_utf8_chars_count(old + head, removed);
+		edje_object_part_text_select_begin(edje, CMDLINE_TEXT_PART);
+		edje_object_part_text_cursor_pos_set(edje, CMDLINE_TEXT_PART, EDJE_CURSOR_MAIN, to);
+		edje_object_part_text_select_extend(edje, CMDLINE_TEXT_PART);
+	}
+
+	/* Edje inserts markup, which replaces the selection */
+	Eina_Strbuf *const buf = cmd->buf;
+	eina_strbuf_reset(buf);
+	eina_strbuf_append_length(buf, content + head, new_len - tail - head);
+	char *const markup = evas_textblock_text_utf8_to_markup(NULL, eina_strbuf_string_get(buf));
+	edje_object_part_text_insert(edje, CMDLINE_TEXT_PART, (markup) ? markup : "");
+	free(markup);
+
+	eina_strbuf_reset(cmd->content);
+	eina_strbuf_append_length(cmd->content, content, new_len);
+}
+
 static void style_apply(struct gui *const gui, const char *const part, const union color fg)
 {
 	Eina_Strbuf *const buf = gui->cmdline->buf;
@@ -32,10 +109,18 @@ void gui_cmdline_show(struct gui *const gui, const char *const content,
 {
 	EINA_SAFETY_ON_NULL_RETURN(firstc);
 	struct nvim *const nvim = gui->nvim;
+	struct cmdline *const cmd = gui->cmdline;
 
 	const Eina_Bool use_prompt = (firstc[0] == '\0');
 	const char *const prompt_signal =
 		(use_prompt) ? "eovim,cmdline,prompt,custom" : "eovim,cmdline,prompt,builtin";
+	Eina_Stringshare *const info = (use_prompt) ? prompt : firstc;
+
+	/* Stringshares can be compared by pointer */
+	if ((cmd->firstc == firstc) && (cmd->info == info))
+		goto content;
+	eina_stringshare_replace(&cmd->firstc, firstc);
+	eina_stringshare_replace(&cmd->info, info);
 
 	Eina_Stringshare *hi_group = eina_hash_find(nvim->cmdline_styles, firstc);
 	if (!hi_group) {
@@ -47,11 +132,15 @@ void gui_cmdline_show(struct gui *const gui, const char *const content,
 		}
 	}
 
-	const struct termview_style *const style = eina_hash_find(nvim->hl_groups, hi_group);
-	if (EINA_UNLIKELY(!style)) {
+	const uintptr_t hl_id = (uintptr_t)eina_hash_find(nvim->hl_groups, hi_group);
+	if (EINA_UNLIKELY(hl_id == 0u)) {
 		ERR("Failed to find group for '%s'", hi_group);
 		goto end;
 	}
+	const struct termview_style *const style =
+		termview_style_get(gui->termview, (t_int)(hl_id - 1u));
+	if (EINA_UNLIKELY(!style))
+		goto end;
 
 	style_apply(gui, CMDLINE_TEXT_PART, gui->default_fg);
 	style_apply(gui, CMDLINE_INFO_TEXT_PART, style->fg_color);
@@ -60,9 +149,9 @@ void gui_cmdline_show(struct gui *const gui, const char *const content,
 
 end:
 	elm_layout_signal_emit(gui->layout, prompt_signal, "eovim");
-	edje_object_part_text_unescaped_set(gui->edje, "eovim.cmdline:eovim.cmdline.text", content);
-	edje_object_part_text_unescaped_set(gui->edje, "eovim.cmdline_info:text",
-					    (use_prompt) ? prompt : firstc);
+	edje_object_part_text_unescaped_set(gui->edje, CMDLINE_INFO_TEXT_PART, info);
+content:
+	_content_update(cmd, content);
 
 	/* Show the completion panel */
 	if (!gui->cmdline->enabled) {
@@ -82,8 +171,13 @@ static void cmdline_shown_cb(void *const data, Evas_Object *const obj EINA_UNUSE
 
 void gui_cmdline_hide(struct gui *const gui)
 {
+	struct cmdline *const cmd = gui->cmdline;
 	elm_layout_signal_emit(gui->layout, "eovim,cmdline,hide", "eovim");
-	gui->cmdline->enabled = EINA_FALSE;
+	cmd->enabled = EINA_FALSE;
+
+	/* Styles may have changed before the command-line shows up again */
+	eina_stringshare_replace(&cmd->firstc, NULL);
+	eina_stringshare_replace(&cmd->info, NULL);
 }
 
 Eina_Bool gui_cmdline_enabled_get(const struct gui *const gui)
@@ -93,8 +187,13 @@ Eina_Bool gui_cmdline_enabled_get(const struct gui *const gui)
 
 void gui_cmdline_cursor_pos_set(struct gui *const gui, const size_t pos)
 {
+	/* Neovim gives the position in bytes, and Edje expects characters. Only
+	 * the cursor moves: the text is left untouched. */
+	const Eina_Strbuf *const content = gui->cmdline->content;
+	const size_t bytes = MIN(pos, eina_strbuf_length_get(content));
+	const size_t chars = _utf8_chars_count(eina_strbuf_string_get(content), bytes);
 	edje_object_part_text_cursor_pos_set(gui->edje, CMDLINE_TEXT_PART, EDJE_CURSOR_MAIN,
-					     (int)pos);
+					     (int)chars);
 
 	int ox, oy, cx, cy, cw, ch;
 	edje_object_part_geometry_get(gui->edje, "eovim.cmdline", &ox, &oy, NULL, NULL);
@@ -111,13 +210,33 @@ struct cmdline *cmdline_add(struct gui *const gui)
 	}
 	cmd->gui = gui;
 	cmd->buf = eina_strbuf_new();
+	cmd->content = eina_strbuf_new();
+	if (EINA_UNLIKELY((!cmd->buf) || (!cmd->content))) {
+		CRI("Failed to create string buffer");
+		goto fail;
+	}
+
+	/* What changed is selected, to be replaced */
+	edje_object_part_text_select_allow_set(gui->edje, CMDLINE_TEXT_PART, EINA_TRUE);
+
 	elm_layout_signal_callback_add(gui->layout, "eovim,cmdline,shown", "eovim",
 				       &cmdline_shown_cb, cmd);
 	return cmd;
+
+fail:
+	if (cmd->content)
+		eina_strbuf_free(cmd->content);
+	if (cmd->buf)
+		eina_strbuf_free(cmd->buf);
+	free(cmd);
+	return NULL;
 }
 
 void cmdline_del(struct cmdline *const cmd)
 {
+	eina_stringshare_del(cmd->firstc);
+	eina_stringshare_del(cmd->info);
+	eina_strbuf_free(cmd->content);
 	eina_strbuf_free(cmd->buf);
 	free(cmd);
 }
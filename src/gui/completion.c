@@ -6,16 +6,37 @@
 
 #include "gui_private.h"
 
+struct completion_item;
+
+/* Neovim may send thousands of candidates at once (e.g. from language
+ * servers). They are all stored in a single block of memory, the strings
+ * following the array of items. Only the first items are added in the genlist
+ * when the popup is shown: the next ones are added by batches, when they are
+ * about to be selected or scrolled to. The block is kept when the popup is
+ * hidden, and only reallocated when it is too small. */
+#define COMPLETION_BATCH 64u
+
 struct completion {
 	struct popupmenu pop;
 	Evas_Object *edje;
 
-	/* Position at which the completion popup must be displayed */
+	/* Position at which the completion popup must be displayed, within the
+	 * grid 'grid' */
+	t_int grid;
 	unsigned int col;
 	unsigned int row;
 
+	struct completion_item *items; /**< Block holding the items and their strings */
+	size_t reserved; /**< Size in bytes of @p items */
+	char *strings; /**< Where the strings of the next item go, in @p items */
+	unsigned int count; /**< Items stored in @p items */
+	unsigned int capacity; /**< Items that @p items can hold */
+	unsigned int appended; /**< Items that have been added in the genlist */
+	unsigned int widest; /**< Index of the item with the longest strings */
+	uint32_t widest_size; /**< Size in bytes of the strings of @p widest */
+
 	int has_kind;
-	int max_len;
+	int max_len; /**< Cells of the widest item. Negative until computed */
 };
 static_assert(offsetof(struct completion, pop) == 0, "popupmenu must be the first element");
 
@@ -28,64 +49,81 @@ static Elm_Genlist_Item_Class *_completion_itc = NULL;
  */
 #define COMPLETION_GET(PopUp) ((struct completion *)PopUp)
 
-/* XXX Not sure if that's the best structure, given that some strings are small... */
 struct completion_item {
 	struct completion *completion;
 	const char *word;
 	const char *kind;
 	const char *menu;
 	const char *info;
-	/* Buffer containing the memory pointed to by word, kind, menu, info */
-	char mem[];
 };
 
+/* Copy @p size bytes of @p str in the block of strings, and NUL-terminate them */
+static inline const char *_string_store(struct completion *const cmpl, const char *const str,
+					const uint32_t size)
+{
+	char *const buf = cmpl->strings;
+	memcpy(buf, str, size);
+	buf[size] = '\0';
+	cmpl->strings += size + 1u;
+	return buf;
+}
+
 static struct completion_item *completion_item_new(struct completion *const cmpl,
 						   const char *const word, const uint32_t word_size,
 						   const char *const kind, const uint32_t kind_size,
 						   const char *const menu, const uint32_t menu_size,
 						   const char *const info, const uint32_t info_size)
 {
-	/*
-	 * word_ptr + kind_ptr + menu_ptr + info_ptr +
-	 * [word + \0] + [kind + \0] + [menu + \0] + [info] + \0]
-	 */
-	const size_t buf_size =
-		sizeof(struct completion_item) + word_size + kind_size + menu_size + info_size + 4u;
-
-	struct completion_item *const item = malloc(buf_size);
-	if (EINA_UNLIKELY(!item)) {
-		CRI("Failed to allocate memory (%zu bytes)", buf_size);
+	if (EINA_UNLIKELY(cmpl->count >= cmpl->capacity)) {
+		ERR("No room for completion item %u", cmpl->count);
 		return NULL;
 	}
-	item->completion = cmpl;
-	char *buf = item->mem;
-
-	item->word = buf;
-	memcpy(buf, word, word_size);
-	buf[word_size] = '\0';
-	buf += (word_size + 1u);
 
-	item->kind = buf;
-	memcpy(buf, kind, kind_size);
-	buf[kind_size] = '\0';
-	buf += (kind_size + 1u);
+	struct completion_item *const item = &(cmpl->items[cmpl->count++]);
+	item->completion = cmpl;
+	item->word = _string_store(cmpl, word, word_size);
+	item->kind = _string_store(cmpl, kind, kind_size);
+	item->menu = _string_store(cmpl, menu, menu_size);
+	item->info = _string_store(cmpl, info, info_size);
+	return item;
+}
 
-	item->menu = buf;
-	memcpy(buf, menu, menu_size);
-	buf[menu_size] = '\0';
-	buf += (menu_size + 1u);
+Eina_Bool gui_completion_reserve(struct gui *const gui, const unsigned int count,
+				 const size_t bytes)
+{
+	struct completion *const cmpl = gui->completion;
 
-	item->info = buf;
-	memcpy(buf, info, info_size);
-	buf[info_size] = '\0';
+	/* The strings are NUL-terminated: there are four of them per item */
+	const size_t size = count * sizeof(struct completion_item) + bytes + 4u * count;
+	if ((size > cmpl->reserved) || (!cmpl->items)) {
+		struct completion_item *const items = malloc(MAX(size, 1u));
+		if (EINA_UNLIKELY(!items)) {
+			CRI("Failed to allocate memory (%zu bytes)", size);
+			return EINA_FALSE;
+		}
+		free(cmpl->items);
+		cmpl->items = items;
+		cmpl->reserved = MAX(size, 1u);
+	}
+	cmpl->strings = (char *)(cmpl->items + count);
+	cmpl->capacity = count;
+	cmpl->count = 0u;
+	return EINA_TRUE;
+}
 
-	return item;
+/* Add the items up to @p upto (exclusive) in the genlist */
+static void _completion_realize(struct completion *const cmpl, const unsigned int upto)
+{
+	const unsigned int end = MIN(upto, cmpl->count);
+	for (; cmpl->appended < end; cmpl->appended++)
+		popupmenu_append(&cmpl->pop, &(cmpl->items[cmpl->appended]));
 }
 
-static void completion_item_del(void *const data, Evas_Object *const obj EINA_UNUSED)
+static void _completion_edge_bottom_cb(void *const data, Evas_Object *const obj EINA_UNUSED,
+				       void *const info EINA_UNUSED)
 {
-	struct completion_item *const item = data;
-	free(item);
+	struct completion *const cmpl = data;
+	_completion_realize(cmpl, cmpl->appended + COMPLETION_BATCH);
 }
 
 static Evas_Object *completion_resuable_content_get(void *const data, Evas_Object *const obj,
@@ -148,30 +186,36 @@ void gui_completion_append(struct gui *const gui, const char *const word, const
 	if (EINA_UNLIKELY(!item))
 		return;
 
-	/* Retrieve the amount of codepoints used in the completion item. This will give
-	 * a *rough* estimation of the width of the completion... If in the end it is too big,
-	 * we will truncate with an ellipsis. I know this is fundamentally incorrect, because
-	 * we should compute the actual width, but this is quite complex to do, and this
-	 * heuristic will cover most of the cases (none I will ever face... I guess) */
-	const int len = eina_unicode_utf8_get_len(item->word) +
-			eina_unicode_utf8_get_len(item->menu) +
-			eina_unicode_utf8_get_len(item->kind);
-
-	cmpl->max_len = MAX(cmpl->max_len, len);
+	/* Only the sizes are compared here: codepoints are counted once, for
+	 * the widest item, when the popup is laid out */
+	const uint32_t size = word_size + menu_size + kind_size;
+	if (size > cmpl->widest_size) {
+		cmpl->widest_size = size;
+		cmpl->widest = cmpl->count - 1u;
+	}
 	cmpl->has_kind |= (kind_size != 0);
-	popupmenu_append(&cmpl->pop, item);
+}
+
+static void _completion_items_clear(struct completion *const cmpl)
+{
+	cmpl->strings = NULL;
+	cmpl->count = cmpl->capacity = cmpl->appended = 0u;
+	cmpl->widest = 0u;
+	cmpl->widest_size = 0u;
+	cmpl->max_len = -1;
+	cmpl->has_kind = 0;
 }
 
 void gui_completion_reset(struct gui *const gui)
 {
 	popupmenu_clear(&gui->completion->pop);
-	gui->completion->has_kind = 0;
-	gui->completion->max_len = 0;
+	_completion_items_clear(gui->completion);
 }
 
 static void completion_hide(struct popupmenu *const pop)
 {
 	struct completion *const cmpl = COMPLETION_GET(pop);
+	_completion_items_clear(cmpl);
 	evas_object_hide(cmpl->edje);
 	edje_object_signal_emit(cmpl->edje, "eovim,completion,hide", "eovim");
 }
@@ -198,7 +242,8 @@ static void completion_resize(struct popupmenu *const pop)
 	/* Retrieve the geometry of the cell at which the completion must be displayed, and
 	 * the overall size of the termview */
 	int cx, cy, cw, ch;
-	termview_cell_geometry_get(gui->termview, cmpl->col, cmpl->row, &cx, &cy, &cw, &ch);
+	termview_cell_geometry_get(gui->termview, cmpl->grid, cmpl->col, cmpl->row, &cx, &cy, &cw,
+				   &ch);
 	unsigned int cols, rows;
 	termview_size_get(gui->termview, &cols, &rows);
 
@@ -208,13 +253,25 @@ static void completion_resize(struct popupmenu *const pop)
 	if (xpos < 0)
 		xpos = 0;
 
-	/* Determine whether the completion shall appear below or above the cursor */
-	if (cmpl->row <= rows / 2)
+	/* Determine whether the completion shall appear below or above the cursor.
+	 * The cell may not be in the main grid, so rely on its position. */
+	if ((unsigned int)cy <= (rows * (unsigned int)ch) / 2u)
 		ypos = cy + ch + 2;
 	else
 		ypos = cy - height - 8;
 
-	const int chars = cmpl->max_len + 1 + (cmpl->has_kind ? 2 : 0);
+	/* Retrieve the amount of cells used in the widest completion item. The widest item is
+	 * only guessed from the size of its strings, so this gives a *rough* estimation of the
+	 * width of the completion... If in the end it is too big, we will truncate with an
+	 * ellipsis. Double-width characters are counted twice. */
+	if ((cmpl->max_len < 0) && (cmpl->count > 0u)) {
+		const struct completion_item *const item = &(cmpl->items[cmpl->widest]);
+		cmpl->max_len = (int)(termview_text_width_get(gui->termview, item->word) +
+				      termview_text_width_get(gui->termview, item->menu) +
+				      termview_text_width_get(gui->termview, item->kind));
+	}
+
+	const int chars = MAX(cmpl->max_len, 0) + 1 + (cmpl->has_kind ? 2 : 0);
 	int width = (chars + 4) * pop->cell_width; /* Add more chars for space */
 	if (xpos + width > max_width)
 		width = max_width - xpos;
@@ -224,15 +281,20 @@ static void completion_resize(struct popupmenu *const pop)
 	evas_object_move(cmpl->edje, xpos, ypos);
 }
 
-void gui_completion_show(struct gui *const gui, const unsigned int col, const unsigned int row)
+void gui_completion_show(struct gui *const gui, const t_int grid, const unsigned int col,
+			 const unsigned int row)
 {
 	struct completion *const cmpl = gui->completion;
 	struct popupmenu *const pop = &cmpl->pop;
 	gui->active_popup = pop;
 
+	cmpl->grid = grid;
 	cmpl->col = col;
 	cmpl->row = row;
 
+	/* The other items are added when they are about to be shown */
+	_completion_realize(cmpl, COMPLETION_BATCH);
+
 	evas_object_show(pop->table);
 	evas_object_show(pop->genlist);
 	evas_object_show(cmpl->edje);
@@ -242,9 +304,17 @@ void gui_completion_show(struct gui *const gui, const unsigned int col, const un
 	pop->iface->resize(pop);
 }
 
+static void completion_reveal(struct popupmenu *const pop, const ssize_t index)
+{
+	/* Keep a batch of items after the selected one, so the genlist can
+	 * scroll smoothly */
+	_completion_realize(COMPLETION_GET(pop), (unsigned int)index + COMPLETION_BATCH);
+}
+
 static const struct popupmenu_interface completion_iface = {
 	.hide = &completion_hide,
 	.resize = &completion_resize,
+	.reveal = &completion_reveal,
 };
 
 struct completion *gui_completion_add(struct gui *const gui)
@@ -258,6 +328,9 @@ struct completion *gui_completion_add(struct gui *const gui)
 	const char *const edje_file = main_edje_file_get();
 
 	popupmenu_setup(pop, gui, &completion_iface, _completion_itc);
+	evas_object_smart_callback_add(pop->genlist, "edge,bottom", &_completion_edge_bottom_cb,
+				       cmpl);
+	cmpl->max_len = -1;
 	Evas *const evas = evas_object_evas_get(gui->win);
 
 	cmpl->edje = edje_object_add(evas);
@@ -270,6 +343,7 @@ struct completion *gui_completion_add(struct gui *const gui)
 void gui_completion_del(struct completion *const cmpl)
 {
 	popupmenu_del(&cmpl->pop);
+	free(cmpl->items);
 	free(cmpl);
 }
 
@@ -288,8 +362,8 @@ Eina_Bool gui_completion_init(void)
 		return EINA_FALSE;
 	}
 	_completion_itc->item_style = "full";
+	/* Items belong to the completion, not to the genlist */
 	_completion_itc->func.reusable_content_get = &completion_resuable_content_get;
-	_completion_itc->func.del = &completion_item_del;
 	return EINA_TRUE;
 }
 
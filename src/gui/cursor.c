@@ -15,33 +15,58 @@ struct cursor {
 	Evas_Object *edje;
 	struct gui *gui;
 	const struct mode *mode;
+	Eina_Bool focused;
+	Eina_Bool idle; /**< The window is in idle power mode (see gui.c) */
 
+	/* The cursor is moved by a single animator, that lives as long as the
+	 * cursor. It is frozen while the cursor stands still, so it never wakes
+	 * the main loop up for nothing. A new position retargets the motion from
+	 * wherever the cursor currently is. */
 	struct {
-		int start_x;
-		int start_y;
-		int start_w;
-		int start_h;
-		int end_x;
-		int end_y;
-		int end_w;
-		int end_h;
+		Ecore_Animator *animator;
+		double start_time; /**< Loop time when the motion started */
+		Eina_Rectangle from;
+		Eina_Rectangle to;
+		Eina_Bool running;
 	} anim;
 };
 
-static Eina_Bool _animate_cursor_cb(void *const data, const double pos)
+static void _cursor_geometry_apply(struct cursor *const cur, const Eina_Rectangle *const geo)
 {
-	struct gui *const gui = data;
-	struct cursor *const cur = gui->cursor;
-	const int x =
-		cur->anim.start_x + (int)((double)(cur->anim.end_x - cur->anim.start_x) * pos);
-	const int y =
-		cur->anim.start_y + (int)((double)(cur->anim.end_y - cur->anim.start_y) * pos);
-	const int w =
-		cur->anim.start_w + (int)((double)(cur->anim.end_w - cur->anim.start_w) * pos);
-	const int h =
-		cur->anim.start_h + (int)((double)(cur->anim.end_h - cur->anim.start_h) * pos);
-	evas_object_move(cur->edje, x, y);
-	evas_object_resize(cur->edje, w, h);
+	evas_object_move(cur->edje, geo->x, geo->y);
+	evas_object_resize(cur->edje, geo->w, geo->h);
+}
+
+static inline int _lerp(const int from, const int to, const double pos)
+{
+	return from + (int)((double)(to - from) * pos);
+}
+
+static Eina_Bool _animate_cursor_cb(void *const data)
+{
+	struct cursor *const cur = data;
+	const struct gui *const gui = cur->gui;
+	const double duration = gui->theme.cursor_animation_duration;
+	const double elapsed = ecore_loop_time_get() - cur->anim.start_time;
+	const double progress = (duration > 0.0) ? MIN(elapsed / duration, 1.0) : 1.0;
+	const double pos =
+		ecore_animator_pos_map(progress, gui->theme.cursor_animation_style, 0.0, 0.0);
+
+	const Eina_Rectangle *const from = &cur->anim.from;
+	const Eina_Rectangle *const to = &cur->anim.to;
+	const Eina_Rectangle geo = {
+		.x = _lerp(from->x, to->x, pos),
+		.y = _lerp(from->y, to->y, pos),
+		.w = _lerp(from->w, to->w, pos),
+		.h = _lerp(from->h, to->h, pos),
+	};
+	_cursor_geometry_apply(cur, (progress >= 1.0) ? to : &geo);
+
+	/* The motion is over: sleep until the next one */
+	if (progress >= 1.0) {
+		cur->anim.running = EINA_FALSE;
+		ecore_animator_freeze(cur->anim.animator);
+	}
 	return ECORE_CALLBACK_RENEW;
 }
 
@@ -49,19 +74,37 @@ static void cursor_update(struct gui *const gui, const int to_x, const int to_y,
 			  const int to_h)
 {
 	struct cursor *const cur = gui->cursor;
-	if (gui->theme.cursor_animated) {
-		evas_object_geometry_get(cur->edje, &cur->anim.start_x, &cur->anim.start_y,
-					 &cur->anim.start_w, &cur->anim.start_h);
-		cur->anim.end_x = to_x;
-		cur->anim.end_y = to_y;
-		cur->anim.end_w = to_w;
-		cur->anim.end_h = to_h;
-		ecore_animator_timeline_add(gui->theme.cursor_animation_duration,
-					    &_animate_cursor_cb, gui);
-	} else {
-		evas_object_move(cur->edje, to_x, to_y);
-		evas_object_resize(cur->edje, to_w, to_h);
+	const Eina_Rectangle to = { .x = to_x, .y = to_y, .w = to_w, .h = to_h };
+
+	if (!gui->theme.cursor_animated) {
+		if (cur->anim.running) {
+			cur->anim.running = EINA_FALSE;
+			ecore_animator_freeze(cur->anim.animator);
+		}
+		_cursor_geometry_apply(cur, &to);
+		return;
 	}
+
+	/* Already going there, or already there */
+	Eina_Rectangle now;
+	evas_object_geometry_get(cur->edje, &now.x, &now.y, &now.w, &now.h);
+	if (eina_rectangles_equal(&to, (cur->anim.running) ? &cur->anim.to : &now))
+		return;
+
+	if (!cur->anim.animator) {
+		cur->anim.animator = ecore_animator_add(&_animate_cursor_cb, cur);
+		if (EINA_UNLIKELY(!cur->anim.animator)) {
+			ERR("Failed to create animator. The cursor will not be animated.");
+			_cursor_geometry_apply(cur, &to);
+			return;
+		}
+	} else if (!cur->anim.running)
+		ecore_animator_thaw(cur->anim.animator);
+
+	cur->anim.from = now;
+	cur->anim.to = to;
+	cur->anim.start_time = ecore_loop_time_get();
+	cur->anim.running = EINA_TRUE;
 }
 
 void gui_cursor_calc(struct gui *const gui, const int x, const int y, const int w, const int h)
@@ -96,19 +139,39 @@ void gui_cursor_calc(struct gui *const gui, const int x, const int y, const int
 	}
 }
 
+/* The blinking runs on timers of the theme. It only runs when someone can see
+ * it, so an unfocused or idle window never wakes up to blink. */
+static void _blink_start(struct cursor *const cur)
+{
+	if (!cur->focused || cur->idle || !cur->mode || (cur->mode->blinkon == 0))
+		return;
+	Edje_Message_Int msg = { .val = 1 }; /* may_blink := TRUE */
+	edje_object_message_send(cur->edje, EDJE_MESSAGE_INT, THEME_MSG_MAY_BLINK_SET, &msg);
+	edje_object_signal_emit(cur->edje, "eovim,blink,start", "eovim");
+}
+
 void cursor_focus_set(struct cursor *const cur, const Eina_Bool focused)
 {
+	cur->focused = !!focused;
 	if (focused) {
-		Edje_Message_Int msg = { .val = 1 }; /* may_blink := TRUE */
-		edje_object_message_send(cur->edje, EDJE_MESSAGE_INT, THEME_MSG_MAY_BLINK_SET,
-					 &msg);
 		edje_object_signal_emit(cur->edje, "focus,in", "eovim");
-		if (cur->mode && cur->mode->blinkon != 0)
-			edje_object_signal_emit(cur->edje, "eovim,blink,start", "eovim");
+		_blink_start(cur);
 	} else
 		edje_object_signal_emit(cur->edje, "focus,out", "eovim");
 }
 
+void cursor_idle_set(struct cursor *const cur, const Eina_Bool idle)
+{
+	cur->idle = !!idle;
+
+	/* Freeze the transitions of the theme as well */
+	edje_object_play_set(cur->edje, !idle);
+	if (idle)
+		edje_object_signal_emit(cur->edje, "eovim,blink,stop", "eovim");
+	else
+		_blink_start(cur);
+}
+
 void cursor_mode_set(struct cursor *const cur, const struct mode *const mode)
 {
 	/* Update the blink parameters *********************************************/
@@ -119,18 +182,16 @@ void cursor_mode_set(struct cursor *const cur, const struct mode *const mode)
 	msg->val[1] = (double)mode->blinkon / 1000.0;
 	msg->val[2] = (double)mode->blinkoff / 1000.0;
 
-	/* If we requested the cursor to blink, make it blink */
-	if (mode->blinkon != 0) {
-		/* If the cursor was blinking, we stop the blinking */
-		if (cur->mode && cur->mode->blinkon)
-			edje_object_signal_emit(cur->edje, "eovim,blink,stop", "eovim");
+	/* If the cursor was blinking, we stop the blinking */
+	if ((mode->blinkon == 0) || (cur->mode && cur->mode->blinkon))
+		edje_object_signal_emit(cur->edje, "eovim,blink,stop", "eovim");
+	if (mode->blinkon != 0)
 		edje_object_message_send(cur->edje, EDJE_MESSAGE_FLOAT_SET, THEME_MSG_BLINK_SET,
 					 msg);
-		edje_object_signal_emit(cur->edje, "eovim,blink,start", "eovim");
-	} else
-		edje_object_signal_emit(cur->edje, "eovim,blink,stop", "eovim");
 
+	/* If we requested the cursor to blink, make it blink */
 	cur->mode = mode;
+	_blink_start(cur);
 }
 
 void gui_cursor_key_pressed(struct gui *const gui)
@@ -170,6 +231,7 @@ struct cursor *cursor_add(struct gui *const gui)
 	Evas *const evas = evas_object_evas_get(gui->win);
 	cur->edje = edje_object_add(evas);
 	cur->gui = gui;
+	cur->focused = EINA_TRUE;
 
 	edje_object_file_set(cur->edje, main_edje_file_get(), "eovim/cursor");
 	evas_object_pass_events_set(cur->edje, EINA_TRUE);
@@ -182,5 +244,7 @@ struct cursor *cursor_add(struct gui *const gui)
 
 void cursor_del(struct cursor *const cur)
 {
+	if (cur->anim.animator)
+		ecore_animator_del(cur->anim.animator);
 	free(cur);
 }
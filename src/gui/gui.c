@@ -6,16 +6,52 @@
 #include <eovim/main.h>
 #include <eovim/log.h>
 #include <eovim/nvim_api.h>
+#include <eovim/profile.h>
+#include <eovim/unicode.h>
 
 #include "gui_private.h"
 
+/* A tab of the tabline. Its widget is kept as long as the tab lives */
+struct tab {
+	unsigned int id; /**< Handle of the tab in neovim */
+	Evas_Object *edje;
+	Eina_Stringshare *name;
+	Eina_Bool active;
+};
+
 static void _tabs_shown_cb(void *data, Evas_Object *obj, const char *emission, const char *source);
+static void _tabs_truncate(struct gui *gui, unsigned int count);
+
+static void _power_update(struct gui *const gui)
+{
+	const Eina_Bool idle = (!gui->power.focused) || gui->power.iconified;
+	if (idle == gui->power.idle)
+		return;
+
+	/* Freeze the animations and timers of the theme. Evas does not render
+	 * frames when nothing changed, so the window then draws nothing until
+	 * neovim sends something. */
+	INF("%s idle power mode", (idle) ? "Entering" : "Leaving");
+	gui->power.idle = idle;
+	edje_object_play_set(gui->edje, !idle);
+	cursor_idle_set(gui->cursor, idle);
+}
+
+static Eina_Bool _wakeup_cb(void *const data)
+{
+	struct gui *const gui = data;
+	gui->power.wakeups++;
+	PROFILE_COUNT(PROFILE_COUNTER_WAKEUPS, 1u);
+	return ECORE_CALLBACK_RENEW;
+}
 
 static void _focus_in_cb(void *data, Evas_Object *obj EINA_UNUSED, void *event EINA_UNUSED)
 {
 	struct gui *const gui = data;
 	evas_object_focus_set(gui->termview, EINA_TRUE);
 	cursor_focus_set(gui->cursor, EINA_TRUE);
+	gui->power.focused = EINA_TRUE;
+	_power_update(gui);
 }
 
 static void _focus_out_cb(void *data, Evas_Object *obj EINA_UNUSED, void *event EINA_UNUSED)
@@ -23,6 +59,22 @@ static void _focus_out_cb(void *data, Evas_Object *obj EINA_UNUSED, void *event
 	struct gui *const gui = data;
 	evas_object_focus_set(gui->termview, EINA_FALSE);
 	cursor_focus_set(gui->cursor, EINA_FALSE);
+	gui->power.focused = EINA_FALSE;
+	_power_update(gui);
+}
+
+static void _iconified_cb(void *data, Evas_Object *obj EINA_UNUSED, void *event EINA_UNUSED)
+{
+	struct gui *const gui = data;
+	gui->power.iconified = EINA_TRUE;
+	_power_update(gui);
+}
+
+static void _normal_cb(void *data, Evas_Object *obj EINA_UNUSED, void *event EINA_UNUSED)
+{
+	struct gui *const gui = data;
+	gui->power.iconified = EINA_FALSE;
+	_power_update(gui);
 }
 
 static void _win_close_cb(void *data, Evas_Object *obj EINA_UNUSED, void *info EINA_UNUSED)
@@ -50,8 +102,9 @@ Eina_Bool gui_add(struct gui *gui, struct nvim *nvim)
 	EINA_SAFETY_ON_NULL_RETURN_VAL(gui, EINA_FALSE);
 
 	gui->nvim = nvim;
+	gui->width_flags = UNICODE_EMOJI_WIDE; /* Neovim's defaults */
 
-	gui->tabs = eina_inarray_new(sizeof(unsigned int), 4);
+	gui->tabs = eina_inarray_new(sizeof(struct tab), 4);
 	if (EINA_UNLIKELY(!gui->tabs)) {
 		CRI("Failed to create inline array");
 		goto fail;
@@ -64,6 +117,7 @@ Eina_Bool gui_add(struct gui *gui, struct nvim *nvim)
 		goto fail;
 	}
 	elm_win_autodel_set(gui->win, EINA_TRUE);
+	profile_evas_attach(evas_object_evas_get(gui->win));
 	evas_object_smart_callback_add(gui->win, "delete,request", _win_close_cb, nvim);
 
 	/* Main Layout setup */
@@ -78,7 +132,15 @@ Eina_Bool gui_add(struct gui *gui, struct nvim *nvim)
 	elm_win_resize_object_add(gui->win, gui->layout);
 	evas_object_smart_callback_add(gui->win, "focus,in", _focus_in_cb, gui);
 	evas_object_smart_callback_add(gui->win, "focus,out", _focus_out_cb, gui);
-	evas_object_smart_callback_add(gui->win, "focus,out", _focus_out_cb, gui);
+	evas_object_smart_callback_add(gui->win, "iconified", _iconified_cb, gui);
+	evas_object_smart_callback_add(gui->win, "normal", _normal_cb, gui);
+
+	/* The window is deemed focused until told otherwise */
+	gui->power.focused = EINA_TRUE;
+	gui->power.since = ecore_time_get();
+	gui->power.exiter = ecore_idle_exiter_add(&_wakeup_cb, gui);
+	if (EINA_UNLIKELY(!gui->power.exiter))
+		WRN("Failed to create idle exiter. Wakeups will not be counted.");
 
 	/* ========================================================================
 	 * Termview GUI objects
@@ -87,8 +149,12 @@ Eina_Bool gui_add(struct gui *gui, struct nvim *nvim)
 	gui->cursor = cursor_add(gui);
 
 	gui->cmdline = cmdline_add(gui);
+	if (EINA_UNLIKELY(!gui->cmdline))
+		return EINA_FALSE;
 
 	gui->termview = termview_add(gui->layout, nvim);
+	if (EINA_UNLIKELY(!gui->termview))
+		return EINA_FALSE;
 	evas_object_smart_callback_add(gui->termview, "relayout", _termview_relayout_cb, gui);
 	evas_object_hide(gui->termview);
 
@@ -125,10 +191,27 @@ void gui_del(struct gui *gui)
 	cmdline_del(gui->cmdline);
 	gui_wildmenu_del(gui->wildmenu);
 	gui_completion_del(gui->completion);
+	_tabs_truncate(gui, 0u);
 	eina_inarray_free(gui->tabs);
+	if (gui->power.exiter)
+		ecore_idle_exiter_del(gui->power.exiter);
 	evas_object_del(gui->win);
 }
 
+Eina_Bool gui_wakeups_get(struct gui *const gui, uint64_t *const total, double *const per_minute)
+{
+	const double now = ecore_time_get();
+	const double minutes = (now - gui->power.since) / 60.0;
+
+	*total = gui->power.wakeups;
+	*per_minute = (minutes > 0.0) ?
+			      (double)(gui->power.wakeups - gui->power.reported) / minutes :
+			      0.0;
+	gui->power.reported = gui->power.wakeups;
+	gui->power.since = now;
+	return gui->power.idle;
+}
+
 static void _die_cb(void *data, Evas_Object *obj EINA_UNUSED, void *info EINA_UNUSED)
 {
 	struct gui *const gui = data;
@@ -327,17 +410,17 @@ static void _tab_activate_cb(void *data, Evas_Object *obj, const char *sig EINA_
     * We go through the list of tabs, to find the current index we are on and
     * the index of the tab to be activated.
     */
-	unsigned int *it;
+	struct tab *it;
 	unsigned int active_index = UINT_MAX;
 	unsigned int tab_index = UINT_MAX;
 	EINA_INARRAY_FOREACH (gui->tabs, it) {
 		/* When found a candidate, evaluate the index by some pointer
          * arithmetic.  This avoids to keep around a counter. At this
          * point, gui->active_tabs != id. */
-		if (*it == id)
-			tab_index = (unsigned)(it - (unsigned int *)gui->tabs->members);
-		else if (*it == gui->active_tab)
-			active_index = (unsigned)(it - (unsigned int *)gui->tabs->members);
+		if (it->id == id)
+			tab_index = (unsigned)(it - (struct tab *)gui->tabs->members);
+		else if (it->id == gui->active_tab)
+			active_index = (unsigned)(it - (struct tab *)gui->tabs->members);
 	}
 	if (EINA_UNLIKELY((tab_index == UINT_MAX) || (active_index == UINT_MAX))) {
 		CRI("Something went wrong while finding the tab index: %u, %u", tab_index,
@@ -353,45 +436,107 @@ static void _tab_activate_cb(void *data, Evas_Object *obj, const char *sig EINA_
 	nvim_api_command(gui->nvim, cmd, (size_t)bytes, NULL, NULL);
 }
 
-void gui_tabs_reset(struct gui *gui)
+/* Remove the tabs that come after the @p count first ones */
+static void _tabs_truncate(struct gui *const gui, const unsigned int count)
+{
+	while (eina_inarray_count(gui->tabs) > count) {
+		struct tab *const tab = eina_inarray_pop(gui->tabs);
+		edje_object_part_box_remove(gui->edje, "eovim.tabline", tab->edje);
+		evas_object_del(tab->edje);
+		eina_stringshare_del(tab->name);
+	}
+}
+
+static Evas_Object *_tab_widget_add(struct gui *const gui, const unsigned int id)
+{
+	Evas *const evas = evas_object_evas_get(gui->layout);
+	Evas_Object *const edje = edje_object_add(evas);
+	evas_object_data_set(edje, "tab_id", (void *)(uintptr_t)id);
+	edje_object_file_set(edje, main_edje_file_get(), "eovim/tab");
+	edje_object_signal_callback_add(edje, "tab,close", "eovim", _tab_close_cb, gui);
+	edje_object_signal_callback_add(edje, "tab,activate", "eovim", _tab_activate_cb, gui);
+	evas_object_size_hint_align_set(edje, EVAS_HINT_FILL, EVAS_HINT_FILL);
+	evas_object_size_hint_weight_set(edje, EVAS_HINT_EXPAND, EVAS_HINT_EXPAND);
+	evas_object_show(edje);
+	return edje;
+}
+
+void gui_tabs_update_begin(struct gui *gui)
+{
+	gui->tabs_updated = 0u;
+}
+
+void gui_tabs_update_end(struct gui *gui)
 {
-	gui->active_tab = 0;
-	eina_inarray_flush(gui->tabs);
-	edje_object_part_box_remove_all(gui->edje, "eovim.tabline", EINA_TRUE);
+	_tabs_truncate(gui, gui->tabs_updated);
 }
 
 void gui_tabs_show(struct gui *gui)
 {
-	elm_layout_signal_emit(gui->layout, "eovim,tabs,show", "eovim");
+	if (!gui->tabs_shown) {
+		elm_layout_signal_emit(gui->layout, "eovim,tabs,show", "eovim");
+		gui->tabs_shown = EINA_TRUE;
+	}
 }
 
 void gui_tabs_hide(struct gui *gui)
 {
-	elm_layout_signal_emit(gui->layout, "eovim,tabs,hide", "eovim");
+	if (gui->tabs_shown) {
+		elm_layout_signal_emit(gui->layout, "eovim,tabs,hide", "eovim");
+		gui->tabs_shown = EINA_FALSE;
+	}
 }
 
-void gui_tabs_add(struct gui *gui, const char *name, unsigned int id, Eina_Bool active)
+void gui_tabs_update(struct gui *gui, Eina_Stringshare *name, unsigned int id, Eina_Bool active)
 {
-	Evas *const evas = evas_object_evas_get(gui->layout);
+	const unsigned int pos = gui->tabs_updated;
+	const unsigned int count = eina_inarray_count(gui->tabs);
+	struct tab *tab = (pos < count) ? eina_inarray_nth(gui->tabs, pos) : NULL;
+
+	/* The tab is usually where it was. If it is not, find it further in the
+	 * tabline (the tabs before pos are already updated), and move it at its
+	 * new place. Otherwise, this is a new tab. */
+	if ((!tab) || (tab->id != id)) {
+		unsigned int i;
+		for (i = pos + 1u; i < count; i++) {
+			const struct tab *const candidate = eina_inarray_nth(gui->tabs, i);
+			if (candidate->id == id)
+				break;
+		}
 
-	/* Register the current tab */
-	eina_inarray_push(gui->tabs, &id);
+		struct tab moved;
+		if (i < count) {
+			moved = *(const struct tab *)eina_inarray_nth(gui->tabs, i);
+			eina_inarray_remove_at(gui->tabs, i);
+			edje_object_part_box_remove(gui->edje, "eovim.tabline", moved.edje);
+		} else {
+			moved = (struct tab){ .id = id, .edje = _tab_widget_add(gui, id) };
+		}
 
-	Evas_Object *const edje = edje_object_add(evas);
-	evas_object_data_set(edje, "tab_id", (void *)(uintptr_t)id);
-	edje_object_file_set(edje, main_edje_file_get(), "eovim/tab");
-	edje_object_signal_callback_add(edje, "tab,close", "eovim", _tab_close_cb, gui);
-	edje_object_signal_callback_add(edje, "tab,activate", "eovim", _tab_activate_cb, gui);
-	evas_object_size_hint_align_set(edje, EVAS_HINT_FILL, EVAS_HINT_FILL);
-	evas_object_size_hint_weight_set(edje, EVAS_HINT_EXPAND, EVAS_HINT_EXPAND);
-	edje_object_part_text_set(edje, "eovim.tab.title", name);
-	evas_object_show(edje);
+		if (EINA_UNLIKELY(eina_inarray_insert_at(gui->tabs, pos, &moved) != EINA_TRUE)) {
+			CRI("Failed to register tab %u", id);
+			evas_object_del(moved.edje);
+			eina_stringshare_del(moved.name);
+			return;
+		}
+		edje_object_part_box_insert_at(gui->edje, "eovim.tabline", moved.edje, pos);
+		tab = eina_inarray_nth(gui->tabs, pos);
+	}
+	gui->tabs_updated++;
 
-	if (active) {
-		edje_object_signal_emit(edje, "eovim,tab,activate", "eovim");
-		gui->active_tab = id;
+	/* Stringshares can be compared by pointer */
+	if (tab->name != name) {
+		eina_stringshare_replace(&tab->name, name);
+		edje_object_part_text_set(tab->edje, "eovim.tab.title", name);
+	}
+	if (tab->active != active) {
+		edje_object_signal_emit(tab->edje,
+					(active) ? "eovim,tab,activate" : "eovim,tab,deactivate",
+					"eovim");
+		tab->active = active;
 	}
-	edje_object_part_box_append(gui->edje, "eovim.tabline", edje);
+	if (active)
+		gui->active_tab = id;
 }
 
 void gui_caps_lock_alert(struct gui *gui)
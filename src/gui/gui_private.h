@@ -14,6 +14,8 @@ struct completion;
 struct popupmenu_interface {
 	void (*const hide)(struct popupmenu *);
 	void (*const resize)(struct popupmenu *);
+	/* Called before the item at the given index is selected. Optional */
+	void (*const reveal)(struct popupmenu *, ssize_t);
 };
 
 struct popupmenu {
@@ -77,6 +79,12 @@ void cursor_blink_disable(struct cursor *cur);
 void cursor_color_set(struct cursor *cur, union color color);
 void cursor_mode_set(struct cursor *cur, const struct mode *mode);
 void cursor_focus_set(struct cursor *cur, Eina_Bool focused);
+
+/**
+ * Stop (or resume) the blinking and the animations of the cursor, while the
+ * window is in idle power mode
+ */
+void cursor_idle_set(struct cursor *cur, Eina_Bool idle);
 void gui_cursor_calc(struct gui *gui, int x, int y, int w, int h);
 void gui_cursor_key_pressed(struct gui *gui);
 
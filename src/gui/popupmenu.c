@@ -144,6 +144,10 @@ void popupmenu_select_nth(struct popupmenu *const pop, const ssize_t index)
 	}
 	assert(index >= 0); /* <-- At this point, index is non-negative */
 
+	/* The item may not be in the genlist yet */
+	if (pop->iface->reveal)
+		pop->iface->reveal(pop, index);
+
 	/* The selection has been initiated by neovim */
 	pop->nvim_sel_event = EINA_TRUE;
 
@@ -8,6 +8,9 @@
 #include "eovim/nvim_helper.h"
 #include "eovim/nvim_api.h"
 #include "eovim/nvim.h"
+#include "eovim/profile.h"
+#include "eovim/unicode.h"
+#include "eovim/font_cache.h"
 
 #include "gui_private.h"
 
@@ -38,11 +41,129 @@ static const char INVISIBLE_SEP[] = "\xe2\x81\xa5";
 struct termview;
 
 static void _relayout(struct termview *sd);
-
+static Eina_Bool _grid_place_cb(const Eina_Hash *hash, const void *key, void *data, void *fdata);
+static void _mouse_queue_flush(struct termview *sd);
+static void _resize_request(struct termview *sd, unsigned int cols, unsigned int rows);
+static void _frame_schedule(Evas_Object *obj);
+
+/* Cells are stored by runs of identical cells. The first cell of a run holds
+ * its contents and the length of the run in 'repeat'. The other cells of the
+ * run have a 'repeat' of zero, and their other fields are meaningless.
+ *
+ * A cell holds a single codepoint, as raw UTF-8 (no markup). Its length is
+ * given by its first byte, which is zero for the empty cell that follows a
+ * double-width character. Graphemes that don't fit (combining characters,
+ * emoji sequences, ...) are interned in the grapheme table of the termview:
+ * the first byte is then GRAPHEME_MARK, which is never valid UTF-8, and the
+ * three others hold the index of the grapheme. */
 struct cell {
-	char utf8[8]; /* NOT NUL-terminated */
-	uint32_t bytes;
-	uint32_t style_id;
+	char utf8[4]; /* NOT NUL-terminated */
+	uint16_t repeat;
+	uint16_t style_id;
+};
+
+#define GRAPHEME_MARK 0xffu
+#define GRAPHEMES_MAX (1u << 24)
+
+/* Pre-rendered markup tags that open and close a run of cells of a style */
+struct style_tags {
+	uint8_t open_len; /**< Size of 'open'. Zero when the tags are not built */
+	uint8_t close_len; /**< Size of 'close' */
+	char open[16]; /* NOT NUL-terminated */
+	char close[16]; /* NOT NUL-terminated */
+};
+
+/* A style, as the termview knows it. Its definition in the textblock style
+ * is rendered once, and kept around until the style changes. */
+struct style_entry {
+	struct termview_style style;
+	struct style_tags tags;
+	char *markup; /**< Definition of the style, within the textblock style */
+	unsigned int markup_len; /**< Size of 'markup' */
+	Eina_Bool defined; /**< The style has been defined by neovim */
+	Eina_Bool dirty; /**< The definition must be rendered */
+	Eina_Bool in_text; /**< The definition is in the textblock style string */
+
+	/* Colors of the style, as indexes in the palette of the textgrids */
+	uint8_t palette_fg;
+	uint8_t palette_bg;
+	Eina_Bool palette_ok; /**< The indexes above are up-to-date */
+};
+
+/* A span of columns [start;end) */
+struct span {
+	unsigned int start;
+	unsigned int end;
+};
+
+/* A grid of cells, as neovim defines them. The main grid (identifier 1) spans
+ * the whole termview. With ext_multigrid, each window is drawn in a grid of
+ * its own, which is laid over the main grid. Every grid has its own textblock
+ * (or textgrid), so rendering one of them does not involve the others. */
+struct grid {
+	int64_t id;
+	Evas_Object *textblock; /**< NULL with the textgrid renderer */
+	Evas_Object *textgrid; /**< NULL with the textblock renderer */
+	Evas_Object *background; /**< Hides the grids below. NULL for the main grid */
+	struct cell **cells;
+	struct cell *cells_mem; /**< Storage of all the cells, rows are in any order */
+	Evas_Textblock_Cursor **cursors; /**< One per row, NULL past the last row */
+	Evas_Textblock_Cursor *tmp;
+	Evas_Textblock_Cursor *cur; /**< Writes the invisible separators of the cursor */
+
+	/* This per-row set of spans is used to control which columns of which
+	 * lines have been modified and need to be re-rendered in the textblock.
+	 * An empty span (start >= end) means the line is untouched. */
+	struct span *dirty;
+
+	/* Rows that may hold glyphs that don't fill their cells. Edits flag the
+	 * rows they make irregular, and the flush finds out whether the dirty
+	 * rows that are flagged still are. Rows that are not flagged are known
+	 * to be regular, without walking through their cells. */
+	Eina_Bool *irregular;
+
+	unsigned int rows;
+	unsigned int cols;
+	unsigned int stride; /**< Cells allocated for each row, at least cols */
+	unsigned int capacity; /**< Rows allocated, at least rows */
+	int row; /**< Position of the grid, in cells of the main grid */
+	int col; /**< Position of the grid, in cells of the main grid */
+	unsigned int zindex; /**< Stacking order of the grid (0 for the main grid) */
+	Eina_Bool changed; /**< At least one row is dirty */
+	Eina_Bool visible;
+};
+
+/* The textgrid renderer writes the cells in Evas_Textgrid objects. It skips
+ * the markup and the layout of the textblock entirely, but cannot display
+ * ligatures. Colors of the cells are entries of the (extended) palette of the
+ * textgrids, which holds at most 256 colors. */
+#define PALETTE_SIZE 256u
+
+/* Longest compose sequence, in keys, and longest name of a key in it */
+#define COMPOSE_KEYS_MAX 8u
+#define COMPOSE_KEY_SIZE 64u
+
+/* Keys are timed until the canvas is rendered with neovim's answer. The
+ * oldest key that is not displayed yet is matched to the next flush, then to
+ * the next render that follows it. Keys typed in the meantime do not start a
+ * sample of their own. The latencies of the last samples are kept. */
+#define LATENCY_SAMPLES 128u
+
+struct latency {
+	uint64_t key; /**< When the oldest key not flushed yet was sent, or 0 */
+	uint64_t flushed; /**< When the key awaiting the render was sent, or 0 */
+	uint64_t samples[LATENCY_SAMPLES]; /**< Key-to-render, in nanoseconds */
+	unsigned int count; /**< Samples recorded, up to LATENCY_SAMPLES */
+	unsigned int next; /**< Where the next sample is stored */
+};
+
+struct palette {
+	union color colors[PALETTE_SIZE];
+	unsigned int count;
+	uint8_t default_fg; /**< Index of the default foreground color */
+	uint8_t default_bg; /**< Index of the default background color */
+	Eina_Bool defaults_ok; /**< The default indexes are up-to-date */
+	Eina_Bool redraw; /**< Styles in use changed: all cells must be rewritten */
 };
 
 struct termview {
@@ -51,44 +172,50 @@ struct termview {
 	Evas_Object *object;
 
 	struct nvim *nvim;
-	Evas_Object *textblock;
 	Ecore_Event_Handler *key_down_handler;
 	Eina_Strbuf *line;
-	struct cell **cells;
-	Evas_Textblock_Cursor **cursors;
-	Evas_Textblock_Cursor *tmp;
 
-	/* This per-row set of booleans is used to control which line has been
-	 * modified and needs to be re-rendered in the textblock.
-	 *
-	 * XXX It could/should be a bitmap to reduce space usage? XXX
-	 * XXX It could also contain information about columns??
-	 */
-	Eina_Bool *line_has_changed;
+	struct grid grid; /**< The main grid */
+	Eina_Hash *grids; /**< Map of identifiers to the other grids */
+	struct grid *last_grid; /**< The grid that was looked up last */
+	unsigned int zindex_next; /**< Stacking order of the next floating grid */
+	Eina_Bool textgrid; /**< Cells are rendered with the textgrid renderer */
+	struct palette palette; /**< Colors of the textgrid renderer */
 
 	/* This textgrid exists to determine very easily the size of the a cell
 	 * after a font change. Otherwise, we have to go through a callback hell
 	 * to TRY to determine the line geometry of a textblock. I didn't manage
 	 * to get a nice result... */
 	Evas_Object *sizing_textgrid;
+	struct font_metrics metrics; /**< Of the current font, see font_cache.h */
+
+	/* Advances of the glyphs that are not ASCII, in pixels, as the font of
+	 * the grids draws them. Fallback fonts may not agree with the grid, so
+	 * each codepoint is measured once per font, when it is first met. */
+	struct {
+		Evas_Object *text; /**< Invisible, to measure the glyphs */
+		Eina_Hash *advances; /**< Codepoints to their advance, plus one */
+		Eina_Bool font_ok; /**< The font of 'text' is the current one */
+	} glyphs;
 
 	struct {
-		Evas_Textblock_Cursor *cur;
+		struct grid *grid;
 		unsigned int x;
 		unsigned int y;
 
+		struct grid *next_grid;
 		unsigned int next_x;
 		unsigned int next_y;
 
 		/* This is set to true when the cursor has written a invisible
-		 * space. It should be at (x,y) */
+		 * space. It should be at (x,y) of its grid */
 		Eina_Bool sep_written;
+		/* The grid of the cursor has moved: it must be placed again */
+		Eina_Bool moved;
 	} cursor;
 
 	unsigned int cell_w;
 	unsigned int cell_h;
-	unsigned int rows;
-	unsigned int cols;
 
 	struct {
 		/* When mouse drag starts, we store in here the button that was pressed
@@ -97,11 +224,44 @@ struct termview {
 		int btn;
 		unsigned int prev_cx; /**< Previous X position */
 		unsigned int prev_cy; /**< Previous Y position */
+		int64_t grid; /**< Identifier of the grid the drag started in */
 	} mouse_drag;
 
-	Eina_List *seq_compose;
+	/* Drags and wheel scrolls are sent at most once per frame. Until then,
+	 * only the latest cell of a drag is kept, and the steps of the wheel are
+	 * added up. Other inputs send what is queued first, so their order is
+	 * kept. */
+	struct {
+		Ecore_Animator *animator;
+		Eina_Bool drag; /**< mouse_drag holds a cell that was not sent */
+		struct mouse_wheel {
+			int steps; /**< Negative when scrolling up, positive otherwise */
+			unsigned int cx;
+			unsigned int cy;
+			int64_t grid;
+		} wheel;
+	} mouse_queue;
+
+	/* Keys of the compose sequence being typed. ecore_compose_get() wants
+	 * them in a list: its nodes are created once, and point to the keys. */
+	struct {
+		Eina_List *nodes; /**< COMPOSE_KEYS_MAX nodes */
+		char keys[COMPOSE_KEYS_MAX][COMPOSE_KEY_SIZE];
+		unsigned int count;
+	} compose;
+
+	/* Graphemes that don't fit in a cell, by index. They are never released:
+	 * there are few of them, and neovim keeps sending the same ones. */
+	struct {
+		Eina_Hash *indexes; /**< Map of the (shared) graphemes to their index, plus one */
+		Eina_Inarray *texts; /**< Array of Eina_Stringshare */
+	} graphemes;
+
+	/* Styles, indexed by their identifier. Neovim's identifiers are small
+	 * and dense integers, so there are very few holes in there. */
+	struct style_entry *styles;
+	uint32_t styles_count;
 
-	Eina_Hash *styles;
 	struct {
 		Eina_Strbuf *text;
 
@@ -113,8 +273,42 @@ struct termview {
 		Eina_Stringshare *font_name;
 		unsigned int font_size;
 		unsigned int line_gap;
+
+		/* Identifiers of the styles whose definitions have changed since
+		 * the last update */
+		Eina_Inarray *changes;
+		/* The font, linegap, default colors or kind styles have changed */
+		Eina_Bool main_changed;
+		/* The default colors have changed. All styles shall be rendered */
+		Eina_Bool defaults_changed;
 	} style;
 
+	/* Rendering of the grid in the textblock is deferred to the next frame,
+	 * so the changes of all the redraw batches received in the meantime are
+	 * applied at once. */
+	struct {
+		Ecore_Animator *animator;
+		Eina_Bool flush; /**< A flush is pending */
+		Eina_Bool redraw_end; /**< The cursor must be placed after the flush */
+	} frame;
+
+	/* Dragging the edge of the window resizes the termview many times per
+	 * frame, and neovim redraws everything for each size it is asked for.
+	 * The latest size is requested at most once per frame, and only once
+	 * neovim answered the previous request. Meanwhile, the grid is clipped
+	 * to the termview (or padded), and its redraws are not rendered: they
+	 * are for a size that is about to be replaced. */
+	struct {
+		Ecore_Animator *animator; /**< Alive while a request is pending */
+		double sent_at; /**< When the last request was sent */
+		unsigned int cols; /**< Size of the termview, in cells */
+		unsigned int rows;
+		unsigned int sent_cols; /**< Size of the last request */
+		unsigned int sent_rows;
+		Eina_Bool waiting; /**< Neovim did not answer the last request yet */
+	} resize;
+	struct latency latency;
+
 	Eina_Rectangle geometry;
 	Eina_Bool pending_style_update;
 	Eina_Bool need_nvim_resize;
@@ -149,14 +343,31 @@ struct termview {
 	Eina_Bool may_send_relayout;
 };
 
-static struct termview_style *_termview_style_new(void)
+static struct style_entry *_style_entry_get(struct termview *const sd, const uint32_t style_id)
 {
-	return calloc(1, sizeof(struct termview_style));
+	/* Grow the array of styles so it can hold style_id. New entries are all
+	 * zeroed, they are not defined. */
+	if (style_id >= sd->styles_count) {
+		const uint32_t count = MAX(MAX(style_id + 1u, sd->styles_count * 2u), 64u);
+		struct style_entry *const styles = realloc(sd->styles, count * sizeof(*styles));
+		if (EINA_UNLIKELY(!styles)) {
+			CRI("Failed to allocate memory");
+			return NULL;
+		}
+		memset(&styles[sd->styles_count], 0, (count - sd->styles_count) * sizeof(*styles));
+		sd->styles = styles;
+		sd->styles_count = count;
+	}
+	return &(sd->styles[style_id]);
 }
 
-static void _termview_style_free(struct termview_style *const style)
+static inline struct style_entry *_style_entry_find(const struct termview *const sd,
+						     const t_int style_id)
 {
-	free(style);
+	if ((style_id < 0) || ((uint64_t)style_id >= sd->styles_count) ||
+	    (!sd->styles[style_id].defined))
+		return NULL;
+	return &(sd->styles[style_id]);
 }
 
 static Eina_Bool _kind_style_foreach(const Eina_Hash *const hash EINA_UNUSED, const void *const key,
@@ -169,15 +380,15 @@ static Eina_Bool _kind_style_foreach(const Eina_Hash *const hash EINA_UNUSED, co
 	return EINA_TRUE;
 }
 
-static Eina_Bool _style_foreach(const Eina_Hash *const hash EINA_UNUSED, const void *const key,
-				void *const data, void *const fdata)
+static void _style_markup_render(struct termview *const sd, const uint32_t style_id)
 {
-	const struct termview_style *const style = data;
-	const int64_t style_id = *((const int64_t *)key);
-	struct termview *const sd = fdata;
-	Eina_Strbuf *const buf = sd->style.text;
+	struct style_entry *const entry = &(sd->styles[style_id]);
+	const struct termview_style *const style = &(entry->style);
+	/* The line buffer is not in use while styles are updated */
+	Eina_Strbuf *const buf = sd->line;
 
-	eina_strbuf_append_printf(buf, " X%" PRIx64 "='+", style_id);
+	eina_strbuf_reset(buf);
+	eina_strbuf_append_printf(buf, " X%" PRIx32 "='+", style_id);
 
 	if (style->reverse) {
 		const uint32_t fg = (style->bg_color.value == COLOR_DEFAULT) ?
@@ -228,7 +439,40 @@ static Eina_Bool _style_foreach(const Eina_Hash *const hash EINA_UNUSED, const v
 					  sp & 0xFFFFFF);
 	eina_strbuf_append_char(buf, '\'');
 
-	return EINA_TRUE;
+	/* Keep the rendered definition in the style */
+	const size_t len = eina_strbuf_length_get(buf);
+	char *const markup = realloc(entry->markup, len);
+	if (EINA_UNLIKELY(!markup)) {
+		CRI("Failed to allocate memory");
+		entry->markup_len = 0u;
+	} else {
+		memcpy(markup, eina_strbuf_string_get(buf), len);
+		entry->markup = markup;
+		entry->markup_len = (unsigned int)len;
+	}
+	eina_strbuf_reset(buf);
+	entry->dirty = EINA_FALSE;
+}
+
+static void _style_change_add(struct termview *const sd, const uint32_t style_id)
+{
+	struct style_entry *const entry = &(sd->styles[style_id]);
+
+	/* Textgrids hold the colors of the cells, not their style: the cells
+	 * written with this style must be written again */
+	if (entry->palette_ok) {
+		entry->palette_ok = EINA_FALSE;
+		sd->palette.redraw = EINA_TRUE;
+	}
+	if (!entry->dirty) {
+		if (EINA_UNLIKELY(eina_inarray_push(sd->style.changes, &style_id) < 0)) {
+			/* We cannot track this change. Have everything re-rendered */
+			sd->style.main_changed = EINA_TRUE;
+			sd->style.defaults_changed = EINA_TRUE;
+		}
+		entry->dirty = EINA_TRUE;
+	}
+	sd->pending_style_update = EINA_TRUE;
 }
 
 void termview_style_update(Evas_Object *const obj)
@@ -236,70 +480,180 @@ void termview_style_update(Evas_Object *const obj)
 	struct termview *const sd = evas_object_smart_data_get(obj);
 	Eina_Strbuf *const buf = sd->style.text;
 	struct gui *const gui = &sd->nvim->gui;
+	uint32_t *it;
 
-	eina_strbuf_reset(buf);
-	eina_strbuf_append_printf(buf, "DEFAULT='font=\\'%s\\' font_size=%u color=#%06x wrap=none",
-				  sd->style.font_name, sd->style.font_size,
-				  sd->style.default_fg.value & 0xFFFFFF);
-	if (sd->style.line_gap != 0u) {
-		eina_strbuf_append_printf(buf, " linegap=%u", sd->style.line_gap);
+	/* Render the styles that changed. If they were already in the textblock
+	 * style, we must rebuild it. Otherwise, just appending them will do. */
+	Eina_Bool rebuild = sd->style.main_changed || sd->style.defaults_changed;
+	if (!rebuild) {
+		EINA_INARRAY_FOREACH(sd->style.changes, it)
+		{
+			rebuild |= sd->styles[*it].in_text;
+			if (sd->styles[*it].dirty)
+				_style_markup_render(sd, *it);
+		}
 	}
-	eina_strbuf_append_char(buf, '\'');
 
-	eina_hash_foreach(sd->styles, &_style_foreach, sd);
-	eina_hash_foreach(gui->nvim->kind_styles, &_kind_style_foreach, sd);
+	if (rebuild) {
+		/* The styles that have not changed are not rendered again. They
+		 * are just copied after the DEFAULT style */
+		eina_strbuf_reset(buf);
+		eina_strbuf_append_printf(buf,
+					  "DEFAULT='font=\\'%s\\' font_size=%u color=#%06x wrap=none",
+					  sd->style.font_name, sd->style.font_size,
+					  sd->style.default_fg.value & 0xFFFFFF);
+		if (sd->style.line_gap != 0u) {
+			eina_strbuf_append_printf(buf, " linegap=%u", sd->style.line_gap);
+		}
+		eina_strbuf_append_char(buf, '\'');
+
+		eina_hash_foreach(gui->nvim->kind_styles, &_kind_style_foreach, sd);
+		for (uint32_t i = 0u; i < sd->styles_count; i++) {
+			struct style_entry *const entry = &(sd->styles[i]);
+			if (!entry->defined)
+				continue;
+			if (entry->dirty || sd->style.defaults_changed)
+				_style_markup_render(sd, i);
+			eina_strbuf_append_length(buf, entry->markup, entry->markup_len);
+			entry->in_text = EINA_TRUE;
+		}
+	} else {
+		EINA_INARRAY_FOREACH(sd->style.changes, it)
+		{
+			struct style_entry *const entry = &(sd->styles[*it]);
+			eina_strbuf_append_length(buf, entry->markup, entry->markup_len);
+			entry->in_text = EINA_TRUE;
+		}
+	}
+	eina_inarray_flush(sd->style.changes);
 
 	//DBG("Style update: %s\n", eina_strbuf_string_get(buf));
 	evas_textblock_style_set(sd->style.object, eina_strbuf_string_get(buf));
 
-	/* The height of a "cell" may vary depending on the font, linegap, etc. */
-	evas_textblock_cursor_line_geometry_get(sd->cursors[0], NULL, NULL, NULL,
-						(int *)&sd->cell_h);
-
-	gui_wildmenu_style_set(gui->wildmenu, sd->style.object, sd->cell_w, sd->cell_h);
-	gui_completion_style_set(gui->completion, sd->style.object, sd->cell_w, sd->cell_h);
+	if (sd->style.main_changed) {
+		/* The height of a "cell" may vary depending on the font, linegap, etc.
+		 * Textgrids ignore the linegap: their cells are the ones of the
+		 * sizing textgrid. Lines are only laid out to be measured when
+		 * their height is not cached. */
+		if ((!sd->textgrid) && (sd->metrics.line_h == 0u) && sd->style.font_name) {
+			int h = 0;
+			evas_textblock_cursor_line_geometry_get(sd->grid.cursors[0], NULL, NULL,
+								NULL, &h);
+			sd->metrics.line_h = (unsigned int)MAX(h, 0);
+			font_cache_set(sd->object, sd->style.font_name, sd->style.font_size,
+				       sd->style.line_gap, &sd->metrics);
+		}
+		if ((!sd->textgrid) && (sd->metrics.line_h != 0u))
+			sd->cell_h = sd->metrics.line_h;
+		eina_hash_foreach(sd->grids, &_grid_place_cb, sd);
+
+		gui_wildmenu_style_set(gui->wildmenu, sd->style.object, sd->cell_w, sd->cell_h);
+		gui_completion_style_set(gui->completion, sd->style.object, sd->cell_w,
+					 sd->cell_h);
+
+		if (sd->need_nvim_resize) {
+			int w, h;
+			evas_object_geometry_get(sd->object, NULL, NULL, &w, &h);
+			const unsigned int cols = (unsigned)w / sd->cell_w;
+			const unsigned int rows = (unsigned)h / sd->cell_h;
+			if (cols && rows)
+				_resize_request(sd, cols, rows);
+		}
 
-	if (sd->need_nvim_resize) {
-		int w, h;
-		evas_object_geometry_get(sd->object, NULL, NULL, &w, &h);
-		const unsigned int cols = (unsigned)w / sd->cell_w;
-		const unsigned int rows = (unsigned)h / sd->cell_h;
-		if (cols && rows)
-			nvim_api_ui_try_resize(sd->nvim, cols, rows);
+		_relayout(sd);
 	}
 
-	_relayout(sd);
-
 	sd->pending_style_update = EINA_FALSE;
 	sd->need_nvim_resize = EINA_FALSE;
+	sd->style.main_changed = EINA_FALSE;
+	sd->style.defaults_changed = EINA_FALSE;
+}
+
+void termview_kind_styles_changed(Evas_Object *const obj)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+	sd->style.main_changed = EINA_TRUE;
+	sd->pending_style_update = EINA_TRUE;
 }
 
 static void _keys_send(struct termview *sd, const char *keys, unsigned int size)
 {
+	_mouse_queue_flush(sd);
+	if (sd->latency.key == 0u)
+		sd->latency.key = profile_time_get();
 	nvim_api_input(sd->nvim, keys, size);
 	gui_cursor_key_pressed(&sd->nvim->gui);
 }
 
+static void _latency_render_post_cb(void *const data, Evas *const evas EINA_UNUSED,
+				    void *const info EINA_UNUSED)
+{
+	struct latency *const lat = data;
+	if (lat->flushed == 0u)
+		return;
+
+	PROFILE_STOP("key to render", lat->flushed);
+	lat->samples[lat->next] = profile_time_get() - lat->flushed;
+	lat->next = (lat->next + 1u) % LATENCY_SAMPLES;
+	if (lat->count < LATENCY_SAMPLES)
+		lat->count++;
+	lat->flushed = 0u;
+}
+
+static void _startup_render_post_cb(void *const data, Evas *const evas,
+				    void *const info EINA_UNUSED)
+{
+	struct termview *const sd = data;
+	const struct nvim *const nvim = sd->nvim;
+
+	/* Wait for the first render that displays what neovim sent */
+	if (nvim->startup.flushed == 0u)
+		return;
+	evas_event_callback_del_full(evas, EVAS_CALLBACK_RENDER_POST, &_startup_render_post_cb, sd);
+
+	const uint64_t start = nvim->startup.start;
+	const double painted = (double)(profile_time_get() - start) / 1e6;
+	INF("Startup: neovim spawned after %.1f ms, answered after %.1f ms, "
+	    "first flush after %.1f ms, first paint after %.1f ms",
+	    (double)(nvim->startup.spawned - start) / 1e6,
+	    (double)(nvim->startup.answered - start) / 1e6,
+	    (double)(nvim->startup.flushed - start) / 1e6, painted);
+	PROFILE_STOP("startup to first paint", start);
+}
+
 static inline Eina_Bool _composing_is(const struct termview *sd)
 {
-	/* Composition is pending if the seq_compose list is not empty */
-	return (sd->seq_compose == NULL) ? EINA_FALSE : EINA_TRUE;
+	/* Composition is pending if keys were typed in the sequence */
+	return (sd->compose.count != 0u);
 }
 
 static inline void _composition_reset(struct termview *sd)
 {
-	/* Discard all elements within the list */
-	Eina_Stringshare *str;
-	EINA_LIST_FREE(sd->seq_compose, str)
-	eina_stringshare_del(str);
+	sd->compose.count = 0u;
+}
+
+/* Add the key to the sequence. Hence, starting the composition. Returns
+ * EINA_FALSE if the key cannot be part of a sequence. */
+static inline Eina_Bool _composition_add(struct termview *sd, const Ecore_Event_Key *const key)
+{
+	const size_t len = strlen(key->key);
+	if ((len >= COMPOSE_KEY_SIZE) || (sd->compose.count >= COMPOSE_KEYS_MAX) ||
+	    (!sd->compose.nodes))
+		return EINA_FALSE;
+	memcpy(sd->compose.keys[sd->compose.count++], key->key, len + 1u);
+	return EINA_TRUE;
 }
 
-static inline void _composition_add(struct termview *sd, const Ecore_Event_Key *const key)
+static Ecore_Compose_State _composition_get(struct termview *sd, char **res)
 {
-	/* Add the key as a stringshare in the seq list. Hence, starting the
-	 * composition */
-	Eina_Stringshare *const shr = eina_stringshare_add(key->key);
-	sd->seq_compose = eina_list_append(sd->seq_compose, shr);
+	/* The list is cut after the keys of the sequence for the time of the
+	 * lookup, so it is made of them only */
+	Eina_List *const last = eina_list_nth_list(sd->compose.nodes, sd->compose.count - 1u);
+	Eina_List *const next = last->next;
+	last->next = NULL;
+	const Ecore_Compose_State state = ecore_compose_get(sd->compose.nodes, res);
+	last->next = next;
+	return state;
 }
 
 /*
@@ -327,8 +681,11 @@ static Eina_Bool _compose(struct termview *const sd, const Ecore_Event_Key *cons
 			return EINA_TRUE;
 
 		/* Add the current key to the composition list, and compute */
-		_composition_add(sd, key);
-		const Ecore_Compose_State state = ecore_compose_get(sd->seq_compose, &res);
+		if (!_composition_add(sd, key)) {
+			_composition_reset(sd);
+			return EINA_FALSE;
+		}
+		const Ecore_Compose_State state = _composition_get(sd, &res);
 		if (state == ECORE_COMPOSE_DONE) {
 			/* We composed! Write the composed key! */
 			_composition_reset(sd);
@@ -344,8 +701,9 @@ static Eina_Bool _compose(struct termview *const sd, const Ecore_Event_Key *cons
 	} else /* Not composing yet */
 	{
 		/* Add the key to the composition engine */
-		_composition_add(sd, key);
-		const Ecore_Compose_State state = ecore_compose_get(sd->seq_compose, NULL);
+		if (!_composition_add(sd, key))
+			return EINA_FALSE;
+		const Ecore_Compose_State state = _composition_get(sd, NULL);
 		if (state != ECORE_COMPOSE_MIDDLE) {
 			/* Nope, this does not allow composition */
 			_composition_reset(sd);
@@ -358,19 +716,222 @@ static Eina_Bool _compose(struct termview *const sd, const Ecore_Event_Key *cons
 	return EINA_FALSE;
 }
 
-static void _coords_to_cell(const struct termview *sd, int px, int py, unsigned int *cell_x,
-			    unsigned int *cell_y)
+/* Create the textblock of the grid @p g, which is identified by @p id. Its
+ * cells are allocated when the grid gets its dimensions. */
+static Eina_Bool _grid_init(struct termview *const sd, struct grid *const g, const int64_t id)
+{
+	Evas *const evas = evas_object_evas_get(sd->object);
+	Evas_Object *o;
+
+	g->id = id;
+
+	/* Grids other than the main one are laid over it. They need an opaque
+	 * background, as cells of the default style have no backing. */
+	if (id != 1) {
+		g->background = o = evas_object_rectangle_add(evas);
+		if (EINA_UNLIKELY(!o)) {
+			CRI("Failed to create rectangle");
+			return EINA_FALSE;
+		}
+		const union color bg = sd->style.default_bg;
+		evas_object_color_set(o, bg.r, bg.g, bg.b, 255);
+		evas_object_smart_member_add(o, sd->object);
+	}
+
+	if (sd->textgrid) {
+		g->textgrid = o = evas_object_textgrid_add(evas);
+		if (EINA_UNLIKELY(!o)) {
+			CRI("Failed to create textgrid");
+			return EINA_FALSE;
+		}
+		if (sd->style.font_name)
+			evas_object_textgrid_font_set(o, sd->style.font_name,
+						      (int)sd->style.font_size);
+		for (unsigned int i = 0u; i < sd->palette.count; i++) {
+			const union color c = sd->palette.colors[i];
+			evas_object_textgrid_palette_set(o, EVAS_TEXTGRID_PALETTE_EXTENDED, (int)i,
+							 c.r, c.g, c.b, 255);
+		}
+	} else {
+		g->textblock = o = evas_object_textblock_add(evas);
+		if (EINA_UNLIKELY(!o)) {
+			CRI("Failed to create textblock");
+			return EINA_FALSE;
+		}
+		evas_object_textblock_style_set(o, sd->style.object);
+		g->tmp = evas_object_textblock_cursor_new(o);
+		g->cur = evas_object_textblock_cursor_new(o);
+	}
+	evas_object_size_hint_weight_set(o, EVAS_HINT_EXPAND, EVAS_HINT_EXPAND);
+	evas_object_size_hint_align_set(o, EVAS_HINT_FILL, EVAS_HINT_FILL);
+	evas_object_smart_member_add(o, sd->object);
+
+	/* The main grid is always visible. The others are shown when neovim
+	 * tells where they are. */
+	if (id == 1) {
+		evas_object_show(o);
+		g->visible = EINA_TRUE;
+	}
+	return EINA_TRUE;
+}
+
+static void _grid_fini(struct grid *const g)
+{
+	if (g->cursors) {
+		for (unsigned int i = 0u; i < g->rows; i++)
+			evas_textblock_cursor_free(g->cursors[i]);
+		free(g->cursors);
+	}
+	free(g->cells_mem);
+	free(g->cells);
+	free(g->dirty);
+	free(g->irregular);
+	if (g->textblock) {
+		evas_textblock_cursor_free(g->tmp);
+		evas_textblock_cursor_free(g->cur);
+		evas_object_del(g->textblock);
+	}
+	if (g->textgrid)
+		evas_object_del(g->textgrid);
+	if (g->background)
+		evas_object_del(g->background);
+}
+
+/* The object the grid is rendered in */
+static inline Evas_Object *_grid_object(const struct grid *const g)
+{
+	return (g->textgrid) ? g->textgrid : g->textblock;
+}
+
+static void _grid_free_cb(void *const data)
+{
+	struct grid *const g = data;
+	_grid_fini(g);
+	free(g);
+}
+
+static struct grid *_grid_find(struct termview *const sd, const int64_t id)
+{
+	/* Neovim sends the events of a grid one after the other, so the last
+	 * grid that was looked up is very likely to be the one */
+	if (EINA_LIKELY(id == 1))
+		return &sd->grid;
+	if (sd->last_grid && (sd->last_grid->id == id))
+		return sd->last_grid;
+
+	struct grid *const g = eina_hash_find(sd->grids, &id);
+	if (g)
+		sd->last_grid = g;
+	return g;
+}
+
+static struct grid *_grid_find_or_add(struct termview *const sd, const int64_t id)
+{
+	struct grid *g = _grid_find(sd, id);
+	if (g)
+		return g;
+
+	g = calloc(1, sizeof(*g));
+	if (EINA_UNLIKELY(!g)) {
+		CRI("Failed to allocate memory");
+		return NULL;
+	}
+	if (EINA_UNLIKELY(!_grid_init(sd, g, id)))
+		goto fail;
+	if (EINA_UNLIKELY(!eina_hash_direct_add(sd->grids, &g->id, g))) {
+		CRI("Failed to add grid %" PRIi64 " in hash", id);
+		goto fail;
+	}
+	sd->last_grid = g;
+	return g;
+
+fail:
+	_grid_free_cb(g);
+	return NULL;
+}
+
+/* Move and resize the objects of the grid @p g where it belongs, over the
+ * main grid */
+static void _grid_place(struct termview *const sd, struct grid *const g)
+{
+	if (g == &sd->grid)
+		return;
+
+	int ox, oy;
+	evas_object_geometry_get(_grid_object(&sd->grid), &ox, &oy, NULL, NULL);
+	const int x = ox + g->col * (int)sd->cell_w;
+	const int y = oy + g->row * (int)sd->cell_h;
+	const int w = (int)(g->cols * sd->cell_w);
+	const int h = (int)(g->rows * sd->cell_h);
+
+	evas_object_move(g->background, x, y);
+	evas_object_resize(g->background, w, h);
+	evas_object_move(_grid_object(g), x, y);
+	evas_object_resize(_grid_object(g), w, h);
+
+	/* The cursor is placed in pixels, so it must follow its grid */
+	if (sd->cursor.grid == g)
+		sd->cursor.moved = EINA_TRUE;
+}
+
+static Eina_Bool _grid_place_cb(const Eina_Hash *const hash EINA_UNUSED,
+				const void *const key EINA_UNUSED, void *const data,
+				void *const fdata)
+{
+	_grid_place(fdata, data);
+	return EINA_TRUE;
+}
+
+static void _grid_show(struct grid *const g)
+{
+	evas_object_show(g->background);
+	evas_object_show(_grid_object(g));
+	g->visible = EINA_TRUE;
+}
+
+struct grid_pick {
+	struct grid *grid;
+	int x;
+	int y;
+};
+
+static Eina_Bool _grid_pick_cb(const Eina_Hash *const hash EINA_UNUSED,
+			       const void *const key EINA_UNUSED, void *const data,
+			       void *const fdata)
+{
+	struct grid *const g = data;
+	struct grid_pick *const pick = fdata;
+	if (!g->visible || (g->zindex < pick->grid->zindex))
+		return EINA_TRUE;
+
+	Eina_Rectangle geo;
+	evas_object_geometry_get(_grid_object(g), &geo.x, &geo.y, &geo.w, &geo.h);
+	if (eina_rectangle_coords_inside(&geo, pick->x, pick->y))
+		pick->grid = g;
+	return EINA_TRUE;
+}
+
+/* Find the topmost grid at the canvas coordinates (px, py) */
+static struct grid *_grid_at(struct termview *const sd, const int px, const int py)
+{
+	struct grid_pick pick = { .grid = &sd->grid, .x = px, .y = py };
+	eina_hash_foreach(sd->grids, &_grid_pick_cb, &pick);
+	return pick.grid;
+}
+
+static void _coords_to_cell(const struct grid *const g, const struct termview *const sd, int px,
+			    int py, unsigned int *cell_x, unsigned int *cell_y)
 {
 	int ox, oy; /* Textblock origin */
 	int ow, oh; /* Textblock size */
 
-	evas_object_geometry_get(sd->textblock, &ox, &oy, &ow, &oh);
+	evas_object_geometry_get(_grid_object(g), &ox, &oy, &ow, &oh);
 
 	/* Clamp cell_x in [0 ; cols[ */
 	if (px < ox) {
 		*cell_x = 0;
 	} else if (px - ox >= ow) {
-		*cell_x = sd->cols - 1;
+		*cell_x = g->cols - 1;
 	} else {
 		*cell_x = (unsigned int)((px - ox) / (int)sd->cell_w);
 	}
@@ -379,7 +940,7 @@ static void _coords_to_cell(const struct termview *sd, int px, int py, unsigned
 	if (py < oy) {
 		*cell_y = 0;
 	} else if (py - oy >= oh) {
-		*cell_y = sd->rows - 1;
+		*cell_y = g->rows - 1;
 	} else {
 		*cell_y = (unsigned int)((py - oy) / (int)sd->cell_h);
 	}
@@ -398,8 +959,23 @@ static const char *_mouse_button_to_string(int button)
 	}
 }
 
-static void _mouse_event(struct termview *sd, const char *event, unsigned int cx, unsigned int cy,
-			 int btn)
+/* Name of a mouse button, as nvim_input_mouse() knows it */
+static const char *_mouse_button_to_name(int button)
+{
+	switch (button) {
+	case 3:
+		return "right";
+	case 2:
+		return "middle";
+	case 1: /* Fall through */
+	default:
+		return "left";
+	}
+}
+
+static void _mouse_event(struct termview *sd, const struct grid *g, const char *event,
+			 const char *action, unsigned int cx, unsigned int cy, int btn,
+			 Eina_Bool motion)
 {
 	char input[64];
 
@@ -408,13 +984,91 @@ static void _mouse_event(struct termview *sd, const char *event, unsigned int cx
 		return;
 	}
 
+	/* Positions in mouse keycodes are relative to the screen, which is the
+	 * main grid. Within other grids, the grid must be named. */
+	if (g != &sd->grid) {
+		nvim_api_input_mouse(sd->nvim, _mouse_button_to_name(btn), action, g->id, cy, cx);
+		return;
+	}
+
 	/* Determine which button we pressed */
 	const char *const button = _mouse_button_to_string(btn);
 
 	/* Convert the mouse input as an input format. */
 	const int bytes = snprintf(input, sizeof(input), "<%s%s><%u,%u>", button, event, cx, cy);
 
-	nvim_api_input(sd->nvim, input, (unsigned int)bytes);
+	/* Only the last position of a drag matters */
+	if (motion)
+		nvim_api_input_motion(sd->nvim, input, (unsigned int)bytes);
+	else
+		nvim_api_input(sd->nvim, input, (unsigned int)bytes);
+}
+
+static void _mouse_wheel_send(struct termview *const sd)
+{
+	struct mouse_wheel *const wheel = &sd->mouse_queue.wheel;
+	const Eina_Bool up = (wheel->steps < 0);
+	const unsigned int steps = (unsigned int)abs(wheel->steps);
+	wheel->steps = 0;
+
+	/* The grid may have been closed in the meantime */
+	const struct grid *const g = _grid_find(sd, wheel->grid);
+	if (EINA_UNLIKELY(!g))
+		return;
+
+	/* Within other grids, each step is a call to nvim_input_mouse(). Within
+	 * the main one, the steps are sent as one input, as keycodes have no
+	 * count. */
+	if (g != &sd->grid) {
+		for (unsigned int i = 0u; i < steps; i++)
+			nvim_api_input_mouse(sd->nvim, "wheel", (up) ? "up" : "down", g->id, wheel->cy,
+					     wheel->cx);
+		return;
+	}
+
+	char input[64];
+	const int bytes = snprintf(input, sizeof(input), "<ScrollWheel%s><%u,%u>",
+				   (up) ? "Up" : "Down", wheel->cx, wheel->cy);
+	for (unsigned int i = 0u; i < steps; i++)
+		nvim_api_input(sd->nvim, input, (unsigned int)bytes);
+}
+
+static void _mouse_queue_flush(struct termview *const sd)
+{
+	if (sd->mouse_queue.animator) {
+		ecore_animator_del(sd->mouse_queue.animator);
+		sd->mouse_queue.animator = NULL;
+	}
+
+	if (sd->mouse_queue.drag) {
+		sd->mouse_queue.drag = EINA_FALSE;
+		const struct grid *g = _grid_find(sd, sd->mouse_drag.grid);
+		if (EINA_UNLIKELY(!g))
+			g = &sd->grid;
+		_mouse_event(sd, g, "Drag", "drag", sd->mouse_drag.prev_cx, sd->mouse_drag.prev_cy,
+			     sd->mouse_drag.btn, EINA_TRUE);
+	}
+	if (sd->mouse_queue.wheel.steps != 0)
+		_mouse_wheel_send(sd);
+}
+
+static Eina_Bool _mouse_queue_cb(void *const data)
+{
+	struct termview *const sd = data;
+	sd->mouse_queue.animator = NULL;
+	_mouse_queue_flush(sd);
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static void _mouse_queue_schedule(struct termview *const sd)
+{
+	if (sd->mouse_queue.animator)
+		return;
+	sd->mouse_queue.animator = ecore_animator_add(&_mouse_queue_cb, sd);
+	if (EINA_UNLIKELY(!sd->mouse_queue.animator)) {
+		ERR("Failed to create animator. Sending mouse inputs now.");
+		_mouse_queue_flush(sd);
+	}
 }
 
 static void _termview_mouse_move_cb(void *data, Evas *e EINA_UNUSED, Evas_Object *obj EINA_UNUSED,
@@ -427,22 +1081,27 @@ static void _termview_mouse_move_cb(void *data, Evas *e EINA_UNUSED, Evas_Object
 		return;
 	}
 
+	/* The drag goes on in the grid it started in */
+	const struct grid *g = _grid_find(sd, sd->mouse_drag.grid);
+	if (EINA_UNLIKELY(!g))
+		g = &sd->grid;
+
 	const Evas_Event_Mouse_Move *const ev = event;
 	unsigned int cx, cy;
 
-	_coords_to_cell(sd, ev->cur.canvas.x, ev->cur.canvas.y, &cx, &cy);
+	_coords_to_cell(g, sd, ev->cur.canvas.x, ev->cur.canvas.y, &cx, &cy);
 
 	/* Did we move? If not, stop right here */
 	if ((cx == sd->mouse_drag.prev_cx) && (cy == sd->mouse_drag.prev_cy))
 		return;
 
 	/* At this point, we have actually moved the mouse while holding a mouse
-	 * button, hence dragging. Send the event then update the current mouse
-	 * position. */
-	_mouse_event(sd, "Drag", cx, cy, sd->mouse_drag.btn);
-
+	 * button, hence dragging. The drag is sent on the next frame, to the
+	 * cell the mouse will be in by then. */
 	sd->mouse_drag.prev_cx = cx;
 	sd->mouse_drag.prev_cy = cy;
+	sd->mouse_queue.drag = EINA_TRUE;
+	_mouse_queue_schedule(sd);
 }
 
 static void _termview_mouse_up_cb(void *data, Evas *e EINA_UNUSED, Evas_Object *obj EINA_UNUSED,
@@ -452,8 +1111,13 @@ static void _termview_mouse_up_cb(void *data, Evas *e EINA_UNUSED, Evas_Object *
 	const Evas_Event_Mouse_Up *const ev = event;
 	unsigned int cx, cy;
 
-	_coords_to_cell(sd, ev->canvas.x, ev->canvas.y, &cx, &cy);
-	_mouse_event(sd, "Release", cx, cy, ev->button);
+	const struct grid *g = _grid_find(sd, sd->mouse_drag.grid);
+	if (EINA_UNLIKELY(!g))
+		g = &sd->grid;
+
+	_coords_to_cell(g, sd, ev->canvas.x, ev->canvas.y, &cx, &cy);
+	_mouse_queue_flush(sd);
+	_mouse_event(sd, g, "Release", "release", cx, cy, ev->button, EINA_FALSE);
 	sd->mouse_drag.btn = 0; /* Disable mouse dragging */
 }
 
@@ -464,14 +1128,17 @@ static void _termview_mouse_down_cb(void *data, Evas *e EINA_UNUSED, Evas_Object
 	const Evas_Event_Mouse_Down *const ev = event;
 	unsigned int cx, cy;
 
-	_coords_to_cell(sd, ev->canvas.x, ev->canvas.y, &cx, &cy);
+	const struct grid *const g = _grid_at(sd, ev->canvas.x, ev->canvas.y);
+	_coords_to_cell(g, sd, ev->canvas.x, ev->canvas.y, &cx, &cy);
 
 	/* When pressing down the mouse, we just registered the first values thay
 	 * may be used for dragging with the mouse. */
 	sd->mouse_drag.prev_cx = cx;
 	sd->mouse_drag.prev_cy = cy;
+	sd->mouse_drag.grid = g->id;
 
-	_mouse_event(sd, "Mouse", cx, cy, ev->button);
+	_mouse_queue_flush(sd);
+	_mouse_event(sd, g, "Mouse", "press", cx, cy, ev->button, EINA_FALSE);
 	sd->mouse_drag.btn = ev->button; /* Enable mouse dragging */
 }
 
@@ -486,13 +1153,27 @@ static void _termview_mouse_wheel_cb(void *data, Evas *e EINA_UNUSED, Evas_Objec
 		return;
 	}
 
-	const char *const dir = (ev->z < 0) ? "Up" : "Down";
+	if (ev->z == 0)
+		return;
 
-	char input[64];
 	unsigned int cx, cy;
-	_coords_to_cell(sd, ev->canvas.x, ev->canvas.y, &cx, &cy);
-	const int bytes = snprintf(input, sizeof(input), "<ScrollWheel%s><%u,%u>", dir, cx, cy);
-	nvim_api_input(sd->nvim, input, (unsigned int)bytes);
+	const struct grid *const g = _grid_at(sd, ev->canvas.x, ev->canvas.y);
+	_coords_to_cell(g, sd, ev->canvas.x, ev->canvas.y, &cx, &cy);
+
+	/* Steps are merged as long as they scroll the same way, at the same
+	 * place. Otherwise, the previous ones are sent first. */
+	struct mouse_wheel *const wheel = &sd->mouse_queue.wheel;
+	if ((wheel->steps != 0) &&
+	    (((wheel->steps < 0) != (ev->z < 0)) || (wheel->grid != g->id) || (wheel->cx != cx) ||
+	     (wheel->cy != cy)))
+		_mouse_queue_flush(sd);
+
+	/* A fast flick on a smooth wheel makes several steps at once */
+	wheel->steps += ev->z;
+	wheel->cx = cx;
+	wheel->cy = cy;
+	wheel->grid = g->id;
+	_mouse_queue_schedule(sd);
 }
 
 /**
@@ -607,21 +1288,21 @@ static Eina_Bool _termview_key_down_cb(void *const data, const int type EINA_UNU
 		}
 
 		/* Add the real key after the modifier, and close the bracket */
-		assert(send_size < (int)sizeof(buf));
-		const size_t len = sizeof(buf) - (size_t)send_size;
-		const int ret = snprintf(buf + send_size, len, "%s>", key);
-		if (EINA_UNLIKELY(ret < 2)) {
+		const size_t len = keymap ? keymap->size : strlen(key);
+		if (EINA_UNLIKELY((size_t)send_size + len + 1u > sizeof(buf))) {
 			ERR("Failed to compose key.");
 			return ECORE_CALLBACK_PASS_ON;
 		}
-		send_size += ret;
+		memcpy(buf + send_size, key, len);
+		send_size += (int)len;
+		buf[send_size++] = '>';
 		send = buf;
 	} else if (keymap) {
-		send_size = snprintf(buf, sizeof(buf), "<%s>", keymap->name);
-		if (EINA_UNLIKELY(send_size < 3)) {
-			ERR("Failed to write key to string");
-			return ECORE_CALLBACK_PASS_ON;
-		}
+		/* Names of the keymap are short enough to always fit */
+		buf[0] = '<';
+		memcpy(buf + 1, keymap->name, keymap->size);
+		buf[keymap->size + 1u] = '>';
+		send_size = (int)keymap->size + 2;
 		send = buf;
 	} else {
 		assert(ev->string != NULL);
@@ -668,7 +1349,8 @@ static void _relayout(struct termview *const sd)
 	 * case, we mark the relayout as "pending". When a new information is
 	 * available, this will be called again.
 	 */
-	if (EINA_LIKELY(sd->cols && sd->rows && sd->style.font_name)) {
+	const struct grid *const g = &sd->grid;
+	if (EINA_LIKELY(g->cols && g->rows && sd->style.font_name)) {
 		Eina_Rectangle *const geo = &sd->geometry;
 		evas_object_geometry_get(sd->object, &geo->x, &geo->y, NULL, NULL);
 
@@ -680,19 +1362,23 @@ static void _relayout(struct termview *const sd)
 		 * completely get the last line. We then calculate the exact height
 		 * from a union of geometries.
 		 *
-		 * This is costly, but rarely performed.
+		 * This is costly, but rarely performed. Textgrids don't have this
+		 * problem: their rows are exactly one cell high.
 		 */
-		evas_textblock_cursor_paragraph_char_last(sd->cursors[sd->rows - 1]);
-		Eina_Iterator *const it = evas_textblock_cursor_range_simple_geometry_get(
-			sd->cursors[0], sd->cursors[sd->rows - 1]);
-		Eina_Rectangle frame = EINA_RECTANGLE_INIT;
-		Eina_Rectangle *rect;
-		EINA_ITERATOR_FOREACH (it, rect)
-			eina_rectangle_union(&frame, rect);
-		eina_iterator_free(it);
-
-		geo->w = (int)(sd->cell_w * sd->cols);
-		geo->h = frame.h;
+		if (g->textgrid)
+			geo->h = (int)(sd->cell_h * g->rows);
+		else {
+			evas_textblock_cursor_paragraph_char_last(g->cursors[g->rows - 1]);
+			Eina_Iterator *const it = evas_textblock_cursor_range_simple_geometry_get(
+				g->cursors[0], g->cursors[g->rows - 1]);
+			Eina_Rectangle frame = EINA_RECTANGLE_INIT;
+			Eina_Rectangle *rect;
+			EINA_ITERATOR_FOREACH (it, rect)
+				eina_rectangle_union(&frame, rect);
+			eina_iterator_free(it);
+			geo->h = frame.h;
+		}
+		geo->w = (int)(sd->cell_w * g->cols);
 
 		if (sd->may_send_relayout)
 			evas_object_smart_callback_call(sd->object, "relayout", geo);
@@ -707,6 +1393,7 @@ static void _smart_add(Evas_Object *obj)
 		return;
 	}
 
+	sd->object = obj;
 	sd->line = eina_strbuf_new();
 
 	/* At startup, first thing we will do is resize. This is caused by the call to
@@ -731,7 +1418,10 @@ static void _smart_add(Evas_Object *obj)
 	sd->key_down_handler =
 		ecore_event_handler_add(ECORE_EVENT_KEY_DOWN, &_termview_key_down_cb, sd);
 
-	sd->styles = eina_hash_int64_new(EINA_FREE_CB(_termview_style_free));
+	sd->style.changes = eina_inarray_new(sizeof(uint32_t), 64);
+	sd->graphemes.indexes = eina_hash_stringshared_new(NULL);
+	sd->graphemes.texts = eina_inarray_new(sizeof(Eina_Stringshare *), 16);
+	sd->style.main_changed = EINA_TRUE;
 
 	Evas *const evas = evas_object_evas_get(obj);
 	Evas_Object *o;
@@ -745,79 +1435,582 @@ static void _smart_add(Evas_Object *obj)
 	evas_object_size_hint_align_set(o, EVAS_HINT_FILL, EVAS_HINT_FILL);
 	evas_object_textgrid_size_set(o, 1, 1);
 
-	sd->textblock = o = evas_object_textblock_add(evas);
-	evas_object_size_hint_weight_set(o, EVAS_HINT_EXPAND, EVAS_HINT_EXPAND);
-	evas_object_size_hint_align_set(o, EVAS_HINT_FILL, EVAS_HINT_FILL);
-	evas_object_smart_member_add(o, obj);
-	evas_object_textblock_style_set(o, sd->style.object);
-	evas_object_show(sd->textblock);
-	sd->tmp = evas_object_textblock_cursor_new(sd->textblock);
+	sd->glyphs.text = evas_object_text_add(evas);
+	sd->glyphs.advances = eina_hash_int32_new(NULL);
+
+	evas_event_callback_add(evas, EVAS_CALLBACK_RENDER_POST, &_latency_render_post_cb,
+				&sd->latency);
 
-	/* Cursor setup */
-	sd->cursor.cur = evas_object_textblock_cursor_new(sd->textblock);
+	sd->grids = eina_hash_int64_new(&_grid_free_cb);
+	sd->cursor.grid = sd->cursor.next_grid = &sd->grid;
+	sd->mouse_drag.grid = 1;
+	sd->zindex_next = 1u; /* Floating grids are above the windows */
+
+	/* Keys are not composed if the nodes cannot be created */
+	for (unsigned int i = 0u; i < COMPOSE_KEYS_MAX; i++)
+		sd->compose.nodes = eina_list_append(sd->compose.nodes, sd->compose.keys[i]);
+	if (EINA_UNLIKELY(eina_list_count(sd->compose.nodes) != COMPOSE_KEYS_MAX)) {
+		ERR("Failed to create the compose sequence. Keys will not be composed.");
+		sd->compose.nodes = eina_list_free(sd->compose.nodes);
+	}
 }
 
 static void _smart_del(Evas_Object *obj)
 {
 	struct termview *const sd = evas_object_smart_data_get(obj);
+	if (sd->frame.animator)
+		ecore_animator_del(sd->frame.animator);
+	if (sd->mouse_queue.animator)
+		ecore_animator_del(sd->mouse_queue.animator);
+	if (sd->resize.animator)
+		ecore_animator_del(sd->resize.animator);
+	evas_event_callback_del_full(evas_object_evas_get(obj), EVAS_CALLBACK_RENDER_POST,
+				     &_latency_render_post_cb, &sd->latency);
+	evas_event_callback_del_full(evas_object_evas_get(obj), EVAS_CALLBACK_RENDER_POST,
+				     &_startup_render_post_cb, sd);
+	eina_hash_free(sd->grids);
+	_grid_fini(&sd->grid);
+	eina_hash_free(sd->glyphs.advances);
+	eina_list_free(sd->compose.nodes);
 	evas_textblock_style_free(sd->style.object);
 	eina_strbuf_free(sd->style.text);
+	eina_inarray_free(sd->style.changes);
 	eina_strbuf_free(sd->line);
-	eina_hash_free(sd->styles);
-	if (sd->cells) {
-		free(sd->cells[0]);
-		free(sd->cells);
-	}
-	free(sd->line_has_changed);
-	for (unsigned int i = 0u; i < sd->rows; i++)
-		evas_textblock_cursor_free(sd->cursors[i]);
-	free(sd->cursors);
+	for (uint32_t i = 0u; i < sd->styles_count; i++)
+		free(sd->styles[i].markup);
+	free(sd->styles);
+
+	Eina_Stringshare **text;
+	EINA_INARRAY_FOREACH(sd->graphemes.texts, text)
+	{
+		eina_stringshare_del(*text);
+	}
+	eina_inarray_free(sd->graphemes.texts);
+	eina_hash_free(sd->graphemes.indexes);
 	ecore_event_handler_del(sd->key_down_handler);
 	_composition_reset(sd);
 }
 
-static void _smart_resize(Evas_Object *obj, Evas_Coord w, Evas_Coord h)
+/* Neovim does not answer when it cannot honor a request, e.g. when another UI
+ * of a --server constrains the size. Seconds to wait for it. */
+#define RESIZE_ANSWER_TIMEOUT 0.5
+
+static inline Eina_Bool _resize_waiting(const struct termview *const sd)
 {
-	struct termview *const sd = evas_object_smart_data_get(obj);
+	return sd->resize.waiting &&
+	       (ecore_loop_time_get() - sd->resize.sent_at < RESIZE_ANSWER_TIMEOUT);
+}
 
-	if (!sd->cell_w || !sd->cell_h)
-		return;
+/* The size of the termview is neither the one of the grid, nor the one that
+ * was requested last (neovim may have settled on another one) */
+static inline Eina_Bool _resize_wanted(const struct termview *const sd)
+{
+	const unsigned int cols = sd->resize.cols;
+	const unsigned int rows = sd->resize.rows;
+	return ((cols != sd->grid.cols) || (rows != sd->grid.rows)) &&
+	       ((cols != sd->resize.sent_cols) || (rows != sd->resize.sent_rows));
+}
 
-	const unsigned int cols = (unsigned int)w / sd->cell_w;
-	const unsigned int rows = (unsigned int)h / sd->cell_h;
+/* What the grid shows is superseded by a size neovim was, or is about to be,
+ * asked for */
+static inline Eina_Bool _resize_pending(const struct termview *const sd)
+{
+	return sd->resize.animator && (_resize_waiting(sd) || _resize_wanted(sd));
+}
 
-	evas_object_resize(sd->textblock, w, h);
-	if (cols && rows && ((cols != sd->cols) || (rows != sd->rows))) {
-		sd->in_resize++;
-		nvim_api_ui_try_resize(sd->nvim, cols, rows);
-	}
+/* A request was answered, whatever the size, or was given up on. Neovim may
+ * also resize the grid on its own, without any request to answer. */
+static void _resize_settle(struct termview *const sd)
+{
+	sd->resize.waiting = EINA_FALSE;
+	if (sd->in_resize > 0)
+		sd->in_resize--;
+	sd->may_send_relayout = sd->in_resize == 0;
 }
 
-Eina_Bool termview_init(void)
+static void _resize_send(struct termview *const sd)
 {
-	static Evas_Smart_Class sc;
+	sd->resize.sent_cols = sd->resize.cols;
+	sd->resize.sent_rows = sd->resize.rows;
+	sd->resize.sent_at = ecore_loop_time_get();
+	sd->resize.waiting = EINA_TRUE;
+	sd->in_resize++;
+	nvim_api_ui_try_resize(sd->nvim, sd->resize.cols, sd->resize.rows);
+}
 
-	static const Evas_Smart_Cb_Description smart_callbacks[] = { { "relayout", "" },
-								     { NULL, NULL } };
+static Eina_Bool _resize_cb(void *const data)
+{
+	struct termview *const sd = data;
 
-	evas_object_smart_clipped_smart_set(&_parent_sc);
-	sc = _parent_sc;
-	sc.name = "termview";
-	sc.version = EVAS_SMART_CLASS_VERSION;
-	sc.add = _smart_add;
-	sc.del = _smart_del;
-	sc.resize = _smart_resize;
-	sc.callbacks = smart_callbacks, _smart = evas_smart_class_new(&sc);
+	if (_resize_waiting(sd))
+		return ECORE_CALLBACK_RENEW;
+	if (sd->resize.waiting)
+		_resize_settle(sd); /* No answer came */
+	if (_resize_wanted(sd)) {
+		_resize_send(sd);
+		return ECORE_CALLBACK_RENEW;
+	}
 
-	return EINA_TRUE;
+	/* Neovim settled on the last size: render the frames that were held */
+	sd->resize.animator = NULL;
+	if (sd->frame.flush || sd->frame.redraw_end)
+		_frame_schedule(sd->object);
+	return ECORE_CALLBACK_CANCEL;
 }
 
-void termview_shutdown(void)
+static void _resize_request(struct termview *const sd, const unsigned int cols,
+			    const unsigned int rows)
 {
-	evas_smart_free(_smart);
+	sd->resize.cols = cols;
+	sd->resize.rows = rows;
+	if (sd->resize.animator || (!_resize_wanted(sd)))
+		return;
+
+	sd->resize.animator = ecore_animator_add(&_resize_cb, sd);
+	if (EINA_UNLIKELY(!sd->resize.animator)) {
+		ERR("Failed to create animator. Resizing now.");
+		_resize_send(sd);
+	}
 }
 
-Evas_Object *termview_add(Evas_Object *parent, struct nvim *nvim)
+static void _smart_resize(Evas_Object *obj, Evas_Coord w, Evas_Coord h)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+
+	if (!sd->cell_w || !sd->cell_h)
+		return;
+
+	const unsigned int cols = (unsigned int)w / sd->cell_w;
+	const unsigned int rows = (unsigned int)h / sd->cell_h;
+
+	evas_object_resize(_grid_object(&sd->grid), w, h);
+	if (cols && rows)
+		_resize_request(sd, cols, rows);
+}
+
+static const struct style_tags *_style_tags_build(struct termview *const sd,
+						  const uint32_t style_id)
+{
+	struct style_entry *const entry = _style_entry_get(sd, style_id);
+	if (EINA_UNLIKELY(!entry))
+		return NULL;
+
+	struct style_tags *const tags = &(entry->tags);
+	const int open_len = snprintf(tags->open, sizeof(tags->open), "<X%" PRIx32 ">", style_id);
+	const int close_len =
+		snprintf(tags->close, sizeof(tags->close), "</X%" PRIx32 ">", style_id);
+	tags->open_len = (uint8_t)open_len;
+	tags->close_len = (uint8_t)close_len;
+	return tags;
+}
+
+static inline const struct style_tags *_style_tags_get(struct termview *const sd,
+							const uint32_t style_id)
+{
+	if (EINA_LIKELY((style_id < sd->styles_count) &&
+			(sd->styles[style_id].tags.open_len != 0u)))
+		return &(sd->styles[style_id].tags);
+	return _style_tags_build(sd, style_id);
+}
+
+static inline void _style_tag_append(struct termview *const sd, Eina_Strbuf *const buf,
+				     const uint32_t style_id, const Eina_Bool closing)
+{
+	const struct style_tags *const tags = _style_tags_get(sd, style_id);
+	if (EINA_LIKELY(tags != NULL)) {
+		if (closing)
+			eina_strbuf_append_length(buf, tags->close, tags->close_len);
+		else
+			eina_strbuf_append_length(buf, tags->open, tags->open_len);
+	} else if (closing)
+		eina_strbuf_append_printf(buf, "</X%" PRIx32 ">", style_id);
+	else
+		eina_strbuf_append_printf(buf, "<X%" PRIx32 ">", style_id);
+}
+
+static inline void _dirty_add(struct grid *const g, const unsigned int row,
+			      const unsigned int start, const unsigned int end)
+{
+	struct span *const span = &(g->dirty[row]);
+	g->changed = EINA_TRUE;
+	if (span->start >= span->end) {
+		span->start = start;
+		span->end = end;
+	} else {
+		span->start = MIN(span->start, start);
+		span->end = MAX(span->end, end);
+	}
+}
+
+/* Size of the UTF-8 sequence that starts with the byte @p lead */
+static inline unsigned int _utf8_len(const unsigned char lead)
+{
+	if (lead < 0x80)
+		return 1u;
+	else if (lead < 0xe0)
+		return 2u;
+	else if (lead < 0xf0)
+		return 3u;
+	return 4u;
+}
+
+/* Get the UTF-8 text of the cell @p c, which is @p len bytes long */
+static inline const char *_cell_text_get(const struct termview *const sd,
+					 const struct cell *const c, unsigned int *const len)
+{
+	const unsigned char lead = (unsigned char)c->utf8[0];
+	if (lead == 0u) {
+		*len = 0u;
+		return c->utf8;
+	} else if (EINA_UNLIKELY(lead == GRAPHEME_MARK)) {
+		const unsigned int index = (unsigned int)(unsigned char)c->utf8[1] |
+					   ((unsigned int)(unsigned char)c->utf8[2] << 8) |
+					   ((unsigned int)(unsigned char)c->utf8[3] << 16);
+		Eina_Stringshare *const *const text = eina_inarray_nth(sd->graphemes.texts, index);
+		*len = (unsigned int)eina_stringshare_strlen(*text);
+		return *text;
+	}
+	*len = _utf8_len(lead);
+	return c->utf8;
+}
+
+/* Find the index of the grapheme @p text, which is added to the table if
+ * needed. On failure, GRAPHEMES_MAX is returned. */
+static unsigned int _grapheme_intern(struct termview *const sd, const char *const text,
+				     const size_t len)
+{
+	Eina_Stringshare *const shr = eina_stringshare_add_length(text, (unsigned int)len);
+	const uintptr_t found = (uintptr_t)eina_hash_find(sd->graphemes.indexes, shr);
+	if (found) {
+		eina_stringshare_del(shr);
+		return (unsigned int)(found - 1u);
+	}
+
+	const unsigned int index = eina_inarray_count(sd->graphemes.texts);
+	if (EINA_UNLIKELY(index >= GRAPHEMES_MAX)) {
+		ERR("Too many graphemes");
+		goto fail;
+	}
+	if (EINA_UNLIKELY(eina_inarray_push(sd->graphemes.texts, &shr) < 0)) {
+		CRI("Failed to register grapheme");
+		goto fail;
+	}
+	if (EINA_UNLIKELY(!eina_hash_add(sd->graphemes.indexes, shr,
+					 (void *)(uintptr_t)(index + 1u)))) {
+		CRI("Failed to add grapheme in hash");
+		eina_inarray_pop(sd->graphemes.texts);
+		goto fail;
+	}
+	return index;
+
+fail:
+	eina_stringshare_del(shr);
+	return GRAPHEMES_MAX;
+}
+
+/* Write the text @p text of @p len bytes in the cell @p c */
+static void _cell_text_set(struct termview *const sd, struct cell *const c,
+			   const char *const text, const size_t len)
+{
+	memset(c->utf8, 0, sizeof(c->utf8));
+	if (len == 0u)
+		return;
+
+	/* Most cells hold a single codepoint */
+	if (EINA_LIKELY(_utf8_len((unsigned char)text[0]) == len)) {
+		memcpy(c->utf8, text, len);
+		return;
+	}
+
+	const unsigned int index = _grapheme_intern(sd, text, len);
+	if (EINA_UNLIKELY(index == GRAPHEMES_MAX)) {
+		c->utf8[0] = '?';
+		return;
+	}
+	c->utf8[0] = (char)GRAPHEME_MARK;
+	c->utf8[1] = (char)(index & 0xff);
+	c->utf8[2] = (char)((index >> 8) & 0xff);
+	c->utf8[3] = (char)((index >> 16) & 0xff);
+}
+
+/* How many textblock characters does a cell hold? A cell may contain several
+ * codepoints. */
+static inline unsigned int _cell_chars_count(const struct termview *const sd,
+					     const struct cell *const c)
+{
+	if ((unsigned char)c->utf8[0] != GRAPHEME_MARK)
+		return (c->utf8[0] != '\0') ? 1u : 0u;
+
+	unsigned int len, count = 0u;
+	const char *const text = _cell_text_get(sd, c, &len);
+	for (unsigned int i = 0u; i < len; i++)
+		count += ((unsigned char)text[i] & 0xc0) != 0x80;
+	return count;
+}
+
+/* Find the first cell of the run containing the cell at @p col */
+static inline unsigned int _run_head(const struct cell *const row, unsigned int col)
+{
+	while (row[col].repeat == 0u)
+		col--;
+	return col;
+}
+
+/* Make sure a run starts at @p col, by cutting the run that contains it */
+static void _run_split(struct cell *const row, const unsigned int col, const unsigned int cols)
+{
+	if ((col >= cols) || (row[col].repeat != 0u))
+		return;
+
+	struct cell *const head = &row[_run_head(row, col)];
+	const uint16_t before = (uint16_t)(col - (unsigned int)(head - row));
+	row[col] = *head;
+	row[col].repeat = (uint16_t)(head->repeat - before);
+	head->repeat = before;
+}
+
+/* Write @p count times the contents of the cell @p c, as markup */
+static void _run_append(const struct termview *const sd, Eina_Strbuf *const buf,
+			const struct cell *const c, unsigned int count)
+{
+	unsigned int bytes;
+	const char *text = _cell_text_get(sd, c, &bytes);
+
+	if (bytes == 1u) {
+		/* Characters that have a meaning in markup must be escaped */
+		switch (text[0]) {
+		case '<':
+			text = "&lt;";
+			bytes = 4u;
+			break;
+		case '>':
+			text = "&gt;";
+			bytes = 4u;
+			break;
+		case '&':
+			text = "&amp;";
+			bytes = 5u;
+			break;
+		case '"':
+			text = "&quot;";
+			bytes = 6u;
+			break;
+		case '\'':
+			text = "&apos;";
+			bytes = 6u;
+			break;
+		}
+	}
+
+	if (bytes == 1u) {
+		/* Most runs are made of whitespaces. Write them in chunks */
+		char chunk[256];
+		memset(chunk, text[0], MIN(count, sizeof(chunk)));
+		while (count > 0u) {
+			const unsigned int len = MIN(count, (unsigned int)sizeof(chunk));
+			eina_strbuf_append_length(buf, chunk, len);
+			count -= len;
+		}
+	} else {
+		for (unsigned int i = 0u; i < count; i++)
+			eina_strbuf_append_length(buf, text, bytes);
+	}
+}
+
+/* Move a textblock cursor through the characters of cells [from;to) */
+static void _cursor_advance(const struct termview *const sd, Evas_Textblock_Cursor *const cur,
+			    const struct cell *const row, const unsigned int from,
+			    const unsigned int to)
+{
+	for (unsigned int col = from; col < to;) {
+		const unsigned int head = _run_head(row, col);
+		const unsigned int count = MIN(head + row[head].repeat, to) - col;
+		const unsigned int chars = _cell_chars_count(sd, &row[head]) * count;
+		for (unsigned int i = 0u; i < chars; i++)
+			evas_textblock_cursor_char_next(cur);
+		col += count;
+	}
+}
+
+/* Every cell of the row contains a single whitespace: the row is a single run */
+static void _row_blank(struct cell *const row, const unsigned int cols)
+{
+	memset(row[0].utf8, 0, sizeof(row[0].utf8));
+	row[0].utf8[0] = ' ';
+	row[0].repeat = (uint16_t)cols;
+	row[0].style_id = 0;
+	for (unsigned int j = 1; j < cols; j++)
+		row[j].repeat = 0;
+}
+
+/* Advance of the glyph of the codepoint @p cp, written as the @p len bytes of
+ * @p utf8, in pixels */
+static unsigned int _glyph_advance_get(struct termview *const sd, const Eina_Unicode cp,
+				       const char *const utf8, const unsigned int len)
+{
+	const int32_t key = (int32_t)cp;
+	const uintptr_t cached = (uintptr_t)eina_hash_find(sd->glyphs.advances, &key);
+	if (EINA_LIKELY(cached != 0u))
+		return (unsigned int)(cached - 1u);
+
+	/* The font is only loaded when a glyph is first measured */
+	if (!sd->glyphs.font_ok) {
+		evas_object_text_font_set(sd->glyphs.text, sd->style.font_name,
+					  (int)sd->style.font_size);
+		sd->glyphs.font_ok = EINA_TRUE;
+	}
+
+	char text[8];
+	memcpy(text, utf8, len);
+	text[len] = '\0';
+	evas_object_text_text_set(sd->glyphs.text, text);
+	const Evas_Coord measured = evas_object_text_horiz_advance_get(sd->glyphs.text);
+	const unsigned int advance = (measured > 0) ? (unsigned int)measured : 0u;
+	eina_hash_add(sd->glyphs.advances, &key, (void *)(uintptr_t)(advance + 1u));
+	return advance;
+}
+
+/* Cells taken by the cell at @p col: two for a double-width character, which
+ * is followed by an empty cell */
+static inline unsigned int _cell_width(const struct cell *const row, const unsigned int col,
+				       const unsigned int cols)
+{
+	const unsigned int next = col + 1u;
+	return ((next < cols) && (row[next].repeat != 0u) && (row[next].utf8[0] == '\0')) ? 2u
+											 : 1u;
+}
+
+/* Does the glyph of the run that starts at @p col fill exactly its cells? */
+static Eina_Bool _run_fits(struct termview *const sd, const struct cell *const row,
+			   const unsigned int col, const unsigned int cols)
+{
+	const struct cell *const c = &row[col];
+	const unsigned char lead = (unsigned char)c->utf8[0];
+
+	/* The font of the grid is monospace. Empty cells fill nothing, and
+	 * graphemes are trusted to fill one cell (or two) */
+	if ((lead < 0x80u) || (lead == GRAPHEME_MARK))
+		return EINA_TRUE;
+
+	const unsigned int len = _utf8_len(lead);
+	int index = 0;
+	const Eina_Unicode cp = eina_unicode_utf8_next_get(c->utf8, &index);
+	const unsigned int width = (c->repeat == 1u) ? _cell_width(row, col, cols) : 1u;
+	return _glyph_advance_get(sd, cp, c->utf8, len) == width * sd->cell_w;
+}
+
+/* A row is regular when, up to column @p to, the glyph of each cell fills
+ * exactly its cells (two for double-width characters). The cells of a
+ * regular row are exactly where the grid says they are. Glyphs of fallback
+ * fonts, which may be narrower or wider, break this. */
+static Eina_Bool _row_is_regular(struct termview *const sd, const struct cell *const row,
+				 const unsigned int to, const unsigned int cols)
+{
+	for (unsigned int col = 0u; col < to; col += row[col].repeat) {
+		if (!_run_fits(sd, row, col, cols))
+			return EINA_FALSE;
+	}
+	return EINA_TRUE;
+}
+
+/* The cells of @p row, from column @p from to column @p to, were changed.
+ * The widths of the runs around them may have changed too: the run just
+ * before may now be followed by the empty half of a double-width character,
+ * and the runs cut at @p from and @p to may now be single cells. Flag the row
+ * if one of them does not fit. Rows that are flagged stay so until the
+ * flush. */
+static void _row_fits_update(struct termview *const sd, struct grid *const g,
+			     const unsigned int row, const unsigned int from, const unsigned int to)
+{
+	/* Textgrids have no ligatures, and their rows are always regular */
+	if (g->textgrid || g->irregular[row])
+		return;
+
+	const struct cell *const cells = g->cells[row];
+	const unsigned int last = MIN(to + 1u, g->cols);
+	for (unsigned int col = (from > 0u) ? _run_head(cells, from - 1u) : 0u; col < last;
+	     col += cells[col].repeat) {
+		if (!_run_fits(sd, cells, col, g->cols)) {
+			g->irregular[row] = EINA_TRUE;
+			return;
+		}
+	}
+}
+
+/* Is the row @p row of @p g regular up to column @p to (excluded)? */
+static inline Eina_Bool _grid_row_is_regular(struct termview *const sd, const struct grid *const g,
+					     const unsigned int row, const unsigned int to)
+{
+	return g->textgrid || (!g->irregular[row]) ||
+	       _row_is_regular(sd, g->cells[row], to, g->cols);
+}
+
+/* Place @p cur at the beginning of the paragraph of @p row. The paragraph
+ * after the last row is the empty one that ends the textblock. */
+static void _paragraph_start_get(const struct grid *const g, const unsigned int row,
+				 Evas_Textblock_Cursor *const cur)
+{
+	if (row < g->rows) {
+		evas_textblock_cursor_copy(g->cursors[row], cur);
+	} else {
+		evas_textblock_cursor_copy(g->cursors[g->rows - 1u], cur);
+		evas_textblock_cursor_paragraph_next(cur);
+	}
+	evas_textblock_cursor_paragraph_char_first(cur);
+}
+
+/* Whoever removes the separators must have them written again with the next
+ * redraw, even if the cursor stays in its cell: it is then marked as moved */
+static void _cursor_separators_remove(struct termview *const sd)
+{
+	if (!sd->cursor.sep_written)
+		return;
+
+	/* This is the situation:
+	 *
+	 * ,-- cursor.x
+	 * |
+	 * v
+	 * +---+---+---+---+
+	 * |   | < |   | = |
+	 * +---+---+---+---+
+	 *   ^       ^
+	 *   |       '--- delete this
+	 *   '--- delete this
+	 */
+	Evas_Textblock_Cursor *const cur = sd->cursor.grid->cur;
+	evas_textblock_cursor_char_delete(cur);
+	evas_textblock_cursor_char_next(cur);
+	evas_textblock_cursor_char_delete(cur);
+	sd->cursor.sep_written = EINA_FALSE;
+	sd->cursor.moved = EINA_TRUE;
+}
+
+Eina_Bool termview_init(void)
+{
+	static Evas_Smart_Class sc;
+
+	static const Evas_Smart_Cb_Description smart_callbacks[] = { { "relayout", "" },
+								     { NULL, NULL } };
+
+	evas_object_smart_clipped_smart_set(&_parent_sc);
+	sc = _parent_sc;
+	sc.name = "termview";
+	sc.version = EVAS_SMART_CLASS_VERSION;
+	sc.add = _smart_add;
+	sc.del = _smart_del;
+	sc.resize = _smart_resize;
+	sc.callbacks = smart_callbacks, _smart = evas_smart_class_new(&sc);
+
+	return EINA_TRUE;
+}
+
+void termview_shutdown(void)
+{
+	evas_smart_free(_smart);
+}
+
+Evas_Object *termview_add(Evas_Object *parent, struct nvim *nvim)
 {
 	Evas *const e = evas_object_evas_get(parent);
 	Evas_Object *const obj = evas_object_smart_add(e, _smart);
@@ -825,6 +2018,16 @@ Evas_Object *termview_add(Evas_Object *parent, struct nvim *nvim)
 	sd->object = obj;
 	sd->nvim = nvim;
 	sd->layout = parent;
+
+	/* The main grid always exists, even before neovim tells about it. The
+	 * other ones are created on demand, with the same renderer. */
+	sd->textgrid = !strcmp(nvim->opts->renderer, "textgrid");
+	if (EINA_UNLIKELY(!_grid_init(sd, &sd->grid, 1))) {
+		evas_object_del(obj);
+		return NULL;
+	}
+	if (nvim->startup.spawned != 0u)
+		evas_event_callback_add(e, EVAS_CALLBACK_RENDER_POST, &_startup_render_post_cb, sd);
 	return obj;
 }
 
@@ -841,183 +2044,603 @@ void termview_size_get(const Evas_Object *obj, unsigned int *cols, unsigned int
 {
 	struct termview *const sd = evas_object_smart_data_get(obj);
 	if (cols)
-		*cols = sd->cols;
+		*cols = sd->grid.cols;
 	if (rows)
-		*rows = sd->rows;
+		*rows = sd->grid.rows;
 }
 
-void termview_matrix_set(Evas_Object *const obj, const unsigned int cols, const unsigned int rows)
+static void _grid_clear(struct termview *const sd, struct grid *const g)
 {
-	EINA_SAFETY_ON_TRUE_RETURN((cols == 0) || (rows == 0));
-	struct termview *const sd = evas_object_smart_data_get(obj);
+	/* All lines do change, entirely. */
+	for (unsigned int i = 0u; i < g->rows; i++) {
+		_row_blank(g->cells[i], g->cols);
+		_dirty_add(g, i, 0u, g->cols);
+		g->irregular[i] = EINA_FALSE;
+	}
 
-	/* Prevent useless resize */
-	if ((sd->cols == cols) && (sd->rows == rows)) {
+	/* Textgrids are made of cells already: the flush will blank them */
+	if (g->textgrid)
 		return;
+
+	/* Delete everything written in the textblock */
+	evas_object_textblock_clear(g->textblock);
+	if ((sd->cursor.grid == g) && sd->cursor.sep_written) {
+		sd->cursor.sep_written = EINA_FALSE;
+		sd->cursor.moved = EINA_TRUE;
 	}
 
-	/* We maintain the grid of cells as an Iliffe vector. Make sure we properly
-   * resize it without losing allocated memory */
-	if (sd->cells) {
-		free(sd->cells[0]);
+	/* We add paragraph separators (<ps>) for each line. This allows a much
+   * faster textblock lookup. We add an extra space before to avoid internal
+   * textblock errors (is this a bug?) */
+	for (unsigned int i = 0u; i < g->rows; i++)
+		evas_object_textblock_text_markup_prepend(g->cursors[0], " </ps>");
+
+	/* One cursor per paragraph */
+	evas_textblock_cursor_paragraph_first(g->cursors[0]);
+	for (unsigned int i = 1u; i < g->rows; i++) {
+		evas_textblock_cursor_copy(g->cursors[i - 1], g->cursors[i]);
+		evas_textblock_cursor_paragraph_next(g->cursors[i]);
 	}
-	sd->cells = realloc(sd->cells, rows * sizeof(struct cell *));
-	sd->cells[0] = malloc(rows * cols * sizeof(struct cell));
-	for (unsigned int i = 1; i < rows; i++) {
-		sd->cells[i] = sd->cells[i - 1] + cols;
+}
+
+/* We maintain the grid of cells as an Iliffe vector. Scrolling rotates the
+ * rows, so they are not necessarily in the order of the storage. Move the
+ * cells to a storage of @p capacity rows of @p stride cells, where the rows
+ * are laid out in order again. Only the first @p cols cells of the first
+ * @p rows rows are kept. */
+static Eina_Bool _grid_storage_set(struct grid *const g, const unsigned int stride,
+				   const unsigned int capacity, const unsigned int rows,
+				   const unsigned int cols)
+{
+	struct cell *const mem = malloc(sizeof(struct cell) * stride * capacity);
+	struct cell **const cells = malloc(sizeof(struct cell *) * capacity);
+	struct span *const dirty = malloc(sizeof(struct span) * capacity);
+	Eina_Bool *const irregular = malloc(sizeof(Eina_Bool) * capacity);
+	Evas_Textblock_Cursor **const cursors =
+		(g->textblock) ? calloc(capacity, sizeof(Evas_Textblock_Cursor *)) : NULL;
+	if (EINA_UNLIKELY((!mem) || (!cells) || (!dirty) || (!irregular) ||
+			  (g->textblock && (!cursors)))) {
+		CRI("Failed to allocate memory");
+		free(mem);
+		free(cells);
+		free(dirty);
+		free(irregular);
+		free(cursors);
+		return EINA_FALSE;
+	}
+
+	for (unsigned int i = 0u; i < capacity; i++)
+		cells[i] = mem + i * stride;
+	for (unsigned int i = 0u; i < rows; i++) {
+		memcpy(cells[i], g->cells[i], sizeof(struct cell) * cols);
+		dirty[i] = g->dirty[i];
+		irregular[i] = g->irregular[i];
 	}
+	/* The cursors of the rows that are about to be removed are kept too */
+	for (unsigned int i = 0u; cursors && (i < g->rows); i++)
+		cursors[i] = g->cursors[i];
+
+	free(g->cells_mem);
+	free(g->cells);
+	free(g->dirty);
+	free(g->irregular);
+	free(g->cursors);
+	g->cells_mem = mem;
+	g->cells = cells;
+	g->dirty = dirty;
+	g->irregular = irregular;
+	g->cursors = cursors;
+	g->stride = stride;
+	g->capacity = capacity;
+	return EINA_TRUE;
+}
 
-	/* Every cell contains a single whitespace */
-	for (unsigned int i = 0; i < rows; i++) {
-		for (unsigned int j = 0; j < cols; j++) {
-			struct cell *const c = &sd->cells[i][j];
-			c->utf8[0] = ' ';
-			c->bytes = 1;
-			c->style_id = 0;
+/* Add or remove paragraphs at the end of the textblock, so there is one per
+ * row, each with its cursor. The paragraphs of the rows that stay are not
+ * touched. */
+static void _grid_paragraphs_resize(struct termview *const sd, struct grid *const g,
+				    const unsigned int rows)
+{
+	if (rows < g->rows) {
+		Evas_Textblock_Cursor *const from = g->cursors[rows];
+		evas_textblock_cursor_paragraph_char_first(from);
+		_paragraph_start_get(g, g->rows, g->tmp);
+		evas_textblock_cursor_range_delete(from, g->tmp);
+		for (unsigned int i = rows; i < g->rows; i++) {
+			evas_textblock_cursor_free(g->cursors[i]);
+			g->cursors[i] = NULL;
 		}
+		return;
 	}
 
-	/* We maintain a table of cursors, one by line. */
-	if ((sd->cursors) && (rows < sd->rows)) {
-		for (unsigned int i = rows; i < sd->rows; i++) {
-			evas_textblock_cursor_free(sd->cursors[i]);
+	/* New rows get their blank paragraphs just before the empty one that ends
+	 * the textblock, written as by _grid_clear() */
+	if (g->rows == 0u)
+		evas_textblock_cursor_paragraph_first(g->tmp);
+	else
+		_paragraph_start_get(g, g->rows, g->tmp);
+	for (unsigned int i = g->rows; i < rows; i++)
+		eina_strbuf_append_length(sd->line, " </ps>", sizeof(" </ps>") - 1u);
+	evas_object_textblock_text_markup_prepend(g->tmp, eina_strbuf_string_get(sd->line));
+	eina_strbuf_reset(sd->line);
+
+	for (unsigned int i = g->rows; i < rows; i++) {
+		g->cursors[i] = evas_object_textblock_cursor_new(g->textblock);
+		if (i == 0u) {
+			evas_textblock_cursor_paragraph_first(g->cursors[i]);
+		} else {
+			evas_textblock_cursor_copy(g->cursors[i - 1u], g->cursors[i]);
+			evas_textblock_cursor_paragraph_next(g->cursors[i]);
 		}
 	}
-	sd->cursors = realloc(sd->cursors, rows * sizeof(Evas_Textblock_Cursor *));
-	for (unsigned int i = sd->rows; i < rows; i++) {
-		sd->cursors[i] = evas_object_textblock_cursor_new(sd->textblock);
+}
+
+/* Live resizes stream grid_resize events, and neovim redraws the grid after
+ * each one. The storage only grows when the grid outgrows it, by half at
+ * least, and it is handed back once less than a quarter of it is in use. The
+ * cells where the old and new sizes overlap are kept, and only the rows and
+ * columns at the edges are added or removed, so the flush rewrites what
+ * changed only. */
+static void _grid_matrix_set(struct termview *const sd, struct grid *const g,
+			     const unsigned int cols, const unsigned int rows)
+{
+	/* The length of the runs is stored in 16 bits in the cells */
+	if (EINA_UNLIKELY(cols > UINT16_MAX)) {
+		ERR("Grid %" PRIi64 " cannot be %u columns wide (at most %u)", g->id, cols,
+		    (unsigned int)UINT16_MAX);
+		return;
 	}
+	const unsigned int old_cols = g->cols;
+	const unsigned int kept = MIN(rows, g->rows);
 
-	/* Make sure our set of changed line has the right size. We don't care
-   * about its values, as we call termview_clear() just after */
-	sd->line_has_changed = realloc(sd->line_has_changed, sizeof(Eina_Bool) * rows);
+	/* The runs that cross the new right edge are cut there */
+	if (cols < old_cols) {
+		for (unsigned int i = 0u; i < kept; i++)
+			_run_split(g->cells[i], cols, old_cols);
+	}
 
-	sd->cols = cols;
-	sd->rows = rows;
-	termview_clear(obj);
+	if ((cols > g->stride) || (rows > g->capacity)) {
+		unsigned int stride = g->stride;
+		unsigned int capacity = g->capacity;
+		if (cols > stride)
+			stride = MAX(cols, stride + stride / 2u);
+		if (rows > capacity)
+			capacity = MAX(rows, capacity + capacity / 2u);
+		const unsigned int kept_cols = MIN(cols, old_cols);
+		if (EINA_UNLIKELY(!_grid_storage_set(g, stride, capacity, kept, kept_cols)))
+			return;
+	}
 
-	sd->in_resize--;
-	sd->may_send_relayout = sd->in_resize == 0;
+	/* The invisible separators of the cursor would shift the paragraphs */
+	if (sd->cursor.grid == g) {
+		if (g->textblock)
+			_cursor_separators_remove(sd);
+		sd->cursor.moved = EINA_TRUE;
+	}
+	if (g->textgrid)
+		evas_object_textgrid_size_set(g->textgrid, (int)cols, (int)rows);
+	else
+		_grid_paragraphs_resize(sd, g, rows);
+
+	/* The columns exposed on the right are blank. When the width changes, the
+	 * kept rows are rewritten entirely, as their paragraphs still have the old
+	 * width. A textgrid reallocates all its cells on any resize: they are all
+	 * rewritten. */
+	const Eina_Bool rewrite = (cols != old_cols) || (g->textgrid != NULL);
+	for (unsigned int i = 0u; i < kept; i++) {
+		if (cols > old_cols)
+			_row_blank(g->cells[i] + old_cols, cols - old_cols);
+		if (rewrite)
+			_dirty_add(g, i, 0u, cols);
+	}
+	for (unsigned int i = kept; i < rows; i++) {
+		_row_blank(g->cells[i], cols);
+		g->dirty[i].start = g->dirty[i].end = 0u;
+		_dirty_add(g, i, 0u, cols);
+		g->irregular[i] = EINA_FALSE;
+	}
+	g->cols = cols;
+	g->rows = rows;
+
+	/* The last run of the kept rows may have been cut to a single cell */
+	if (cols < old_cols) {
+		for (unsigned int i = 0u; i < kept; i++)
+			_row_fits_update(sd, g, i, cols, cols);
+	}
+
+	if (EINA_UNLIKELY((size_t)cols * rows * 4u < (size_t)g->stride * g->capacity))
+		_grid_storage_set(g, cols, rows, rows, cols);
+	_grid_place(sd, g);
 }
 
-void termview_clear(Evas_Object *const obj)
+void termview_matrix_set(Evas_Object *const obj, const t_int grid_id, const unsigned int cols,
+			 const unsigned int rows)
 {
+	EINA_SAFETY_ON_TRUE_RETURN((cols == 0) || (rows == 0));
 	struct termview *const sd = evas_object_smart_data_get(obj);
-	EINA_SAFETY_ON_FALSE_RETURN(sd->cols != 0 && sd->rows != 0);
 
-	/* Delete everything written in the textblock */
-	evas_object_textblock_clear(sd->textblock);
-	sd->cursor.sep_written = EINA_FALSE;
-
-	/* Write ones everywhere. All lines do change. */
-	memset(sd->line_has_changed, 0xff, sizeof(Eina_Bool) * sd->rows);
+	/* Only the main grid is tied to the size of the termview */
+	if (grid_id != 1) {
+		struct grid *const g = _grid_find_or_add(sd, grid_id);
+		if (EINA_LIKELY(g != NULL) && ((g->cols != cols) || (g->rows != rows)))
+			_grid_matrix_set(sd, g, cols, rows);
+		return;
+	}
 
-	/* We add paragraph separators (<ps>) for each line. This allows a much
-   * faster textblock lookup. We add an extra space before to avoid internal
-   * textblock errors (is this a bug?) */
-	for (unsigned int i = 0u; i < sd->rows; i++)
-		evas_object_textblock_text_markup_prepend(sd->cursors[0], " </ps>");
+	/* Prevent useless resize */
+	if ((sd->grid.cols != cols) || (sd->grid.rows != rows))
+		_grid_matrix_set(sd, &sd->grid, cols, rows);
 
-	/* One cursor per paragraph */
-	evas_textblock_cursor_paragraph_first(sd->cursors[0]);
-	for (unsigned int i = 1u; i < sd->rows; i++) {
-		evas_textblock_cursor_copy(sd->cursors[i - 1], sd->cursors[i]);
-		evas_textblock_cursor_paragraph_next(sd->cursors[i]);
-	}
+	/* This answers the last request, even if neovim settled on another size
+	 * or kept the current one */
+	_resize_settle(sd);
 }
 
-void termview_line_edit(Evas_Object *const obj, const unsigned int row, const unsigned int col,
-			const char *text, size_t text_len, const t_int style_id,
-			const size_t repeat)
+void termview_clear(Evas_Object *const obj, const t_int grid_id)
 {
 	struct termview *const sd = evas_object_smart_data_get(obj);
-	struct cell *const cells_row = sd->cells[row];
-	for (size_t i = 0; i < repeat; i++) {
-		struct cell *const c = &cells_row[col + i];
-		if (text_len == 1) {
-			switch (text[0]) {
-			case '<':
-				text = "&lt;";
-				text_len = 4;
-				break;
+	struct grid *const g = _grid_find(sd, grid_id);
+	EINA_SAFETY_ON_NULL_RETURN(g);
+	EINA_SAFETY_ON_FALSE_RETURN(g->cols != 0 && g->rows != 0);
+	_grid_clear(sd, g);
+}
 
-			case '>':
-				text = "&gt;";
-				text_len = 4;
-				break;
+void termview_line_edit(Evas_Object *const obj, const t_int grid_id, const unsigned int row,
+			const unsigned int col, const char *text, size_t text_len,
+			const t_int style_id, const size_t repeat)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+	struct grid *const g = _grid_find(sd, grid_id);
+	EINA_SAFETY_ON_FALSE_RETURN((g != NULL) && (row < g->rows));
+	struct cell *const cells_row = g->cells[row];
+	/* Written so it cannot overflow, whatever neovim sent */
+	EINA_SAFETY_ON_FALSE_RETURN((col < g->cols) && (repeat > 0) && (repeat <= g->cols - col));
+	const unsigned int end = col + (unsigned int)repeat;
+	PROFILE_COUNT(PROFILE_COUNTER_CELLS_WRITTEN, repeat);
+
+	/* Styles are stored in 16 bits in the cells. Neovim's identifiers are
+	 * dense, so this is never reached in practice. The style was reported
+	 * when it was defined. */
+	const uint16_t style =
+		EINA_UNLIKELY((style_id < 0) || (style_id > UINT16_MAX)) ? 0u : (uint16_t)style_id;
+
+	/* The new run must not overlap with a run that would not be entirely
+	 * overwritten */
+	_run_split(cells_row, end, g->cols);
+	_run_split(cells_row, col, g->cols);
+
+	struct cell *const c = &cells_row[col];
+	_cell_text_set(sd, c, text, text_len);
+	c->repeat = (uint16_t)repeat;
+	c->style_id = style;
+	for (unsigned int i = col + 1u; i < end; i++)
+		cells_row[i].repeat = 0;
+	_dirty_add(g, row, col, end);
+	_row_fits_update(sd, g, row, col, end);
+}
 
-			case '&':
-				text = "&amp;";
-				text_len = 5;
-				break;
+static Eina_Bool _palette_entry_set_cb(const Eina_Hash *const hash EINA_UNUSED,
+				       const void *const key EINA_UNUSED, void *const data,
+				       void *const fdata)
+{
+	const struct grid *const g = data;
+	const struct palette *const palette = fdata;
+	const unsigned int index = palette->count - 1u;
+	const union color c = palette->colors[index];
+	evas_object_textgrid_palette_set(g->textgrid, EVAS_TEXTGRID_PALETTE_EXTENDED, (int)index,
+					 c.r, c.g, c.b, 255);
+	return EINA_TRUE;
+}
 
-			case '"':
-				text = "&quot;";
-				text_len = 6;
-				break;
+/* Find the palette entry of the color @p color, and create it if needed.
+ * When the palette is full, the closest color is used instead. */
+static uint8_t _palette_index_get(struct termview *const sd, const uint32_t color)
+{
+	struct palette *const palette = &sd->palette;
+	const union color c = { .value = color & 0xFFFFFF };
+
+	/* This is only done when a style is first used, so palettes are small
+	 * enough to be searched sequentially */
+	for (unsigned int i = 0u; i < palette->count; i++) {
+		if (palette->colors[i].value == c.value)
+			return (uint8_t)i;
+	}
 
-			case '\'':
-				text = "&apos;";
-				text_len = 6;
-				break;
+	if (EINA_UNLIKELY(palette->count == PALETTE_SIZE)) {
+		unsigned int best = 0u, best_dist = UINT_MAX;
+		for (unsigned int i = 0u; i < PALETTE_SIZE; i++) {
+			const union color p = palette->colors[i];
+			const int dr = p.r - c.r, dg = p.g - c.g, db = p.b - c.b;
+			const unsigned int dist = (unsigned int)(dr * dr + dg * dg + db * db);
+			if (dist < best_dist) {
+				best = i;
+				best_dist = dist;
 			}
 		}
-		assert(text_len <= sizeof(c->utf8));
-		memcpy(c->utf8, text, text_len);
-		c->bytes = (uint32_t)text_len;
-		c->style_id = (uint32_t)style_id;
+		return (uint8_t)best;
 	}
-	sd->line_has_changed[row] = EINA_TRUE;
+
+	/* All the textgrids share the same palette */
+	const unsigned int index = palette->count++;
+	palette->colors[index] = c;
+	evas_object_textgrid_palette_set(sd->grid.textgrid, EVAS_TEXTGRID_PALETTE_EXTENDED,
+					 (int)index, c.r, c.g, c.b, 255);
+	eina_hash_foreach(sd->grids, &_palette_entry_set_cb, palette);
+	return (uint8_t)index;
 }
 
-void termview_flush(Evas_Object *const obj)
+/* Convert the cell @p c into a textgrid cell */
+static void _textgrid_cell_make(struct termview *const sd, const struct cell *const c,
+				Evas_Textgrid_Cell *const tc)
 {
-	struct termview *const sd = evas_object_smart_data_get(obj);
-	Eina_Strbuf *const line = sd->line;
+	struct palette *const palette = &sd->palette;
+	if (!palette->defaults_ok) {
+		palette->default_fg = _palette_index_get(sd, sd->style.default_fg.value);
+		palette->default_bg = _palette_index_get(sd, sd->style.default_bg.value);
+		palette->defaults_ok = EINA_TRUE;
+	}
 
-	if (sd->pending_style_update)
-		termview_style_update(obj);
+	memset(tc, 0, sizeof(*tc));
+	tc->fg_extended = 1;
+	tc->bg_extended = 1;
+	tc->fg = palette->default_fg;
+	tc->bg = palette->default_bg;
+
+	/* Textgrids hold a single codepoint per cell: graphemes are cut to
+	 * their first one. The right half of double-width characters is zero. */
+	unsigned int bytes;
+	const char *const text = _cell_text_get(sd, c, &bytes);
+	if (bytes != 0u) {
+		char utf8[sizeof(c->utf8) + 1u] = { 0 };
+		int index = 0;
+		memcpy(utf8, text, MIN(bytes, (unsigned int)sizeof(c->utf8)));
+		tc->codepoint = eina_unicode_utf8_next_get(utf8, &index);
+	}
+
+	struct style_entry *const entry = _style_entry_find(sd, c->style_id);
+	if (!entry)
+		return;
+
+	const struct termview_style *const style = &(entry->style);
+	if (!entry->palette_ok) {
+		uint32_t fg = (style->fg_color.value == COLOR_DEFAULT) ? sd->style.default_fg.value :
+									    style->fg_color.value;
+		uint32_t bg = (style->bg_color.value == COLOR_DEFAULT) ? sd->style.default_bg.value :
+									    style->bg_color.value;
+		if (style->reverse) {
+			const uint32_t tmp = fg;
+			fg = bg;
+			bg = tmp;
+		}
+		entry->palette_fg = _palette_index_get(sd, fg);
+		entry->palette_bg = _palette_index_get(sd, bg);
+		entry->palette_ok = EINA_TRUE;
+	}
+	tc->fg = entry->palette_fg;
+	tc->bg = entry->palette_bg;
+	tc->bold = style->bold;
+	tc->italic = style->italic;
+	tc->underline = style->underline || style->undercurl;
+	tc->strikethrough = style->strikethrough;
+}
 
-	for (unsigned int i = 0u; i < sd->rows; i++) {
-		if (!sd->line_has_changed[i])
+/* Write the rows of the textgrid of @p g that changed since the last flush.
+ * There is no markup involved: cells are copied in the rows of the textgrid. */
+static void _textgrid_flush(struct termview *const sd, struct grid *const g)
+{
+	for (unsigned int i = 0u; i < g->rows; i++) {
+		struct span *const dirty = &(g->dirty[i]);
+		if (dirty->start >= dirty->end)
+			continue;
+
+		Evas_Textgrid_Cell *const cells = evas_object_textgrid_cellrow_get(g->textgrid, (int)i);
+		if (EINA_UNLIKELY(!cells))
 			continue;
-		const struct cell *const row = sd->cells[i];
 
-		if (sd->cursor.y == i)
-			sd->cursor.sep_written = EINA_FALSE;
+		const struct cell *const row = g->cells[i];
+		const unsigned int start = dirty->start;
+		const unsigned int end = MIN(dirty->end, g->cols);
+		for (unsigned int col = start; col < end;) {
+			const unsigned int head = _run_head(row, col);
+			const struct cell *const c = &row[head];
+			const unsigned int count = MIN(head + c->repeat, end) - col;
+
+			Evas_Textgrid_Cell tc;
+			_textgrid_cell_make(sd, c, &tc);
+			for (unsigned int k = 0u; k < count; k++)
+				cells[col + k] = tc;
+
+			/* The cell after a double-width character is empty */
+			if ((c->utf8[0] == '\0') && (col > 0u))
+				cells[col - 1u].double_width = 1;
+			col += count;
+		}
+
+		evas_object_textgrid_cellrow_set(g->textgrid, (int)i, cells);
+		evas_object_textgrid_update_add(g->textgrid, (int)start, (int)i, (int)(end - start),
+						1);
+		dirty->start = dirty->end = 0u;
+	}
+	g->changed = EINA_FALSE;
+}
+
+/* Render the rows of the grid @p g that changed since the last flush */
+static void _grid_flush(struct termview *const sd, struct grid *const g)
+{
+	Eina_Strbuf *const line = sd->line;
+
+	if (!g->changed)
+		return;
+	if (g->textgrid) {
+		_textgrid_flush(sd, g);
+		return;
+	}
+
+	for (unsigned int i = 0u; i < g->rows; i++) {
+		struct span *const dirty = &(g->dirty[i]);
+		if (dirty->start >= dirty->end)
+			continue;
+		const struct cell *const row = g->cells[i];
+
+		/* The invisible separators would shift the columns of the line */
+		if ((sd->cursor.grid == g) && (sd->cursor.y == i))
+			_cursor_separators_remove(sd);
+
+		/* Widen the span so it starts just after a cell of the default style
+		 * and ends just before one (or at the line's boundaries). Cells
+		 * outside of the span did not change, so we know that no textblock
+		 * format crosses the boundaries of the widened span. When the span is
+		 * deleted, Evas will then pair all the formats it contained and
+		 * remove them, leaving no dangling style behind. */
+		unsigned int start = dirty->start;
+		unsigned int end = MIN(dirty->end, g->cols);
+		while (start > 0u) {
+			const unsigned int head = _run_head(row, start - 1u);
+			if (row[head].style_id == 0u)
+				break;
+			start = head;
+		}
+		while (end < g->cols) {
+			const unsigned int head = _run_head(row, end);
+			if (row[head].style_id == 0u)
+				break;
+			end = head + row[head].repeat;
+		}
 
 		uint32_t last_style = 0;
-		for (unsigned int col = 0u; col < sd->cols; col++) {
-			const struct cell *const c = &row[col];
+		for (unsigned int col = start; col < end;) {
+			/* Only the first run may be entered by its middle */
+			const unsigned int head = _run_head(row, col);
+			const struct cell *const c = &row[head];
+			const unsigned int count = MIN(head + c->repeat, end) - col;
 
 			if (c->style_id != last_style) {
-				if (last_style != 0) {
-					eina_strbuf_append_printf(line, "</X%" PRIx32 ">",
-								  last_style);
-				}
-				if (c->style_id != 0) {
-					eina_strbuf_append_printf(line, "<X%" PRIx32 ">",
-								  c->style_id);
-				}
+				if (last_style != 0)
+					_style_tag_append(sd, line, last_style, EINA_TRUE);
+				if (c->style_id != 0)
+					_style_tag_append(sd, line, c->style_id, EINA_FALSE);
 			}
 
-			eina_strbuf_append_length(line, c->utf8, c->bytes);
+			_run_append(sd, line, c, count);
 			last_style = c->style_id;
+			col += count;
 		}
 		if (last_style != 0)
-			eina_strbuf_append_printf(line, "</X%" PRIx32 ">", last_style);
-
-		Evas_Textblock_Cursor *const start = sd->cursors[i];
-		Evas_Textblock_Cursor *const end = sd->tmp;
-		evas_textblock_cursor_copy(start, end);
-		evas_textblock_cursor_paragraph_char_first(start);
-		evas_textblock_cursor_paragraph_char_last(end);
+			_style_tag_append(sd, line, last_style, EINA_TRUE);
+
+		Evas_Textblock_Cursor *const from = g->cursors[i];
+		Evas_Textblock_Cursor *const to = g->tmp;
+		evas_textblock_cursor_paragraph_char_first(from);
+		if ((start == 0u) && (end == g->cols)) {
+			/* The whole line is rewritten. It may not be in sync with
+			 * the cells (e.g. after a clear), so don't walk through it */
+			evas_textblock_cursor_copy(from, to);
+			evas_textblock_cursor_paragraph_char_last(to);
+		} else {
+			_cursor_advance(sd, from, row, 0u, start);
+			evas_textblock_cursor_copy(from, to);
+			_cursor_advance(sd, to, row, start, end);
+		}
 
-		evas_textblock_cursor_range_delete(start, end);
-		evas_object_textblock_text_markup_prepend(end, eina_strbuf_string_get(line));
+		evas_textblock_cursor_range_delete(from, to);
+		evas_object_textblock_text_markup_prepend(to, eina_strbuf_string_get(line));
 		eina_strbuf_reset(line);
+		dirty->start = dirty->end = 0u;
+
+		/* The edits that flagged the row may have been overwritten since */
+		if (g->irregular[i])
+			g->irregular[i] = !_row_is_regular(sd, row, g->cols, g->cols);
+	}
+	g->changed = EINA_FALSE;
+}
+
+static Eina_Bool _grid_flush_cb(const Eina_Hash *const hash EINA_UNUSED,
+				const void *const key EINA_UNUSED, void *const data,
+				void *const fdata)
+{
+	_grid_flush(fdata, data);
+	return EINA_TRUE;
+}
+
+static void _grid_dirty_all(struct grid *const g)
+{
+	for (unsigned int i = 0u; i < g->rows; i++)
+		_dirty_add(g, i, 0u, g->cols);
+}
+
+static Eina_Bool _grid_dirty_all_cb(const Eina_Hash *const hash EINA_UNUSED,
+				    const void *const key EINA_UNUSED, void *const data,
+				    void *const fdata EINA_UNUSED)
+{
+	_grid_dirty_all(data);
+	return EINA_TRUE;
+}
+
+static void _grids_dirty_all(struct termview *const sd)
+{
+	_grid_dirty_all(&sd->grid);
+	eina_hash_foreach(sd->grids, &_grid_dirty_all_cb, NULL);
+}
+
+static void _flush_apply(Evas_Object *const obj)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+	PROFILE_START(flush_start);
+	PROFILE_SCOPE_ENTER(flush_scope, PROFILE_SCOPE_FLUSH);
+
+	if (sd->pending_style_update)
+		termview_style_update(obj);
+
+	/* The colors of some styles changed: textgrids must write their cells again */
+	if (sd->palette.redraw) {
+		sd->palette.redraw = EINA_FALSE;
+		_grids_dirty_all(sd);
+	}
+
+	/* Grids that did not change are not touched */
+	_grid_flush(sd, &sd->grid);
+	eina_hash_foreach(sd->grids, &_grid_flush_cb, sd);
+	PROFILE_SCOPE_LEAVE(flush_scope);
+	PROFILE_STOP("termview flush", flush_start);
+
+	if (EINA_UNLIKELY(sd->nvim->startup.flushed == 0u))
+		sd->nvim->startup.flushed = profile_time_get();
+
+	/* This flush is deemed to be neovim's answer to the pending keys */
+	struct latency *const lat = &sd->latency;
+	if (lat->key != 0u) {
+		PROFILE_STOP("key to flush", lat->key);
+		if (lat->flushed == 0u)
+			lat->flushed = lat->key;
+		lat->key = 0u;
 	}
-	memset(sd->line_has_changed, 0, sizeof(Eina_Bool) * sd->rows);
+}
+
+static int _latency_cmp(const void *const a, const void *const b)
+{
+	const uint64_t la = *(const uint64_t *)a;
+	const uint64_t lb = *(const uint64_t *)b;
+	return (la > lb) - (la < lb);
+}
+
+void termview_latency_get(const Evas_Object *const obj, struct termview_latency *const latency)
+{
+	const struct termview *const sd = evas_object_smart_data_get(obj);
+	const struct latency *const lat = &sd->latency;
+	uint64_t sorted[LATENCY_SAMPLES];
+
+	memset(latency, 0, sizeof(*latency));
+	latency->samples = lat->count;
+	if (lat->count == 0u)
+		return;
+
+	memcpy(sorted, lat->samples, lat->count * sizeof(*sorted));
+	qsort(sorted, lat->count, sizeof(*sorted), &_latency_cmp);
+	const unsigned int last = (lat->next + LATENCY_SAMPLES - 1u) % LATENCY_SAMPLES;
+	latency->last = (double)lat->samples[last] / 1e6;
+	latency->p50 = (double)sorted[(lat->count - 1u) / 2u] / 1e6;
+	latency->p99 = (double)sorted[((lat->count - 1u) * 99u) / 100u] / 1e6;
+	latency->max = (double)sorted[lat->count - 1u] / 1e6;
 }
 
 /**
@@ -1026,37 +2649,25 @@ void termview_flush(Evas_Object *const obj)
  * when we receive cursor_goto, because the flush method has not yet been
  * called, which means that we cannot manipulate nor query the textblock!
  */
-void termview_redraw_end(Evas_Object *const obj)
+static void _redraw_end_apply(struct termview *const sd)
 {
-	struct termview *const sd = evas_object_smart_data_get(obj);
-
+	struct grid *const g = sd->cursor.next_grid;
 	const unsigned int to_x = sd->cursor.next_x;
 	const unsigned int to_y = sd->cursor.next_y;
 
 	/* Avoid useless computations */
-	if ((to_x == sd->cursor.x) && (to_y == sd->cursor.y) && (!sd->mode_changed))
+	if ((g == sd->cursor.grid) && (to_x == sd->cursor.x) && (to_y == sd->cursor.y) &&
+	    (!sd->mode_changed) && (!sd->cursor.moved))
+		return;
+
+	/* The grid may have been resized since the cursor was sent there */
+	if (EINA_UNLIKELY((to_y >= g->rows) || (to_x >= g->cols)))
 		return;
 
 	/* Before moving the cursor, we delete the character JUST BEFORE the cursor.
 	 * It is the invisible separator, we want it removed before the cursor
 	 * goes away */
-	if (sd->cursor.sep_written) {
-		/* This is the situation:
-		 *
-		 * ,-- cursor.x
-		 * |
-		 * v
-		 * +---+---+---+---+
-		 * |   | < |   | = |
-		 * +---+---+---+---+
-		 *   ^       ^
-		 *   |       '--- delete this
-		 *   '--- delete this
-		 */
-		evas_textblock_cursor_char_delete(sd->cursor.cur);
-		evas_textblock_cursor_char_next(sd->cursor.cur);
-		evas_textblock_cursor_char_delete(sd->cursor.cur);
-	}
+	_cursor_separators_remove(sd);
 
 	/* This is the situation:
 	 *
@@ -1071,54 +2682,247 @@ void termview_redraw_end(Evas_Object *const obj)
 	 * '-- place a whitespace
 	 */
 
-	/* Move the cursor to position (to_x + 1, to_y). Note the to_x+1, very
-	 * important! It is used to insert a whitespace */
-	evas_textblock_cursor_copy(sd->cursors[to_y], sd->cursor.cur);
-	evas_textblock_cursor_paragraph_char_first(sd->cursor.cur);
-	for (unsigned int i = 0u; i <= to_x; i++)
-		evas_textblock_cursor_char_next(sd->cursor.cur);
-
-	/* Insert the invisible separator at to_x+1 and to_x */
-	if (sd->nvim->gui.theme.cursor_cuts_ligatures) {
-		evas_textblock_cursor_text_append(sd->cursor.cur, INVISIBLE_SEP);
-		evas_textblock_cursor_char_prev(sd->cursor.cur);
-		evas_textblock_cursor_text_append(sd->cursor.cur, INVISIBLE_SEP);
-		sd->cursor.sep_written = EINA_TRUE;
-	} else
-		evas_textblock_cursor_char_prev(sd->cursor.cur);
+	const struct cell *const row = g->cells[to_y];
+	/* Textgrids have no ligatures, and their rows are always regular */
+	const Eina_Bool cuts_ligatures = sd->nvim->gui.theme.cursor_cuts_ligatures && !g->textgrid;
+	const Eina_Bool regular = _grid_row_is_regular(sd, g, to_y, MIN(to_x + 1u, g->cols));
+	Evas_Textblock_Cursor *const cur = g->cur;
+
+	/* The textblock cursor is only needed to write the separators, or to
+	 * find out where the row is, when the grid model cannot tell */
+	if (cuts_ligatures || !regular) {
+		/* Move the cursor to position (to_x + 1, to_y). Note the to_x+1,
+		 * very important! It is used to insert a whitespace */
+		evas_textblock_cursor_copy(g->cursors[to_y], cur);
+		evas_textblock_cursor_paragraph_char_first(cur);
+		_cursor_advance(sd, cur, row, 0u, MIN(to_x + 1u, g->cols));
+
+		/* Insert the invisible separator at to_x+1 and to_x */
+		if (cuts_ligatures) {
+			evas_textblock_cursor_text_append(cur, INVISIBLE_SEP);
+			evas_textblock_cursor_char_prev(cur);
+			evas_textblock_cursor_text_append(cur, INVISIBLE_SEP);
+			sd->cursor.sep_written = EINA_TRUE;
+		} else
+			evas_textblock_cursor_char_prev(cur);
+	}
 
+	/* The geometry of the grid's object accounts for its position */
 	int ox, oy;
-	evas_object_geometry_get(sd->textblock, &ox, &oy, NULL, NULL);
-
-	int y = 0, h = 0;
-	evas_textblock_cursor_char_geometry_get(sd->cursor.cur, NULL, &y, NULL, &h);
+	evas_object_geometry_get(_grid_object(g), &ox, &oy, NULL, NULL);
+
+	/* The cursor covers both cells of a double-width character */
+	const int w = (int)(_cell_width(row, to_x, g->cols) * sd->cell_w);
+	int x, y, h;
+	if (regular) {
+		x = (int)(to_x * sd->cell_w);
+		y = (int)(to_y * sd->cell_h);
+		h = (int)sd->cell_h;
+	} else {
+		x = y = h = 0;
+		evas_textblock_cursor_char_geometry_get(cur, &x, &y, NULL, &h);
+	}
 	if (!gui_cmdline_enabled_get(&sd->nvim->gui))
-		gui_cursor_calc(&sd->nvim->gui, (int)(to_x * sd->cell_w) + ox, y + oy,
-				(int)sd->cell_w, h);
+		gui_cursor_calc(&sd->nvim->gui, x + ox, y + oy, w, h);
 
 	/* Update the cursor's current position */
+	sd->cursor.grid = g;
 	sd->cursor.x = to_x;
 	sd->cursor.y = to_y;
+	sd->cursor.moved = EINA_FALSE;
 	sd->mode_changed = EINA_FALSE;
 }
 
-void termview_cursor_goto(Evas_Object *const obj, const unsigned int to_x, const unsigned int to_y)
+static void _frame_render(Evas_Object *const obj)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+
+	/* Held until neovim settles on a size. _resize_cb() schedules it then. */
+	if (_resize_pending(sd))
+		return;
+
+	/* The cursor is placed within the text, so the text goes first */
+	if (sd->frame.flush) {
+		sd->frame.flush = EINA_FALSE;
+		_flush_apply(obj);
+	}
+	if (sd->frame.redraw_end) {
+		sd->frame.redraw_end = EINA_FALSE;
+		_redraw_end_apply(sd);
+	}
+}
+
+static Eina_Bool _frame_cb(void *const data)
+{
+	Evas_Object *const obj = data;
+	struct termview *const sd = evas_object_smart_data_get(obj);
+
+	sd->frame.animator = NULL;
+	_frame_render(obj);
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static void _frame_schedule(Evas_Object *const obj)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+
+	if (sd->nvim->gui.theme.render_immediately) {
+		if (sd->frame.animator) {
+			ecore_animator_del(sd->frame.animator);
+			sd->frame.animator = NULL;
+		}
+		_frame_render(obj);
+	} else if (!sd->frame.animator) {
+		sd->frame.animator = ecore_animator_add(&_frame_cb, obj);
+		if (EINA_UNLIKELY(!sd->frame.animator)) {
+			ERR("Failed to create animator. Rendering now.");
+			_frame_render(obj);
+		}
+	}
+}
+
+void termview_flush(Evas_Object *const obj)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+	sd->frame.flush = EINA_TRUE;
+	_frame_schedule(obj);
+}
+
+void termview_redraw_end(Evas_Object *const obj)
 {
 	struct termview *const sd = evas_object_smart_data_get(obj);
-	EINA_SAFETY_ON_FALSE_RETURN(to_y < sd->rows);
-	EINA_SAFETY_ON_FALSE_RETURN(sd->cols != 0 && sd->rows != 0);
+	sd->frame.redraw_end = EINA_TRUE;
+	_frame_schedule(obj);
+}
 
+void termview_cursor_goto(Evas_Object *const obj, const t_int grid_id, const unsigned int to_x,
+			  const unsigned int to_y)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+	struct grid *const g = _grid_find(sd, grid_id);
+	EINA_SAFETY_ON_NULL_RETURN(g);
+	EINA_SAFETY_ON_FALSE_RETURN(to_y < g->rows);
+	EINA_SAFETY_ON_FALSE_RETURN(g->cols != 0 && g->rows != 0);
+
+	sd->cursor.next_grid = g;
 	sd->cursor.next_x = to_x;
 	sd->cursor.next_y = to_y;
 }
 
-void termview_scroll(Evas_Object *const obj, const int top, const int bot, const int left,
-		     const int right, const int rows)
+/* Reverse the elements [first;last) of the array @p base, whose elements are
+ * of @p size bytes */
+static void _array_reverse(void *const base, const size_t size, unsigned int first,
+			   unsigned int last)
+{
+	char tmp[16];
+	char *const mem = base;
+	assert(size <= sizeof(tmp));
+
+	for (; first + 1u < last; first++, last--) {
+		char *const a = mem + first * size;
+		char *const b = mem + (last - 1u) * size;
+		memcpy(tmp, a, size);
+		memcpy(a, b, size);
+		memcpy(b, tmp, size);
+	}
+}
+
+/* Rotate the elements [first;last) of the array @p base by @p n elements
+ * towards the beginning of the array */
+static void _array_rotate(void *const base, const size_t size, const unsigned int first,
+			  const unsigned int last, const unsigned int n)
+{
+	_array_reverse(base, size, first, first + n);
+	_array_reverse(base, size, first + n, last);
+	_array_reverse(base, size, first, last);
+}
+
+/* Scroll the full-width rows [top;bot) by moving the paragraphs of the
+ * textblock instead of rewriting them. The rows that scroll out are deleted,
+ * and as many blank ones are inserted on the other side of the region. Only
+ * the latter will have to be rendered by the next flush. */
+static Eina_Bool _scroll_rotate(struct termview *const sd, struct grid *const g,
+				const unsigned int top, const unsigned int bot, const int rows)
+{
+	const unsigned int count = bot - top;
+	const unsigned int n = (unsigned int)abs(rows);
+	if ((n == 0u) || (n >= count))
+		return EINA_FALSE;
+
+	Evas_Textblock_Cursor *const cur = evas_object_textblock_cursor_new(g->textblock);
+	if (EINA_UNLIKELY(!cur))
+		return EINA_FALSE;
+
+	/* The invisible separators must not travel with the paragraphs. They are
+	 * written again by the next redraw, where the cursor's row now is: the
+	 * row under the cursor changed even though the cursor did not move. */
+	if (sd->cursor.grid == g) {
+		_cursor_separators_remove(sd);
+		sd->cursor.moved = EINA_TRUE;
+	}
+
+	/* Delete the paragraphs that scroll out of the region */
+	const unsigned int gone = (rows > 0) ? top : bot - n;
+	_paragraph_start_get(g, gone, g->tmp);
+	_paragraph_start_get(g, gone + n, cur);
+	evas_textblock_cursor_range_delete(g->tmp, cur);
+
+	/* Insert blank paragraphs where rows are exposed. When they are
+	 * inserted before an existing row, its cursor is used so it stays after
+	 * the inserted text, on its own paragraph. */
+	const unsigned int at = (rows > 0) ? bot : top;
+	Evas_Textblock_Cursor *const ins = (at < g->rows) ? g->cursors[at] : cur;
+	if (at < g->rows)
+		evas_textblock_cursor_paragraph_char_first(ins);
+	else
+		_paragraph_start_get(g, at, ins);
+	for (unsigned int i = 0u; i < n; i++)
+		eina_strbuf_append_length(sd->line, " </ps>", sizeof(" </ps>") - 1u);
+	evas_object_textblock_text_markup_prepend(ins, eina_strbuf_string_get(sd->line));
+	eina_strbuf_reset(sd->line);
+	evas_textblock_cursor_free(cur);
+
+	/* Rotate the rows so they match the paragraphs. Pending changes move
+	 * along with their rows. */
+	const unsigned int shift = (rows > 0) ? n : count - n;
+	_array_rotate(g->cells, sizeof(*g->cells), top, bot, shift);
+	_array_rotate(g->cursors, sizeof(*g->cursors), top, bot, shift);
+	_array_rotate(g->dirty, sizeof(*g->dirty), top, bot, shift);
+	_array_rotate(g->irregular, sizeof(*g->irregular), top, bot, shift);
+
+	/* The exposed rows are blank, and reuse the storage and cursors of the
+	 * rows that were scrolled out */
+	const unsigned int exposed = (rows > 0) ? bot - n : top;
+	for (unsigned int i = exposed; i < exposed + n; i++) {
+		_row_blank(g->cells[i], g->cols);
+		_dirty_add(g, i, 0u, g->cols);
+		g->irregular[i] = EINA_FALSE;
+		if (i == 0u) {
+			evas_textblock_cursor_paragraph_first(g->cursors[i]);
+		} else {
+			evas_textblock_cursor_copy(g->cursors[i - 1u], g->cursors[i]);
+			evas_textblock_cursor_paragraph_next(g->cursors[i]);
+		}
+	}
+	return EINA_TRUE;
+}
+
+void termview_scroll(Evas_Object *const obj, const t_int grid_id, const int top, const int bot,
+		     const int left, const int right, const int rows)
 {
 	struct termview *const sd = evas_object_smart_data_get(obj);
+	struct grid *const g = _grid_find(sd, grid_id);
+	EINA_SAFETY_ON_NULL_RETURN(g);
 	EINA_SAFETY_ON_FALSE_RETURN(right > left);
 	EINA_SAFETY_ON_FALSE_RETURN(top >= 0 && bot >= 0 && left >= 0);
 
+	/* Scrolling full rows is the most common case. It does not require the
+	 * rows to be rewritten. Textgrids own their rows, which must be copied. */
+	if ((!g->textgrid) && (left == 0) && ((unsigned int)right == g->cols) && (bot > top) &&
+	    ((unsigned int)bot <= g->rows) &&
+	    _scroll_rotate(sd, g, (unsigned int)top, (unsigned int)bot, rows))
+		return;
+
 	int start_line, end_line, step;
 	if (rows > 0) {
 		/* Here, we scroll text UPWARDS. Line N-1 is replaced by line N.
@@ -1169,32 +2973,91 @@ void termview_scroll(Evas_Object *const obj, const int top, const int bot, const
 	 */
 	for (int from_line = start_line; from_line != end_line; from_line += step) {
 		const int to_line = from_line - rows;
-		if ((unsigned int)to_line >= sd->rows) {
+		if ((unsigned int)to_line >= g->rows) {
 			continue;
 		}
 
-		const struct cell *const source_row = sd->cells[from_line];
-		struct cell *const target_row = sd->cells[to_line];
+		struct cell *const source_row = g->cells[from_line];
+		struct cell *const target_row = g->cells[to_line];
+
+		/* Make sure runs are contained within the scrolled region, so they
+		 * can be moved as they are */
+		_run_split(source_row, (unsigned int)right, g->cols);
+		_run_split(source_row, (unsigned int)left, g->cols);
+		_run_split(target_row, (unsigned int)right, g->cols);
+		_run_split(target_row, (unsigned int)left, g->cols);
 
 		const size_t len = sizeof(struct cell) * (size_t)(right - left);
 		memcpy(&target_row[left], &source_row[left], len);
 
-		sd->line_has_changed[to_line] = EINA_TRUE;
+		_dirty_add(g, (unsigned int)to_line, (unsigned int)left, (unsigned int)right);
+		if (g->irregular[from_line])
+			g->irregular[to_line] = EINA_TRUE;
+		else
+			_row_fits_update(sd, g, (unsigned int)to_line, (unsigned int)left,
+					 (unsigned int)right);
 	}
 }
 
-void termview_cell_geometry_get(const Evas_Object *const obj, const unsigned int cell_x,
-				const unsigned int cell_y, int *const px, int *const py,
-				int *const pw, int *const ph)
+unsigned int termview_text_width_get(Evas_Object *const obj, const char *const text)
 {
-	const struct termview *const sd = evas_object_smart_data_get(obj);
+	struct termview *const sd = evas_object_smart_data_get(obj);
+	const unsigned int flags = sd->nvim->gui.width_flags;
+	unsigned int width = 0u;
+
+	for (int index = 0; text[index] != '\0';) {
+		const int start = index;
+		const Eina_Unicode cp = eina_unicode_utf8_next_get(text, &index);
+		const unsigned int cells = unicode_width_get(cp, flags);
+		if ((cp < 0x80) || (cells == 0u) || (sd->cell_w == 0u)) {
+			width += cells;
+			continue;
+		}
+		const unsigned int advance =
+			_glyph_advance_get(sd, cp, text + start, (unsigned int)(index - start));
+		width += MAX(cells, (advance + sd->cell_w - 1u) / sd->cell_w);
+	}
+	return width;
+}
 
-	evas_textblock_cursor_copy(sd->cursors[cell_y], sd->tmp);
-	evas_textblock_cursor_paragraph_char_first(sd->tmp);
-	for (unsigned int i = 0u; i < cell_x; i++)
-		evas_textblock_cursor_char_next(sd->tmp);
+void termview_cell_geometry_get(const Evas_Object *const obj, const t_int grid_id,
+				const unsigned int cell_x, const unsigned int cell_y, int *const px,
+				int *const py, int *const pw, int *const ph)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+	const struct grid *const g = _grid_find(sd, grid_id);
+	EINA_SAFETY_ON_NULL_RETURN(g);
+	EINA_SAFETY_ON_FALSE_RETURN((cell_y < g->rows) && (cell_x < g->cols));
+	const struct cell *const row = g->cells[cell_y];
+
+	/* Geometries are relative to the main grid */
+	const int ox = g->col * (int)sd->cell_w;
+	const int oy = g->row * (int)sd->cell_h;
+
+	/* All cells have the same size. Unless the row holds glyphs that don't
+	 * fill their cells, we know where a cell is without asking the textblock.
+	 * Textgrids always give double-width characters two cells. */
+	if (_grid_row_is_regular(sd, g, cell_y, cell_x + 1u)) {
+		if (px)
+			*px = ox + (int)(cell_x * sd->cell_w);
+		if (py)
+			*py = oy + (int)(cell_y * sd->cell_h);
+		if (pw)
+			*pw = (int)(_cell_width(row, cell_x, g->cols) * sd->cell_w);
+		if (ph)
+			*ph = (int)sd->cell_h;
+		return;
+	}
 
-	evas_textblock_cursor_char_geometry_get(sd->tmp, px, py, pw, ph);
+	int x = 0, y = 0;
+	evas_textblock_cursor_copy(g->cursors[cell_y], g->tmp);
+	evas_textblock_cursor_paragraph_char_first(g->tmp);
+	_cursor_advance(sd, g->tmp, row, 0u, cell_x);
+	evas_textblock_cursor_char_geometry_get(g->tmp, &x, &y, pw, ph);
+	if (px)
+		*px = ox + x;
+	if (py)
+		*py = oy + y;
 }
 
 void termview_cursor_mode_set(Evas_Object *const obj, const struct mode *const mode)
@@ -1206,14 +3069,25 @@ void termview_cursor_mode_set(Evas_Object *const obj, const struct mode *const m
 	cursor_mode_set(gui->cursor, mode);
 
 	/* Update the cursor's color settings **************************************/
-	struct termview_style *const style = eina_hash_find(sd->styles, &mode->attr_id);
-	if (style != NULL)
-		cursor_color_set(gui->cursor, style->fg_color);
+	const struct style_entry *const entry = _style_entry_find(sd, mode->attr_id);
+	if (entry != NULL)
+		cursor_color_set(gui->cursor, entry->style.fg_color);
 
 	/* Register the new mode and update the cursor calculation function. */
 	sd->mode_changed = EINA_TRUE;
 }
 
+static Eina_Bool _grid_background_cb(const Eina_Hash *const hash EINA_UNUSED,
+				     const void *const key EINA_UNUSED, void *const data,
+				     void *const fdata)
+{
+	const struct termview *const sd = fdata;
+	const struct grid *const g = data;
+	const union color bg = sd->style.default_bg;
+	evas_object_color_set(g->background, bg.r, bg.g, bg.b, 255);
+	return EINA_TRUE;
+}
+
 void termview_default_colors_set(Evas_Object *const obj, const union color fg, const union color bg,
 				 const union color sp)
 {
@@ -1226,32 +3100,74 @@ void termview_default_colors_set(Evas_Object *const obj, const union color fg, c
 		sd->style.default_fg = fg;
 		sd->style.default_bg = bg;
 		sd->style.default_sp = sp;
+		sd->style.main_changed = EINA_TRUE;
+		sd->style.defaults_changed = EINA_TRUE;
 		sd->pending_style_update = EINA_TRUE;
+		eina_hash_foreach(sd->grids, &_grid_background_cb, sd);
+
+		/* The palette indexes of the styles that use the default colors
+		 * are now wrong. Have them all looked up again. */
+		if (sd->textgrid) {
+			for (unsigned int i = 0u; i < sd->styles_count; i++)
+				sd->styles[i].palette_ok = EINA_FALSE;
+			sd->palette.defaults_ok = EINA_FALSE;
+			sd->palette.redraw = EINA_TRUE;
+		}
 	}
 }
 
 struct termview_style *termview_style_get(Evas_Object *const obj, const t_int style_id)
 {
 	struct termview *const sd = evas_object_smart_data_get(obj);
-	struct termview_style *style = eina_hash_find(sd->styles, &style_id);
-	if (style == NULL) {
-		style = _termview_style_new();
-		if (EINA_UNLIKELY(!style))
-			return NULL;
-		const Eina_Bool added = eina_hash_add(sd->styles, &style_id, style);
-		if (EINA_UNLIKELY(!added)) {
-			ERR("Failed to add style to hash table");
-			_termview_style_free(style);
-			return NULL;
-		}
+	EINA_SAFETY_ON_FALSE_RETURN_VAL((style_id >= 0) && (style_id <= UINT32_MAX), NULL);
+
+	const uint32_t id = (uint32_t)style_id;
+	struct style_entry *const entry = _style_entry_get(sd, id);
+	if (EINA_UNLIKELY(!entry))
+		return NULL;
+	if (!entry->defined) {
+		entry->defined = EINA_TRUE;
+		if (EINA_UNLIKELY(id > UINT16_MAX))
+			ERR("Style %" PRIu32 " cannot be stored in the cells. "
+			    "They will use the default one.",
+			    id);
+
+		/* The tags only depend on the style identifier: it is time to
+		 * render them, once and for all. */
+		if (entry->tags.open_len == 0u)
+			_style_tags_build(sd, id);
+		_style_change_add(sd, id);
 	}
-	return style;
+	return &(entry->style);
 }
 
-void termview_style_changed(Evas_Object *const obj)
+void termview_style_changed(Evas_Object *const obj, const t_int style_id)
 {
 	struct termview *const sd = evas_object_smart_data_get(obj);
-	sd->pending_style_update = EINA_TRUE;
+	if (EINA_LIKELY(_style_entry_find(sd, style_id) != NULL))
+		_style_change_add(sd, (uint32_t)style_id);
+}
+
+static Eina_Bool _grid_font_set_cb(const Eina_Hash *const hash EINA_UNUSED,
+				    const void *const key EINA_UNUSED, void *const data,
+				    void *const fdata)
+{
+	const struct termview *const sd = fdata;
+	const struct grid *const g = data;
+	evas_object_textgrid_font_set(g->textgrid, sd->style.font_name, (int)sd->style.font_size);
+	return EINA_TRUE;
+}
+
+/* Glyphs fill other cells with another font: all the rows are checked again */
+static Eina_Bool _grid_fits_reset_cb(const Eina_Hash *const hash EINA_UNUSED,
+				     const void *const key EINA_UNUSED, void *const data,
+				     void *const fdata)
+{
+	struct termview *const sd = fdata;
+	struct grid *const g = data;
+	for (unsigned int i = 0u; (!g->textgrid) && (i < g->rows); i++)
+		g->irregular[i] = !_row_is_regular(sd, g->cells[i], g->cols, g->cols);
+	return EINA_TRUE;
 }
 
 void termview_font_set(Evas_Object *const obj, Eina_Stringshare *const font_name,
@@ -1263,19 +3179,136 @@ void termview_font_set(Evas_Object *const obj, Eina_Stringshare *const font_name
 
 	eina_stringshare_replace(&sd->style.font_name, font_name);
 	sd->style.font_size = font_size;
-
-	evas_object_textgrid_font_set(sd->sizing_textgrid, sd->style.font_name,
-				      (int)sd->style.font_size);
-	evas_object_textgrid_cell_size_get(sd->sizing_textgrid, (int *)&sd->cell_w,
-					   (int *)&sd->cell_h);
+	sd->glyphs.font_ok = EINA_FALSE;
+	eina_hash_free_buckets(sd->glyphs.advances);
+
+	/* The sizing textgrid only loads the font when its cells were never
+	 * measured, e.g. when zooming to a size that was never used */
+	if (!font_cache_get(obj, font_name, font_size, sd->style.line_gap, &sd->metrics)) {
+		int w = 0, h = 0;
+		evas_object_textgrid_font_set(sd->sizing_textgrid, sd->style.font_name,
+					      (int)sd->style.font_size);
+		evas_object_textgrid_cell_size_get(sd->sizing_textgrid, &w, &h);
+		sd->metrics.cell_w = (unsigned int)MAX(w, 0);
+		sd->metrics.cell_h = (unsigned int)MAX(h, 0);
+		sd->metrics.line_h = 0u;
+		font_cache_set(obj, font_name, font_size, sd->style.line_gap, &sd->metrics);
+	}
+	sd->cell_w = sd->metrics.cell_w;
+	sd->cell_h = ((!sd->textgrid) && (sd->metrics.line_h != 0u)) ? sd->metrics.line_h
+								       : sd->metrics.cell_h;
+	if (sd->textgrid) {
+		evas_object_textgrid_font_set(sd->grid.textgrid, sd->style.font_name,
+					      (int)sd->style.font_size);
+		eina_hash_foreach(sd->grids, &_grid_font_set_cb, sd);
+	} else {
+		_grid_fits_reset_cb(NULL, NULL, &sd->grid, sd);
+		eina_hash_foreach(sd->grids, &_grid_fits_reset_cb, sd);
+	}
 	sd->need_nvim_resize = (old_cell_w != sd->cell_w) || (old_cell_h != sd->cell_h);
+	sd->style.main_changed = EINA_TRUE;
 	sd->pending_style_update = EINA_TRUE;
 }
 
 void termview_linespace_set(Evas_Object *const obj, const unsigned int linespace)
 {
 	struct termview *const sd = evas_object_smart_data_get(obj);
+	struct font_metrics metrics;
 	sd->style.line_gap = linespace;
+
+	/* Only the height of the textblock lines depends on the linegap */
+	if (sd->style.font_name &&
+	    font_cache_get(obj, sd->style.font_name, sd->style.font_size, linespace, &metrics))
+		sd->metrics.line_h = metrics.line_h;
+	else
+		sd->metrics.line_h = 0u;
+	sd->style.main_changed = EINA_TRUE;
 	sd->pending_style_update = EINA_TRUE;
 	sd->need_nvim_resize = EINA_TRUE;
 }
+
+void termview_grid_destroy(Evas_Object *const obj, const t_int grid_id)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+	EINA_SAFETY_ON_TRUE_RETURN(grid_id == 1);
+	struct grid *const g = _grid_find(sd, grid_id);
+	if (!g)
+		return;
+
+	/* The cursor cannot stay in a grid that does not exist anymore. Its
+	 * separators go away with the textblock. */
+	if (sd->cursor.grid == g) {
+		sd->cursor.grid = &sd->grid;
+		sd->cursor.sep_written = EINA_FALSE;
+		sd->cursor.moved = EINA_TRUE;
+	}
+	if (sd->cursor.next_grid == g)
+		sd->cursor.next_grid = &sd->grid;
+	sd->last_grid = NULL;
+
+	const int64_t id = grid_id;
+	eina_hash_del_by_key(sd->grids, &id);
+}
+
+void termview_grid_position_set(Evas_Object *const obj, const t_int grid_id, const int row,
+				const int col, const Eina_Bool floating)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+	EINA_SAFETY_ON_TRUE_RETURN(grid_id == 1);
+	struct grid *const g = _grid_find_or_add(sd, grid_id);
+	if (EINA_UNLIKELY(!g))
+		return;
+
+	/* Windows never overlap each other: they are all just above the main
+	 * grid. Floating windows (and messages) are drawn over them, in the
+	 * order they are placed. */
+	if (floating) {
+		g->zindex = ++sd->zindex_next;
+		evas_object_raise(g->background);
+		evas_object_raise(_grid_object(g));
+	} else {
+		g->zindex = 1u;
+		evas_object_stack_above(g->background, _grid_object(&sd->grid));
+		evas_object_stack_above(_grid_object(g), g->background);
+	}
+
+	g->row = MAX(row, 0);
+	g->col = MAX(col, 0);
+	_grid_place(sd, g);
+	_grid_show(g);
+}
+
+void termview_grid_float_set(Evas_Object *const obj, const t_int grid_id,
+			     const t_int anchor_grid_id, const Eina_Bool south, const Eina_Bool east,
+			     const double row, const double col)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+	const struct grid *anchor = _grid_find(sd, anchor_grid_id);
+	if (EINA_UNLIKELY(!anchor))
+		anchor = &sd->grid;
+	const struct grid *const g = _grid_find(sd, grid_id);
+	EINA_SAFETY_ON_NULL_RETURN(g);
+
+	/* The anchor is the corner of the floating grid that is placed at
+	 * (row, col) of the anchor grid */
+	double y = anchor->row + row;
+	double x = anchor->col + col;
+	if (south)
+		y -= g->rows;
+	if (east)
+		x -= g->cols;
+	termview_grid_position_set(obj, grid_id, (int)y, (int)x, EINA_TRUE);
+}
+
+void termview_grid_hide(Evas_Object *const obj, const t_int grid_id)
+{
+	struct termview *const sd = evas_object_smart_data_get(obj);
+	EINA_SAFETY_ON_TRUE_RETURN(grid_id == 1);
+	struct grid *const g = _grid_find(sd, grid_id);
+	if (!g)
+		return;
+
+	evas_object_hide(g->background);
+	evas_object_hide(_grid_object(g));
+	g->visible = EINA_FALSE;
+}
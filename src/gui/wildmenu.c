@@ -5,8 +5,13 @@
 
 #include "gui_private.h"
 
+/* The strings of the items are stored one after the other in a single block,
+ * which is kept when the wildmenu is hidden */
 struct wildmenu {
 	struct popupmenu pop;
+	char *strings;
+	char *next; /**< Where the string of the next item goes, in @p strings */
+	size_t reserved; /**< Size in bytes of @p strings */
 };
 static_assert(offsetof(struct wildmenu, pop) == 0, "popupmenu must be the first element");
 
@@ -18,7 +23,7 @@ static Evas_Object *wildmenu_resuable_content_get(void *const data, Evas_Object
 						  const char *const part EINA_UNUSED,
 						  Evas_Object *old)
 {
-	Eina_Stringshare *const item = data;
+	const char *const item = data;
 	struct wildmenu *const menu = evas_object_data_get(obj, "wildmenu");
 	const struct popupmenu *const pop = &menu->pop;
 	old = popupmenu_item_use(pop, obj, old);
@@ -30,16 +35,37 @@ static Evas_Object *wildmenu_resuable_content_get(void *const data, Evas_Object
 	return old;
 }
 
-static void wildmenu_item_del(void *const data, Evas_Object *const obj EINA_UNUSED)
+Eina_Bool gui_wildmenu_reserve(struct gui *const gui, const unsigned int count, const size_t bytes)
 {
-	Eina_Stringshare *const item = data;
-	eina_stringshare_del(item);
+	struct wildmenu *const wm = gui->wildmenu;
+
+	/* The genlist must not refer to the strings anymore */
+	popupmenu_clear(&wm->pop);
+
+	const size_t size = MAX(bytes + count, 1u); /* NUL-terminated */
+	if (size > wm->reserved) {
+		char *const strings = malloc(size);
+		if (EINA_UNLIKELY(!strings)) {
+			CRI("Failed to allocate memory (%zu bytes)", size);
+			return EINA_FALSE;
+		}
+		free(wm->strings);
+		wm->strings = strings;
+		wm->reserved = size;
+	}
+	wm->next = wm->strings;
+	return EINA_TRUE;
 }
 
-void gui_wildmenu_append(struct gui *const gui, Eina_Stringshare *const item)
+void gui_wildmenu_append(struct gui *const gui, const char *const item, const uint32_t size)
 {
 	struct wildmenu *const wm = gui->wildmenu;
-	popupmenu_append(&wm->pop, (void *)item);
+	char *const str = wm->next;
+
+	memcpy(str, item, size);
+	str[size] = '\0';
+	wm->next += size + 1u;
+	popupmenu_append(&wm->pop, str);
 }
 
 static void wildmenu_resize(struct popupmenu *const pop)
@@ -92,6 +118,7 @@ struct wildmenu *gui_wildmenu_add(struct gui *const gui)
 void gui_wildmenu_del(struct wildmenu *const wm)
 {
 	popupmenu_del(&wm->pop);
+	free(wm->strings);
 	free(wm);
 }
 
@@ -109,8 +136,8 @@ Eina_Bool gui_wildmenu_init(void)
 		return EINA_FALSE;
 	}
 	_wildmenu_itc->item_style = "full";
+	/* Items belong to the wildmenu, not to the genlist */
 	_wildmenu_itc->func.reusable_content_get = &wildmenu_resuable_content_get;
-	_wildmenu_itc->func.del = &wildmenu_item_del;
 	return EINA_TRUE;
 }
 
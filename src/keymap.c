@@ -54,8 +54,8 @@ static const struct kv_keymap _map[] = {
 	KM_IDENT("F32"),
 	KM_IDENT("F33"),
 	KM_IDENT("F34"),
-	KM_IDENT("F34"),
 	KM_IDENT("F35"),
+	KM_IDENT("F36"),
 	KM_IDENT("F37"),
 	KM_IDENT("Home"),
 	KM_IDENT("End"),
@@ -70,41 +70,47 @@ static const struct kv_keymap _map[] = {
 	KM("backslash", "Bslash"),
 };
 
-static Eina_Hash *_keymap = NULL;
+/* Keys are looked up on each key press, in a table indexed by a perfect hash
+ * of their names: the seed was chosen so that no two keys of _map share a
+ * slot. A lookup is then a hash and a single string comparison, and never
+ * allocates. keymap_init() checks the hash is still perfect, so a new key
+ * that collides is caught. Pick another seed in this case. */
+#define KEYMAP_TABLE_SIZE 128u
+#define KEYMAP_HASH_SEED 30u
 
-Eina_Bool keymap_init(void)
+static const struct kv_keymap *_table[KEYMAP_TABLE_SIZE];
+
+static inline unsigned int _hash(const char *key)
 {
-	/* First, create the hash table that wil hold the keymap */
-	_keymap = eina_hash_string_superfast_new(NULL);
-	if (EINA_UNLIKELY(!_keymap)) {
-		CRI("Failed to create hash table");
-		goto fail;
-	}
+	uint32_t h = KEYMAP_HASH_SEED;
+	for (; *key != '\0'; key++)
+		h = h * 33u + (unsigned char)*key;
+	return (h ^ (h >> 7)) & (KEYMAP_TABLE_SIZE - 1u);
+}
 
-	/* Fill the hash table with keys as litteral strings and values as
-	 * stringshares */
+Eina_Bool keymap_init(void)
+{
+	memset(_table, 0, sizeof(_table));
 	for (unsigned int i = 0; i < EINA_C_ARRAY_LENGTH(_map); i++) {
 		const struct kv_keymap *const kv = &(_map[i]);
-		if (EINA_UNLIKELY(!eina_hash_add(_keymap, kv->key, &kv->keymap))) {
-			CRI("Failed to add keymap entry '%s'", kv->key);
-			goto fail;
+		const unsigned int slot = _hash(kv->key);
+		if (EINA_UNLIKELY(_table[slot] != NULL)) {
+			CRI("Keys '%s' and '%s' collide. Change KEYMAP_HASH_SEED.",
+			    _table[slot]->key, kv->key);
+			return EINA_FALSE;
 		}
+		_table[slot] = kv;
 	}
-
 	return EINA_TRUE;
-
-fail:
-	if (_keymap)
-		eina_hash_free(_keymap);
-	return EINA_FALSE;
 }
 
 void keymap_shutdown(void)
 {
-	eina_hash_free(_keymap);
+	memset(_table, 0, sizeof(_table));
 }
 
 const struct keymap *keymap_get(const char *input)
 {
-	return eina_hash_find(_keymap, input);
+	const struct kv_keymap *const kv = _table[_hash(input)];
+	return (kv && (!strcmp(kv->key, input))) ? &kv->keymap : NULL;
 }
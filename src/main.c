@@ -9,6 +9,9 @@
 #include <eovim/termview.h>
 #include <eovim/main.h>
 #include <eovim/log.h>
+#include <eovim/profile.h>
+#include <eovim/nvim_cache.h>
+#include <eovim/font_cache.h>
 
 #include <Ecore_Getopt.h>
 
@@ -29,12 +32,15 @@ static const struct module _modules[] = {
 		.name = #name_, .init = &name_##_init, .shutdown = &name_##_shutdown               \
 	}
 
-	MODULE(keymap),	      MODULE(nvim_api),	      MODULE(nvim_request), MODULE(nvim_event),
-	MODULE(gui_wildmenu), MODULE(gui_completion), MODULE(termview),
+	MODULE(profile),      MODULE(keymap),	      MODULE(nvim_api),	    MODULE(nvim_request),
+	MODULE(nvim_event),   MODULE(gui_wildmenu), MODULE(gui_completion), MODULE(termview),
+	MODULE(nvim_cache),   MODULE(font_cache),
 
 #undef MODULE
 };
 
+static const char *const _renderers[] = { "textblock", "textgrid", NULL };
+
 static const Ecore_Getopt options_desc = {
 	"eovim",
 	"%prog [options] [file...]",
@@ -48,6 +54,21 @@ static const Ecore_Getopt options_desc = {
 	  ECORE_GETOPT_STORE_STR('t', "theme", "Path to the Edje theme"),
 	  ECORE_GETOPT_STORE_TRUE('M', "maximized", "Start eovim in a maximized window"),
 	  ECORE_GETOPT_STORE_TRUE('F', "fullscreen", "Start eovim in a fullscreen window"),
+	  ECORE_GETOPT_STORE_TRUE('\0', "profile",
+				  "Time the redraw pipeline, and print statistics when exiting"),
+	  ECORE_GETOPT_CHOICE('\0', "renderer",
+			      "Evas object that renders the grids. The textgrid is faster, "
+			      "but does not support ligatures",
+			      _renderers),
+	  ECORE_GETOPT_STORE_STR('\0', "record",
+				 "Record everything neovim sends in a file, "
+				 "so it can be replayed by eovim-bench"),
+	  ECORE_GETOPT_STORE_TRUE('\0', "io-thread",
+				  "Read what neovim sends in a dedicated thread, which cuts it "
+				  "into messages"),
+	  ECORE_GETOPT_STORE_STR('\0', "server",
+				 "Attach to the neovim listening at ADDR (a Unix socket, or HOST:PORT) "
+				 "instead of spawning one"),
 	  ECORE_GETOPT_CALLBACK_ARGS(
 		  'g', "geometry",
 		  "Set the initial dimensions of the window (e.g. 120x40 for a 120x40 cells window)",
@@ -110,6 +131,8 @@ EAPI_MAIN int elm_main(int argc, char **argv)
 		.theme = "default",
 		.fullscreen = EINA_FALSE,
 		.maximized = EINA_FALSE,
+		.profile = EINA_FALSE,
+		.renderer = "textblock",
 	};
 	Eina_Bool quit = EINA_FALSE;
 	Eina_Bool version = EINA_FALSE;
@@ -117,6 +140,11 @@ EAPI_MAIN int elm_main(int argc, char **argv)
 					ECORE_GETOPT_VALUE_STR(opts.theme),
 					ECORE_GETOPT_VALUE_BOOL(opts.maximized),
 					ECORE_GETOPT_VALUE_BOOL(opts.fullscreen),
+					ECORE_GETOPT_VALUE_BOOL(opts.profile),
+					ECORE_GETOPT_VALUE_STR(opts.renderer),
+					ECORE_GETOPT_VALUE_STR(opts.record),
+					ECORE_GETOPT_VALUE_BOOL(opts.io_thread),
+					ECORE_GETOPT_VALUE_STR(opts.server),
 					ECORE_GETOPT_VALUE_PTR_CAST(opts.geometry),
 					ECORE_GETOPT_VALUE_BOOL(version),
 					ECORE_GETOPT_VALUE_BOOL(quit),
@@ -187,6 +215,10 @@ EAPI_MAIN int elm_main(int argc, char **argv)
 		goto log_unregister;
 	}
 
+	/* The profiler must know whether it is enabled before it is initialized */
+	if (opts.profile)
+		profile_enable();
+
 	/*
 	 * Initialize all the different modules that compose Eovim.
 	 */
@@ -0,0 +1,315 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#include <eovim/msgpack_reader.h>
+
+#include <stdlib.h>
+#include <string.h>
+
+/* See https://github.com/msgpack/msgpack/blob/master/spec.md for the format */
+
+static inline uint64_t _be_read(const uint8_t *const ptr, const unsigned int bytes)
+{
+	uint64_t value = 0u;
+	for (unsigned int i = 0u; i < bytes; i++)
+		value = (value << 8) | ptr[i];
+	return value;
+}
+
+/* Read the length of @p bytes that follows the first byte of an object */
+static inline Eina_Bool _length_read(const struct mpack_reader *const reader,
+				     const unsigned int bytes, uint64_t *const length)
+{
+	if (EINA_UNLIKELY(reader->end - reader->ptr < 1 + (ptrdiff_t)bytes))
+		return EINA_FALSE;
+	*length = _be_read(reader->ptr + 1, bytes);
+	return EINA_TRUE;
+}
+
+Eina_Bool mpack_reader_array(struct mpack_reader *const reader, uint32_t *const size)
+{
+	if (EINA_UNLIKELY(reader->ptr >= reader->end))
+		return EINA_FALSE;
+
+	const uint8_t byte = *reader->ptr;
+	uint64_t length;
+	unsigned int bytes;
+	if ((byte & 0xf0) == 0x90) {
+		length = byte & 0x0f;
+		bytes = 0u;
+	} else if (byte == 0xdc) {
+		bytes = 2u;
+	} else if (byte == 0xdd) {
+		bytes = 4u;
+	} else
+		return EINA_FALSE;
+
+	if ((bytes != 0u) && (!_length_read(reader, bytes, &length)))
+		return EINA_FALSE;
+	reader->ptr += 1u + bytes;
+	*size = (uint32_t)length;
+	return EINA_TRUE;
+}
+
+Eina_Bool mpack_reader_int(struct mpack_reader *const reader, int64_t *const value)
+{
+	if (EINA_UNLIKELY(reader->ptr >= reader->end))
+		return EINA_FALSE;
+
+	const uint8_t byte = *reader->ptr;
+	if (byte <= 0x7f) { /* positive fixint */
+		*value = byte;
+		reader->ptr++;
+		return EINA_TRUE;
+	}
+	if (byte >= 0xe0) { /* negative fixint */
+		*value = (int8_t)byte;
+		reader->ptr++;
+		return EINA_TRUE;
+	}
+
+	/* uint 8 (0xcc) to uint 64 (0xcf), then int 8 (0xd0) to int 64 (0xd3) */
+	if ((byte < 0xcc) || (byte > 0xd3))
+		return EINA_FALSE;
+	const unsigned int bytes = 1u << ((byte - 0xcc) & 0x3);
+	uint64_t raw;
+	if (EINA_UNLIKELY(!_length_read(reader, bytes, &raw)))
+		return EINA_FALSE;
+
+	if (byte <= 0xcf)
+		*value = (int64_t)raw;
+	else {
+		/* Sign-extend the integer */
+		const unsigned int shift = 64u - 8u * bytes;
+		*value = (int64_t)(raw << shift) >> shift;
+	}
+	reader->ptr += 1u + bytes;
+	return EINA_TRUE;
+}
+
+Eina_Bool mpack_reader_str(struct mpack_reader *const reader, msgpack_object_str *const str)
+{
+	if (EINA_UNLIKELY(reader->ptr >= reader->end))
+		return EINA_FALSE;
+
+	const uint8_t byte = *reader->ptr;
+	uint64_t length;
+	unsigned int bytes;
+	if ((byte & 0xe0) == 0xa0) {
+		length = byte & 0x1f;
+		bytes = 0u;
+	} else if ((byte == 0xd9) || (byte == 0xc4)) {
+		bytes = 1u;
+	} else if ((byte == 0xda) || (byte == 0xc5)) {
+		bytes = 2u;
+	} else if ((byte == 0xdb) || (byte == 0xc6)) {
+		bytes = 4u;
+	} else
+		return EINA_FALSE;
+
+	if ((bytes != 0u) && (!_length_read(reader, bytes, &length)))
+		return EINA_FALSE;
+	const uint8_t *const data = reader->ptr + 1u + bytes;
+	if (EINA_UNLIKELY((uint64_t)(reader->end - data) < length))
+		return EINA_FALSE;
+	str->ptr = (const char *)data;
+	str->size = (uint32_t)length;
+	reader->ptr = data + length;
+	return EINA_TRUE;
+}
+
+Eina_Bool mpack_reader_skip(struct mpack_reader *const reader)
+{
+	struct mpack_scan scan;
+	mpack_scan_init(&scan);
+	if (mpack_scan(reader->ptr, (size_t)(reader->end - reader->ptr), &scan) != MPACK_SCAN_DONE)
+		return EINA_FALSE;
+	reader->ptr += scan.offset;
+	return EINA_TRUE;
+}
+
+enum mpack_scan_status mpack_scan(const void *const data, const size_t size,
+				  struct mpack_scan *const scan)
+{
+	/* Containers are not walked recursively: we just keep track of how many
+	 * objects remain to be skipped. The scan stops before an object that was
+	 * not entirely received, to be resumed from there. */
+	const uint8_t *const start = data;
+	const struct mpack_reader reader = { .ptr = start, .end = start + size };
+	const uint8_t *ptr = start + scan->offset;
+	uint64_t pending = scan->pending;
+	enum mpack_scan_status status = MPACK_SCAN_DONE;
+	while (pending) {
+		if (ptr >= reader.end) {
+			status = MPACK_SCAN_TRUNCATED;
+			break;
+		}
+
+		const uint8_t byte = *ptr;
+		uint64_t payload = 0u; /* Bytes after the header */
+		uint64_t children = 0u; /* Objects in the container */
+		unsigned int header = 0u; /* Bytes after the first one, holding the length */
+		Eina_Bool is_map = EINA_FALSE;
+
+		if ((byte <= 0x7f) || (byte >= 0xe0) || (byte == 0xc0) || (byte == 0xc2) ||
+		    (byte == 0xc3)) {
+			/* fixints, nil and booleans are a single byte */
+		} else if (byte <= 0x8f) {
+			children = byte & 0x0f;
+			is_map = EINA_TRUE;
+		} else if (byte <= 0x9f) {
+			children = byte & 0x0f;
+		} else if (byte <= 0xbf) {
+			payload = byte & 0x1f;
+		} else {
+			const struct mpack_reader at = { .ptr = ptr, .end = reader.end };
+			uint64_t length = 0u;
+			switch (byte) {
+			case 0xcc: /* uint 8 */
+			case 0xd0: /* int 8 */
+				payload = 1u;
+				break;
+			case 0xcd: /* uint 16 */
+			case 0xd1: /* int 16 */
+				payload = 2u;
+				break;
+			case 0xca: /* float 32 */
+			case 0xce: /* uint 32 */
+			case 0xd2: /* int 32 */
+				payload = 4u;
+				break;
+			case 0xcb: /* float 64 */
+			case 0xcf: /* uint 64 */
+			case 0xd3: /* int 64 */
+				payload = 8u;
+				break;
+			case 0xd4: /* fixext 1, 2, 4, 8 and 16, plus their type */
+			case 0xd5:
+			case 0xd6:
+			case 0xd7:
+			case 0xd8:
+				payload = 1u + (1u << (byte - 0xd4));
+				break;
+			case 0xc4: /* bin 8 */
+			case 0xd9: /* str 8 */
+				header = 1u;
+				break;
+			case 0xc5: /* bin 16 */
+			case 0xda: /* str 16 */
+			case 0xdc: /* array 16 */
+			case 0xde: /* map 16 */
+				header = 2u;
+				break;
+			case 0xc6: /* bin 32 */
+			case 0xdb: /* str 32 */
+			case 0xdd: /* array 32 */
+			case 0xdf: /* map 32 */
+				header = 4u;
+				break;
+			case 0xc7: /* ext 8, 16 and 32, plus their type */
+			case 0xc8:
+			case 0xc9:
+				header = 1u << (byte - 0xc7);
+				payload = 1u;
+				break;
+			default: /* 0xc1 is never used */
+				status = MPACK_SCAN_INVALID;
+				break;
+			}
+			if (EINA_UNLIKELY(status == MPACK_SCAN_INVALID))
+				break;
+
+			if (header != 0u) {
+				if (!_length_read(&at, header, &length)) {
+					status = MPACK_SCAN_TRUNCATED;
+					break;
+				}
+				if ((byte == 0xdc) || (byte == 0xdd))
+					children = length;
+				else if ((byte == 0xde) || (byte == 0xdf)) {
+					children = length;
+					is_map = EINA_TRUE;
+				} else
+					payload += length;
+			}
+		}
+
+		if ((uint64_t)(reader.end - ptr) <= header + payload) {
+			status = MPACK_SCAN_TRUNCATED;
+			break;
+		}
+
+		/* Maps hold a key and a value for each of their elements */
+		pending += (is_map ? 2u * children : children) - 1u;
+		ptr += 1u + header + payload;
+	}
+
+	/* The object the scan stopped at is scanned again on the next call */
+	scan->offset = (size_t)(ptr - start);
+	scan->pending = pending;
+	return status;
+}
+
+void mpack_stream_init(struct mpack_stream *const stream)
+{
+	stream->data = NULL;
+	stream->size = stream->used = stream->off = 0u;
+	mpack_scan_init(&stream->scan);
+}
+
+void mpack_stream_flush(struct mpack_stream *const stream)
+{
+	free(stream->data);
+	mpack_stream_init(stream);
+}
+
+char *mpack_stream_reserve(struct mpack_stream *const stream, const size_t size,
+			   size_t *const capacity)
+{
+	const size_t pending = stream->used - stream->off;
+	if (pending == 0u)
+		stream->used = stream->off = 0u;
+
+	/* The bytes of the messages already extracted are given back by moving
+	 * the pending ones to the start. This is only done once they take as
+	 * much room as the pending ones, so each byte is moved a bounded number
+	 * of times, however many pieces a message arrives in. */
+	if ((stream->size - stream->used < size) && (stream->off != 0u) &&
+	    (stream->off >= pending)) {
+		memmove(stream->data, stream->data + stream->off, pending);
+		stream->used = pending;
+		stream->off = 0u;
+	}
+	if (stream->size - stream->used < size) {
+		size_t alloc = (stream->size) ? stream->size * 2u : size;
+		if (alloc < pending + size)
+			alloc = pending + size;
+		char *const data = malloc(alloc);
+		if (EINA_UNLIKELY(!data))
+			return NULL;
+		if (pending)
+			memcpy(data, stream->data + stream->off, pending);
+		free(stream->data);
+		stream->data = data;
+		stream->size = alloc;
+		stream->used = pending;
+		stream->off = 0u;
+	}
+	*capacity = stream->size - stream->used;
+	return stream->data + stream->used;
+}
+
+enum mpack_scan_status mpack_stream_next(struct mpack_stream *const stream,
+					 const char **const msg, size_t *const size)
+{
+	const char *const start = stream->data + stream->off;
+	const enum mpack_scan_status status =
+		mpack_scan(start, stream->used - stream->off, &stream->scan);
+	if (status != MPACK_SCAN_DONE)
+		return status;
+
+	*msg = start;
+	*size = stream->scan.offset;
+	stream->off += stream->scan.offset;
+	mpack_scan_init(&stream->scan);
+	return MPACK_SCAN_DONE;
+}
@@ -7,9 +7,20 @@
 #include "eovim/nvim_event.h"
 #include "eovim/nvim_request.h"
 #include "eovim/nvim_helper.h"
+#include "eovim/nvim_io.h"
+#include "eovim/nvim_socket.h"
 #include "eovim/msgpack_helper.h"
+#include "eovim/msgpack_reader.h"
 #include "eovim/log.h"
 #include "eovim/main.h"
+#include "eovim/profile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* How many bytes we are willing to read at once from neovim */
+#define NVIM_READ_SIZE 65536u
 
 /*============================================================================*
  *                                 Private API                                *
@@ -126,19 +137,48 @@ fail:
 	return EINA_FALSE;
 }
 
-static Eina_Stringshare *_stringshare_extract(const msgpack_object *obj)
+static Eina_Bool _string_get(const msgpack_object *obj, msgpack_object_str *str)
 {
+	/* BIN strings and strings are handled the same way. We just read through
+	 * the bytes of the object, nothing is copied */
 	if (obj->type == MSGPACK_OBJECT_STR) {
-		const msgpack_object_str *const str = &(obj->via.str);
-		return eina_stringshare_add_length(str->ptr, str->size);
+		*str = obj->via.str;
+		return EINA_TRUE;
 	} else if (obj->type == MSGPACK_OBJECT_BIN) {
-		const msgpack_object_bin *const bin = &(obj->via.bin);
-		return eina_stringshare_add_length(bin->ptr, bin->size);
+		str->ptr = obj->via.bin.ptr;
+		str->size = obj->via.bin.size;
+		return EINA_TRUE;
 	} else {
 		ERR("Second argument in notification is expected to be a string "
 		    "(or BIN string), but it is of type 0x%x",
 		    obj->type);
-		return NULL;
+		return EINA_FALSE;
+	}
+}
+
+static void _command_dispatch(struct nvim *const nvim, const struct method *const meth,
+			      const msgpack_object *const arg)
+{
+	if (EINA_UNLIKELY(arg->type != MSGPACK_OBJECT_ARRAY)) {
+		CRI("Expected argument of type array. Got 0x%x.", arg->type);
+		return;
+	}
+	const msgpack_object_array *const cmd = &(arg->via.array);
+	if (EINA_UNLIKELY(cmd->size < 1)) {
+		CRI("Expected at least one argument. Got zero.");
+		return;
+	}
+	msgpack_object_str command;
+	if (EINA_UNLIKELY(!_string_get(&(cmd->ptr[0]), &command))) {
+		CRI("Failed to retrieve the command name");
+		return;
+	}
+	const Eina_Bool ok = nvim_event_method_dispatch(nvim, meth, &command, cmd);
+	if (EINA_UNLIKELY((!ok) && (eina_log_domain_level_get("eovim") >= EINA_LOG_LEVEL_WARN))) {
+		WRN("Command '%.*s' failed with input object:", (int)command.size, command.ptr);
+		fprintf(stderr, " -=> ");
+		msgpack_object_print(stderr, *arg);
+		fprintf(stderr, "\n");
 	}
 }
 
@@ -147,81 +187,128 @@ static Eina_Bool _handle_notification(struct nvim *nvim, const msgpack_object_ar
 	/*
     * 2nd argument must be a string (or bin string).
     * It contains the METHOD to be called for the notification.
-    * We decore the string as a stringshare, to feed it to our table of
-    * methods.
+    * It is directly looked up in our table of methods.
     */
-	Eina_Stringshare *const method = _stringshare_extract(&(args->ptr[1]));
-	if (EINA_UNLIKELY(!method)) {
-		CRI("Failed to create stringshare from Neovim method");
-		goto fail;
+	msgpack_object_str method;
+	if (EINA_UNLIKELY(!_string_get(&(args->ptr[1]), &method))) {
+		CRI("Failed to retrieve the Neovim method");
+		return EINA_FALSE;
 	}
-	DBG("Received notification '%s'", method);
+	DBG("Received notification '%.*s'", (int)method.size, method.ptr);
 
 	/*
     * 3rd argument must be an array of objects
     */
 	if (EINA_UNLIKELY(args->ptr[2].type != MSGPACK_OBJECT_ARRAY)) {
 		ERR("Third argument in notification is expected to be an array");
-		goto del_method;
+		return EINA_FALSE;
 	}
 	const msgpack_object_array *const args_arr = &(args->ptr[2].via.array);
 
 	/* Find the method handler */
-	const struct method *const meth = nvim_event_method_find(method);
+	const struct method *const meth = nvim_event_method_find(&method);
 	if (EINA_UNLIKELY(!meth)) {
-		goto del_method;
+		return EINA_FALSE;
 	}
 
+	PROFILE_START(batch_start);
+	PROFILE_BATCH_START(batch_allocations);
+
 	/*
     * Go through the notification's commands. There are formatted of the form
     * [ command_name, Args... ]
     * So we expect arguments to be arrays of at least one element.
     * command_name must be a string!
     */
-	for (unsigned int i = 0; i < args_arr->size; i++) {
-		const msgpack_object *const arg = &(args_arr->ptr[i]);
-		if (EINA_UNLIKELY(arg->type != MSGPACK_OBJECT_ARRAY)) {
-			CRI("Expected argument of type array. Got 0x%x.", arg->type);
-			continue; /* Try next element */
-		}
-		const msgpack_object_array *const cmd = &(arg->via.array);
-		if (EINA_UNLIKELY(cmd->size < 1)) {
-			CRI("Expected at least one argument. Got zero.");
-			continue; /* Try next element */
-		}
-		Eina_Stringshare *const command = _stringshare_extract(&(cmd->ptr[0]));
-		if (EINA_UNLIKELY(!command)) {
-			CRI("Failed to create stringshare from command object");
-			continue; /* Try next element */
+	for (unsigned int i = 0; i < args_arr->size; i++)
+		_command_dispatch(nvim, meth, &(args_arr->ptr[i]));
+
+	/* Notify we are done processing the batch of functions for this method */
+	nvim_event_method_batch_end(nvim, meth);
+	PROFILE_BATCH_STOP(batch_allocations);
+	PROFILE_STOP(nvim_event_method_name_get(meth), batch_start);
+	return EINA_TRUE;
+}
+
+/*
+ * Handle the redraw notification that starts at @p data, without unpacking it
+ * in a tree of msgpack objects first. The events that support it (grid_line)
+ * are decoded in place. The other ones are unpacked one at a time, and
+ * dispatched as usual. The events cannot be processed twice, so the whole
+ * message must have been received: @p size is its exact size.
+ *
+ * @return EINA_TRUE if the message was handled, EINA_FALSE if it is not a
+ *   redraw notification
+ */
+static Eina_Bool _handle_redraw_stream(struct nvim *const nvim, const char *const data,
+				       const size_t size)
+{
+	struct mpack_reader reader;
+	mpack_reader_init(&reader, data, size);
+	const uint8_t *const end = (const uint8_t *)data + size;
+
+	uint32_t count, batches;
+	t_int type;
+	msgpack_object_str method;
+	if ((!mpack_reader_array(&reader, &count)) || (count != 3u) ||
+	    (!mpack_reader_int(&reader, &type)) || (type != 2) ||
+	    (!mpack_reader_str(&reader, &method)) || (!_msgpack_str_is(&method, "redraw", 6u)) ||
+	    (!mpack_reader_array(&reader, &batches)))
+		return EINA_FALSE;
+
+	const struct method *const meth = nvim_event_method_find(&method);
+	if (EINA_UNLIKELY(!meth))
+		return EINA_FALSE;
+
+	PROFILE_START(batch_start);
+	PROFILE_BATCH_START(batch_allocations);
+	msgpack_unpacked unpacked;
+	msgpack_unpacked_init(&unpacked);
+	for (uint32_t i = 0u; i < batches; i++) {
+		const uint8_t *const at = reader.ptr;
+		uint32_t cmd_size;
+		msgpack_object_str command;
+		Eina_Bool streamed = EINA_FALSE;
+
+		if (mpack_reader_array(&reader, &cmd_size) && (cmd_size >= 1u) &&
+		    mpack_reader_str(&reader, &command)) {
+			const Eina_Bool ok = nvim_event_method_stream(nvim, meth, &command, &reader,
+								      cmd_size - 1u, &streamed);
+			if (streamed) {
+				if (EINA_UNLIKELY(!ok)) {
+					WRN("Command '%.*s' failed", (int)command.size, command.ptr);
+					reader.ptr = at;
+					mpack_reader_skip(&reader);
+				}
+				continue;
+			}
 		}
-		const Eina_Bool ok = nvim_event_method_dispatch(nvim, meth, command, cmd);
-		if (EINA_UNLIKELY((!ok) &&
-				  (eina_log_domain_level_get("eovim") >= EINA_LOG_LEVEL_WARN))) {
-			WRN("Command '%s' failed with input object:", command);
-			fprintf(stderr, " -=> ");
-			msgpack_object_print(stderr, *arg);
-			fprintf(stderr, "\n");
+
+		/* This command is not decoded in place: unpack it alone */
+		size_t off = 0u;
+		const msgpack_unpack_return ret = msgpack_unpack_next(
+			&unpacked, (const char *)at, (size_t)(end - at), &off);
+		if (EINA_UNLIKELY(ret != MSGPACK_UNPACK_SUCCESS)) {
+			ERR("Error while unpacking data from neovim (0x%x)", ret);
+			break;
 		}
-		eina_stringshare_del(command);
+		reader.ptr = at + off;
+		_command_dispatch(nvim, meth, &unpacked.data);
 	}
+	msgpack_unpacked_destroy(&unpacked);
 
-	/* Notify we are done processing the batch of functions for this method */
 	nvim_event_method_batch_end(nvim, meth);
-
-	eina_stringshare_del(method);
+	PROFILE_BATCH_STOP(batch_allocations);
+	PROFILE_STOP(nvim_event_method_name_get(meth), batch_start);
 	return EINA_TRUE;
-
-del_method:
-	eina_stringshare_del(method);
-fail:
-	return EINA_FALSE;
 }
 
 /*============================================================================*
  *                       Nvim Processes Events Handlers                       *
  *============================================================================*/
 
-static Eina_Bool _nvim_added_cb(void *const data, const int type EINA_UNUSED, void *const event)
+static Eina_Bool _nvim_added_cb(void *const data EINA_UNUSED, const int type EINA_UNUSED,
+			       void *const event)
 {
 	/* EFL versions 1.21 (and maybe 1.20 as well ??) have a bug. When coming out
     * of sleep/hibernation, a spurious event was sent, causing
@@ -235,8 +322,8 @@ static Eina_Bool _nvim_added_cb(void *const data, const int type EINA_UNUSED, vo
       * talk to neovim, and nobody else */
 		const char *const tag = ecore_exe_tag_get(info->exe);
 		if (tag && (0 == strcmp(tag, "neovim"))) {
+			/* We did not wait for this to attach: see nvim_new() */
 			INF("Nvim process with PID %i was created", ecore_exe_pid_get(info->exe));
-			nvim_attach(data);
 		}
 	}
 
@@ -261,87 +348,255 @@ static Eina_Bool _nvim_deleted_cb(void *data, int type EINA_UNUSED, void *event)
 	return ECORE_CALLBACK_PASS_ON;
 }
 
-static Eina_Bool _nvim_received_data_cb(void *data, int type EINA_UNUSED, void *event)
+void nvim_output_closed(struct nvim *const nvim)
 {
-	/* See https://github.com/msgpack-rpc/msgpack-rpc/blob/master/spec.md */
-	const Ecore_Exe_Event_Data *const info = event;
-	struct nvim *const nvim = data;
-	msgpack_unpacker *const unpacker = &nvim->unpacker;
-	const size_t recv_size = (size_t)info->size;
+	INF("Neovim closed its output stream");
+	if (!nvim->exe)
+		gui_del(&nvim->gui);
+}
 
-	DBG("Incoming data from PID %u (size %zu)", ecore_exe_pid_get(info->exe), recv_size);
+void nvim_record(struct nvim *nvim, const void *data, size_t size)
+{
+	/* A failed write stops the recording, rather than leaving a stream that
+	 * cannot be replayed faithfully */
+	if (nvim->record && EINA_UNLIKELY(fwrite(data, 1u, size, nvim->record) != size)) {
+		ERR("Failed to record %zu bytes: %s. Recording stopped", size, strerror(errno));
+		fclose(nvim->record);
+		nvim->record = NULL;
+	}
+}
 
-	/*
-    * We have received something from NeoVim. We now must deserialize this.
-    */
-	msgpack_unpacked result;
+void nvim_io_stats_update(struct nvim *nvim, size_t received, size_t copied)
+{
+	struct nvim_io_stats *const stats = &nvim->io_stats;
+	const double now = ecore_time_get();
+
+	stats->received += received;
+	stats->copied += copied;
+	PROFILE_COUNT(PROFILE_COUNTER_BYTES_RECEIVED, received);
+
+	/* Report the throughput roughly every second, and only while data is
+	 * flowing. We don't want a timer to wake us up when neovim is idle. */
+	const double elapsed = now - stats->since;
+	if (elapsed >= 1.0) {
+		DBG("Received %.0f B/s from neovim, %.0f B/s were copied",
+		    (double)stats->received / elapsed, (double)stats->copied / elapsed);
+		stats->received = 0;
+		stats->copied = 0;
+		stats->since = now;
+	}
+}
 
-	/* Resize the unpacking buffer if need be */
-	if (msgpack_unpacker_buffer_capacity(unpacker) < recv_size) {
-		const bool ret = msgpack_unpacker_reserve_buffer(unpacker, recv_size);
-		if (!ret) {
-			ERR("Memory reallocation of %zu bytes failed", recv_size);
-			goto end;
-		}
+Eina_Bool nvim_message_check(const msgpack_object *const obj)
+{
+	if (EINA_UNLIKELY(obj->type != MSGPACK_OBJECT_ARRAY)) {
+		ERR("Unexpected msgpack type 0x%x", obj->type);
+		return EINA_FALSE;
 	}
-	/* This seems to be required, but that's plain inefficiency */
-	memcpy(msgpack_unpacker_buffer(unpacker), info->data, recv_size);
-	msgpack_unpacker_buffer_consumed(unpacker, recv_size);
 
-	msgpack_unpacked_init(&result);
-	for (;;) {
-		const msgpack_unpack_return ret = msgpack_unpacker_next(unpacker, &result);
-		if (ret == MSGPACK_UNPACK_CONTINUE) {
-			break;
-		} else if (EINA_UNLIKELY(ret != MSGPACK_UNPACK_SUCCESS)) {
-			ERR("Error while unpacking data from neovim (0x%x)", ret);
-			goto end_unpack;
-		}
-		const msgpack_object *const obj = &(result.data);
+	const msgpack_object_array *const args = &(obj->via.array);
+	const unsigned int response_args_count = 4u;
+	const unsigned int notif_args_count = 3u;
+	if ((args->size != response_args_count) && (args->size != notif_args_count)) {
+		ERR("Unexpected count of arguments: %u.", args->size);
+		return EINA_FALSE;
+	}
+
+	if (EINA_UNLIKELY(args->ptr[0].type != MSGPACK_OBJECT_POSITIVE_INTEGER)) {
+		ERR("First argument in response is expected to be an integer");
+		return EINA_FALSE;
+	}
+	if (EINA_UNLIKELY(args->ptr[0].via.u64 > 2u)) {
+		ERR("Invalid message identifier %" PRIu64, args->ptr[0].via.u64);
+		return EINA_FALSE;
+	}
+	return EINA_TRUE;
+}
+
+void nvim_message_handle(struct nvim *const nvim, const msgpack_object *const obj)
+{
+	const msgpack_object_array *const args = &(obj->via.array);
+	switch (args->ptr[0].via.u64) {
+	case 0: /* msgpack-rpc request */
+		_handle_request(nvim, args);
+		break;
+
+	case 1: /* msgpack-rpc response */
+		_handle_request_response(nvim, args);
+		break;
+
+	default: /* msgpack-rpc notification */
+		_handle_notification(nvim, args);
+		break;
+	}
+}
+
+/*
+ * Process the message of @p size bytes at @p msg, which was entirely received.
+ * Redraw notifications are read in place. The other messages are unpacked in
+ * trees of objects, in @p result.
+ */
+static Eina_Bool _message_bytes_handle(struct nvim *const nvim, const char *const msg,
+				       const size_t size, msgpack_unpacked *const result)
+{
+	/* See https://github.com/msgpack-rpc/msgpack-rpc/blob/master/spec.md */
+	if (_handle_redraw_stream(nvim, msg, size))
+		return EINA_TRUE;
+
+	PROFILE_START(unpack_start);
+	PROFILE_SCOPE_ENTER(unpack_scope, PROFILE_SCOPE_UNPACK);
+	size_t off = 0u;
+	const msgpack_unpack_return ret = msgpack_unpack_next(result, msg, size, &off);
+	PROFILE_SCOPE_LEAVE(unpack_scope);
+	PROFILE_STOP("unpack", unpack_start);
+	if (EINA_UNLIKELY(ret != MSGPACK_UNPACK_SUCCESS)) {
+		ERR("Error while unpacking data from neovim (0x%x)", ret);
+		return EINA_FALSE;
+	}
+	const msgpack_object *const obj = &(result->data);
 
 #if 0 /* Uncomment to roughly dump the received messages */
         msgpack_object_print(stderr, *obj);
         fprintf(stderr, "\n--------\n");
 #endif
 
-		if (EINA_UNLIKELY(obj->type != MSGPACK_OBJECT_ARRAY)) {
-			ERR("Unexpected msgpack type 0x%x", obj->type);
-			goto end_unpack;
-		}
+	if (EINA_LIKELY(nvim_message_check(obj)))
+		nvim_message_handle(nvim, obj);
+	return EINA_TRUE;
+}
 
-		const msgpack_object_array *const args = &(obj->via.array);
-		const unsigned int response_args_count = 4u;
-		const unsigned int notif_args_count = 3u;
-		if ((args->size != response_args_count) && (args->size != notif_args_count)) {
-			ERR("Unexpected count of arguments: %u.", args->size);
-			goto end_unpack;
-		}
+Eina_Bool nvim_messages_handle(struct nvim *const nvim, const char *const data, const size_t size)
+{
+	struct mpack_reader reader;
+	msgpack_unpacked result;
+	Eina_Bool ok = EINA_TRUE;
 
-		if (EINA_UNLIKELY(args->ptr[0].type != MSGPACK_OBJECT_POSITIVE_INTEGER)) {
-			ERR("First argument in response is expected to be an integer");
-			goto end_unpack;
-		}
-		switch (args->ptr[0].via.u64) {
-		case 0: /* msgpack-rpc request */
-			_handle_request(nvim, args);
+	mpack_reader_init(&reader, data, size);
+	msgpack_unpacked_init(&result);
+	while (ok && (reader.ptr < reader.end)) {
+		const uint8_t *const msg = reader.ptr;
+		if (EINA_UNLIKELY(!mpack_reader_skip(&reader))) {
+			ERR("Truncated message received from neovim");
+			ok = EINA_FALSE;
 			break;
+		}
+		ok = _message_bytes_handle(nvim, (const char *)msg, (size_t)(reader.ptr - msg),
+					   &result);
+	}
+	msgpack_unpacked_destroy(&result);
+	return ok;
+}
 
-		case 1: /* msgpack-rpc response */
-			_handle_request_response(nvim, args);
-			break;
+/*
+ * Process the messages received from neovim in its stream
+ *
+ * @return EINA_FALSE if neovim sent data that is not msgpack. The stream
+ *   cannot be recovered from there.
+ */
+static Eina_Bool _nvim_unpack(struct nvim *nvim)
+{
+	msgpack_unpacked result;
+	Eina_Bool ok = EINA_TRUE;
 
-		case 2: /* msgpack-rpc notification */
-			_handle_notification(nvim, args);
+	msgpack_unpacked_init(&result);
+	while (ok) {
+		/* Messages are cut in the stream first. Incomplete ones are left
+		 * there until the rest of them arrives, and their scan resumes
+		 * where it stopped. */
+		const char *msg;
+		size_t size;
+		const enum mpack_scan_status status = mpack_stream_next(&nvim->stream, &msg, &size);
+		if (status == MPACK_SCAN_TRUNCATED)
 			break;
+		if (EINA_UNLIKELY(status == MPACK_SCAN_INVALID)) {
+			ERR("Invalid data received from neovim, at byte %zu of a message",
+			    nvim->stream.scan.offset);
+			ok = EINA_FALSE;
+			break;
+		}
+		ok = _message_bytes_handle(nvim, msg, size, &result);
+	}
+	msgpack_unpacked_destroy(&result);
+	return ok;
+}
 
-		default:
-			ERR("Invalid message identifier %" PRIu64, args->ptr[0].via.u64);
-			goto end_unpack;
+/* Make room in the stream for @p size bytes to be received */
+static char *_nvim_stream_reserve(struct nvim *const nvim, const size_t size,
+				  size_t *const capacity)
+{
+	PROFILE_SCOPE_ENTER(scope, PROFILE_SCOPE_UNPACK);
+	char *const buf = mpack_stream_reserve(&nvim->stream, size, capacity);
+	PROFILE_SCOPE_LEAVE(scope);
+	if (EINA_UNLIKELY(!buf))
+		ERR("Memory reallocation of %zu bytes failed", size);
+	return buf;
+}
+
+static Eina_Bool _nvim_pipe_read_cb(void *data, Ecore_Fd_Handler *handler EINA_UNUSED)
+{
+	struct nvim *const nvim = data;
+
+	/* Read directly in the stream, so the messages can be decoded in place
+	 * without we having to copy the data one more time. We read until the
+	 * pipe is drained (the read end is non-blocking), processing the messages
+	 * as they come, so the stream does not grow unbounded. */
+	for (;;) {
+		size_t capacity;
+		char *const buf = _nvim_stream_reserve(nvim, NVIM_READ_SIZE, &capacity);
+		if (EINA_UNLIKELY(!buf))
+			break;
+		const ssize_t len = read(nvim->read_fd, buf, capacity);
+		if (len > 0) {
+			DBG("Incoming data from neovim (size %zd)", len);
+			nvim_record(nvim, buf, (size_t)len);
+			mpack_stream_consumed(&nvim->stream, (size_t)len);
+			nvim_io_stats_update(nvim, (size_t)len, 0u);
+			if (EINA_UNLIKELY(!_nvim_unpack(nvim))) {
+				nvim->read_handler = NULL;
+				gui_die(&nvim->gui, "Neovim sent invalid data. "
+						    "Eovim cannot continue its execution");
+				return ECORE_CALLBACK_CANCEL;
+			}
+			if ((size_t)len < capacity)
+				break; /* Drained */
+		} else if (len == 0) {
+			nvim->read_handler = NULL;
+			nvim_output_closed(nvim);
+			return ECORE_CALLBACK_CANCEL;
+		} else if (errno == EINTR) {
+			continue;
+		} else {
+			if ((errno != EAGAIN) && (errno != EWOULDBLOCK))
+				ERR("Failed to read from neovim: %s", strerror(errno));
+			break;
 		}
-	} /* End of message unpacking */
+	}
+	return ECORE_CALLBACK_RENEW;
+}
 
-end_unpack:
-	msgpack_unpacked_destroy(&result);
+static Eina_Bool _nvim_received_data_cb(void *data, int type EINA_UNUSED, void *event)
+{
+	const Ecore_Exe_Event_Data *const info = event;
+	struct nvim *const nvim = data;
+	const size_t recv_size = (size_t)info->size;
+
+	DBG("Incoming data from PID %u (size %zu)", ecore_exe_pid_get(info->exe), recv_size);
+
+	/* This is the fallback path, used when we failed to setup our own pipe
+	 * to read neovim's output. Ecore_Exe already read the data in its own
+	 * buffer, so we have to copy it in the stream. */
+	size_t capacity;
+	char *const buf = _nvim_stream_reserve(nvim, recv_size, &capacity);
+	if (EINA_UNLIKELY(!buf))
+		goto end;
+	nvim_record(nvim, info->data, recv_size);
+	memcpy(buf, info->data, recv_size);
+	mpack_stream_consumed(&nvim->stream, recv_size);
+	nvim_io_stats_update(nvim, recv_size, recv_size);
+
+	if (EINA_UNLIKELY(!_nvim_unpack(nvim)))
+		gui_die(&nvim->gui,
+			"Neovim sent invalid data. Eovim cannot continue its execution");
 end:
 	return ECORE_CALLBACK_PASS_ON;
 }
@@ -399,6 +654,56 @@ fail:
 	return EINA_FALSE;
 }
 
+static Eina_Bool _nvim_pipe_new(int fds[2])
+{
+	if (EINA_UNLIKELY(pipe(fds) != 0)) {
+		ERR("Failed to create pipe: %s", strerror(errno));
+		return EINA_FALSE;
+	}
+
+	/* The read end is ours only, and shall never block the main loop. The
+	 * write end is only inherited by neovim as its standard output (see
+	 * _nvim_exe_run()). */
+	const int flags = fcntl(fds[0], F_GETFL);
+	if (EINA_UNLIKELY((flags < 0) || (fcntl(fds[0], F_SETFL, flags | O_NONBLOCK) != 0) ||
+			  (fcntl(fds[0], F_SETFD, FD_CLOEXEC) != 0) ||
+			  (fcntl(fds[1], F_SETFD, FD_CLOEXEC) != 0))) {
+		ERR("Failed to configure pipe: %s", strerror(errno));
+		close(fds[0]);
+		close(fds[1]);
+		fds[0] = fds[1] = -1;
+		return EINA_FALSE;
+	}
+	return EINA_TRUE;
+}
+
+/* Ecore_Exe may close all the descriptors above stderr in the child, so the
+ * write end @p out_fd of our pipe cannot be handed to neovim as is. It is
+ * made our standard output while Ecore_Exe forks, so neovim inherits it as
+ * its own. */
+static Ecore_Exe *_nvim_exe_run(const char *const cmdline, const Ecore_Exe_Flags flags,
+				const int out_fd, void *const data)
+{
+	fflush(stdout);
+	const int saved = fcntl(STDOUT_FILENO, F_DUPFD_CLOEXEC, 3);
+	if (EINA_UNLIKELY((saved < 0) || (dup2(out_fd, STDOUT_FILENO) < 0))) {
+		ERR("Failed to hand our pipe to neovim: %s", strerror(errno));
+		if (saved >= 0)
+			close(saved);
+		return NULL;
+	}
+	Ecore_Exe *const exe = ecore_exe_pipe_run(cmdline, flags, data);
+	if (EINA_UNLIKELY(dup2(saved, STDOUT_FILENO) < 0))
+		ERR("Failed to restore the standard output: %s", strerror(errno));
+	close(saved);
+	return exe;
+}
+
+static Eina_Bool _nvim_exe_send(void *const data, const void *const bytes, const size_t size)
+{
+	return ecore_exe_send(data, bytes, (int)size);
+}
+
 static void _nvim_event_handlers_del(struct nvim *nvim)
 {
 	for (size_t i = 0; i < EINA_C_ARRAY_LENGTH(nvim->event_handlers); i++)
@@ -419,7 +724,12 @@ struct nvim *nvim_new(const struct options *opts, const char *const args[])
 {
 	EINA_SAFETY_ON_NULL_RETURN_VAL(opts, NULL);
 
+	const uint64_t start = profile_time_get();
 	Eina_Bool ok;
+	const Eina_Bool replay = (args == NULL);
+	const Eina_Bool spawn = (!replay) && (!opts->server);
+	if (opts->server && (!replay) && (*args != NULL))
+		WRN("The arguments are not forwarded to the neovim at '%s'", opts->server);
 
 	/* Forge the command-line for the nvim program. We manually enforce
     * --embed and --headless, because we are the gui client, and forward all
@@ -432,8 +742,23 @@ struct nvim *nvim_new(const struct options *opts, const char *const args[])
 		goto fail;
 	}
 	ok = eina_strbuf_append_printf(cmdline, "\"%s\" --embed", opts->nvim);
-	for (const char *arg = *args; arg != NULL; arg = *(++args))
+	for (const char *arg = (spawn) ? *args : NULL; arg != NULL; arg = *(++args))
 		ok &= eina_strbuf_append_printf(cmdline, " \"%s\"", arg);
+
+	/* We read neovim's standard output ourselves, directly in the msgpack
+	 * unpacking buffer. Relying on ECORE_EXE_EVENT_DATA would force us to
+	 * copy every byte neovim sends us. Neovim writes its output in a pipe we
+	 * own. If we cannot create it, we fallback to the pipe of Ecore_Exe. */
+	int out_fds[2] = { -1, -1 };
+	Ecore_Exe_Flags exe_flags = ECORE_EXE_PIPE_WRITE | ECORE_EXE_PIPE_ERROR |
+				    ECORE_EXE_TERM_WITH_PARENT;
+	if (!spawn) {
+		/* Nothing to read from: the stream is replayed by the caller, or
+		 * read from the socket */
+	} else if (!_nvim_pipe_new(out_fds)) {
+		WRN("Failed to create the pipe to read from neovim. Falling back to Ecore_Exe");
+		exe_flags |= ECORE_EXE_PIPE_READ;
+	}
 	if (EINA_UNLIKELY(!ok)) {
 		CRI("Failed to correctly format the command line");
 		goto del_strbuf;
@@ -446,6 +771,9 @@ struct nvim *nvim_new(const struct options *opts, const char *const args[])
 		goto del_strbuf;
 	}
 	nvim->opts = opts;
+	nvim->startup.start = start;
+	nvim->read_fd = out_fds[0];
+	nvim->io_stats.since = ecore_time_get();
 
 	/* Configure the event handlers */
 	if (EINA_UNLIKELY(!_nvim_event_handlers_add(nvim))) {
@@ -460,7 +788,7 @@ struct nvim *nvim_new(const struct options *opts, const char *const args[])
 	/* Initialze msgpack for RPC */
 	msgpack_sbuffer_init(&nvim->sbuffer);
 	msgpack_packer_init(&nvim->packer, &nvim->sbuffer, msgpack_sbuffer_write);
-	msgpack_unpacker_init(&nvim->unpacker, 2048);
+	mpack_stream_init(&nvim->stream);
 
 	nvim->modes = eina_hash_stringshared_new(EINA_FREE_CB(&nvim_mode_free));
 	if (EINA_UNLIKELY(!nvim->modes)) {
@@ -486,17 +814,75 @@ struct nvim *nvim_new(const struct options *opts, const char *const args[])
 		goto del_cmdline_styles;
 	}
 
-	/* Create the neovim process */
-	nvim->exe = ecore_exe_pipe_run(eina_strbuf_string_get(cmdline),
-				       ECORE_EXE_PIPE_READ | ECORE_EXE_PIPE_WRITE |
-					       ECORE_EXE_PIPE_ERROR | ECORE_EXE_TERM_WITH_PARENT,
-				       nvim);
-	if (EINA_UNLIKELY(!nvim->exe)) {
-		CRI("Failed to execute nvim instance");
+	nvim->input.pending = eina_strbuf_new();
+	if (EINA_UNLIKELY(!nvim->input.pending)) {
+		CRI("Failed to create strbuf");
 		goto del_hl_group_styles;
 	}
-	ecore_exe_tag_set(nvim->exe, "neovim");
-	DBG("Running %s", eina_strbuf_string_get(cmdline));
+
+	if (opts->record) {
+		nvim->record = fopen(opts->record, "wb");
+		if (EINA_UNLIKELY(!nvim->record)) {
+			CRI("Failed to open '%s' for recording: %s", opts->record, strerror(errno));
+			goto del_input;
+		}
+	}
+
+	/* Create the neovim process, or connect to it */
+	if (spawn) {
+		const char *const line = eina_strbuf_string_get(cmdline);
+		if (out_fds[1] >= 0) {
+			nvim->exe = _nvim_exe_run(line, exe_flags, out_fds[1], nvim);
+			if (EINA_UNLIKELY(!nvim->exe)) {
+				WRN("Falling back to the pipe of Ecore_Exe");
+				close(out_fds[0]);
+				close(out_fds[1]);
+				out_fds[0] = out_fds[1] = nvim->read_fd = -1;
+				exe_flags |= ECORE_EXE_PIPE_READ;
+			}
+		}
+		if (!nvim->exe)
+			nvim->exe = ecore_exe_pipe_run(line, exe_flags, nvim);
+		if (EINA_UNLIKELY(!nvim->exe)) {
+			CRI("Failed to execute nvim instance");
+			goto del_record;
+		}
+		ecore_exe_tag_set(nvim->exe, "neovim");
+		DBG("Running %s", eina_strbuf_string_get(cmdline));
+		nvim->transport.send = &_nvim_exe_send;
+		nvim->transport.data = nvim->exe;
+		nvim->startup.spawned = profile_time_get();
+	} else if (!replay) {
+		nvim->read_fd = nvim_socket_connect(opts->server, &nvim->transport);
+		if (EINA_UNLIKELY(nvim->read_fd < 0)) {
+			CRI("Failed to attach to the neovim at '%s'", opts->server);
+			goto del_record;
+		}
+		nvim->startup.spawned = profile_time_get();
+	}
+
+	/* Only neovim shall write in our pipe now */
+	if (out_fds[1] >= 0) {
+		close(out_fds[1]);
+		out_fds[1] = -1;
+	}
+	if (nvim->read_fd >= 0) {
+		if (opts->io_thread) {
+			nvim->io = nvim_io_new(nvim, nvim->read_fd);
+			if (EINA_UNLIKELY(!nvim->io))
+				WRN("Failed to start the I/O thread. Reading on the main loop.");
+		}
+		if (!nvim->io) {
+			nvim->read_handler = ecore_main_fd_handler_add(
+				nvim->read_fd, ECORE_FD_READ, _nvim_pipe_read_cb, nvim, NULL, NULL);
+			if (EINA_UNLIKELY(!nvim->read_handler)) {
+				CRI("Failed to listen to neovim's output");
+				goto del_process;
+			}
+		}
+	} else if (spawn && opts->io_thread) {
+		WRN("The I/O thread needs our own pipe. Reading on the main loop.");
+	}
 
 	/* Create the GUI window */
 	if (EINA_UNLIKELY(!gui_add(&nvim->gui, nvim))) {
@@ -504,11 +890,31 @@ struct nvim *nvim_new(const struct options *opts, const char *const args[])
 		goto del_process;
 	}
 
+	/* Don't wait for the process to be reported as started to talk to it.
+	 * The attach requests are queued right away: they are written as soon
+	 * as the main loop runs, and neovim has been booting in the meantime. */
+	if (!replay)
+		nvim_attach(nvim);
+
 	eina_strbuf_free(cmdline);
 	return nvim;
 
 del_process:
-	ecore_exe_kill(nvim->exe);
+	if (nvim->io)
+		nvim_io_free(nvim->io);
+	if (nvim->read_handler)
+		ecore_main_fd_handler_del(nvim->read_handler);
+	if (nvim->exe)
+		ecore_exe_kill(nvim->exe);
+	if (nvim->transport.free)
+		nvim->transport.free(nvim->transport.data);
+	if ((!spawn) && (nvim->read_fd >= 0))
+		close(nvim->read_fd); /* The socket */
+del_record:
+	if (nvim->record)
+		fclose(nvim->record);
+del_input:
+	eina_strbuf_free(nvim->input.pending);
 del_hl_group_styles:
 	eina_hash_free(nvim->hl_groups);
 del_cmdline_styles:
@@ -523,6 +929,9 @@ del_mem:
 	free(nvim);
 del_strbuf:
 	eina_strbuf_free(cmdline);
+	for (size_t i = 0; i < EINA_C_ARRAY_LENGTH(out_fds); i++)
+		if (out_fds[i] >= 0)
+			close(out_fds[i]);
 fail:
 	return NULL;
 }
@@ -530,21 +939,74 @@ fail:
 void nvim_free(struct nvim *const nvim)
 {
 	if (nvim) {
+		/* Don't lose what was about to be sent (e.g. :quitall!) */
+		if (nvim->flush_handler) {
+			ecore_idle_enterer_del(nvim->flush_handler);
+			nvim->flush_handler = NULL;
+			nvim_api_input_pack(nvim);
+			nvim_flush(nvim);
+		}
+		if (nvim->io)
+			nvim_io_free(nvim->io);
 		_nvim_event_handlers_del(nvim);
+		nvim_api_requests_free(nvim);
+		if (nvim->read_handler)
+			ecore_main_fd_handler_del(nvim->read_handler);
+		if (nvim->transport.free)
+			nvim->transport.free(nvim->transport.data);
+		if (nvim->read_fd >= 0)
+			close(nvim->read_fd);
+		if (nvim->record)
+			fclose(nvim->record);
 		msgpack_sbuffer_destroy(&nvim->sbuffer);
-		msgpack_unpacker_destroy(&nvim->unpacker);
+		mpack_stream_flush(&nvim->stream);
+		arena_free(&nvim->arena);
 		eina_hash_free(nvim->hl_groups);
 		eina_hash_free(nvim->cmdline_styles);
 		eina_hash_free(nvim->kind_styles);
 		eina_hash_free(nvim->modes);
+		eina_strbuf_free(nvim->input.pending);
 		free(nvim);
 	}
 }
 
+static Eina_Bool _nvim_flush_cb(void *const data)
+{
+	struct nvim *const nvim = data;
+	nvim->flush_handler = NULL;
+
+	nvim_api_input_pack(nvim);
+	if (nvim->sbuffer.size != 0u)
+		nvim_flush(nvim);
+	return ECORE_CALLBACK_CANCEL;
+}
+
+void nvim_flush_schedule(struct nvim *const nvim)
+{
+	if (nvim->flush_handler)
+		return;
+
+	/* The idle enterer is called once all the events of the current
+	 * iteration have been processed, right before the main loop sleeps */
+	nvim->flush_handler = ecore_idle_enterer_add(&_nvim_flush_cb, nvim);
+	if (EINA_UNLIKELY(!nvim->flush_handler)) {
+		ERR("Failed to schedule a flush. Flushing now.");
+		nvim_api_input_pack(nvim);
+		nvim_flush(nvim);
+	}
+}
+
 Eina_Bool nvim_flush(struct nvim *nvim)
 {
+	/* A replayed stream has no neovim to answer to */
+	if (!nvim->transport.send) {
+		msgpack_sbuffer_clear(&nvim->sbuffer);
+		return EINA_TRUE;
+	}
+
 	/* Send the data present in the msgpack buffer */
-	const Eina_Bool ok = ecore_exe_send(nvim->exe, nvim->sbuffer.data, (int)nvim->sbuffer.size);
+	const Eina_Bool ok =
+		nvim->transport.send(nvim->transport.data, nvim->sbuffer.data, nvim->sbuffer.size);
 
 	/* Now that the data is gone (hopefully), clear the buffer */
 	if (EINA_UNLIKELY(!ok)) {
@@ -567,6 +1029,18 @@ Eina_Bool nvim_mouse_enabled_get(const struct nvim *nvim)
 	return nvim->mouse_enabled;
 }
 
+Eina_Bool nvim_replay(struct nvim *nvim, const void *data, size_t size)
+{
+	size_t capacity;
+	char *const buf = _nvim_stream_reserve(nvim, size, &capacity);
+	if (EINA_UNLIKELY(!buf))
+		return EINA_FALSE;
+	memcpy(buf, data, size);
+	mpack_stream_consumed(&nvim->stream, size);
+	nvim_io_stats_update(nvim, size, size);
+	return _nvim_unpack(nvim);
+}
+
 struct mode *nvim_mode_new(void)
 {
 	struct mode *const mode = calloc(1, sizeof(*mode));
@@ -6,19 +6,112 @@
 #include "eovim/nvim_event.h"
 #include "eovim/nvim.h"
 
+/* A request that has not been answered after this delay (in seconds) is
+ * reported and dropped. Neovim is most likely stalled. */
+#define NVIM_REQUEST_TIMEOUT 30.0
+
+/* Initial size of the ring of pending requests. MUST be a power of two. */
+#define NVIM_REQUESTS_RING_SIZE 64u
+
 struct request {
-	EINA_INLIST;
 	struct {
 		f_nvim_api_cb func;
 		void *data;
+		void (*free)(void *data); /**< Releases @p data with the request */
 	} cb;
+	double sent_at; /**< Timestamp of the creation of the request */
 	uint32_t uid;
+	char name[32]; /**< Name of the RPC, for diagnostics only */
 };
 
 /* Mempool to allocate the requests */
 static Eina_Mempool *_mempool;
 
-static struct request *_request_new(struct nvim *nvim, const char *rpc_name, size_t rpc_name_len)
+static Eina_Bool _requests_ring_grow(struct nvim *const nvim)
+{
+	const uint32_t size = nvim->requests.mask + 1u;
+	uint32_t new_size = (nvim->requests.ring) ? size * 2u : NVIM_REQUESTS_RING_SIZE;
+
+	/* All the pending requests must fit in the new ring without colliding.
+	 * This is almost always the case after doubling, but there is no
+	 * guarantee, as uids are not necessarily contiguous. */
+	for (; new_size != 0u; new_size *= 2u) {
+		struct request **const ring = calloc(new_size, sizeof(*ring));
+		if (EINA_UNLIKELY(!ring)) {
+			CRI("Failed to allocate memory");
+			return EINA_FALSE;
+		}
+		const uint32_t mask = new_size - 1u;
+		Eina_Bool collision = EINA_FALSE;
+		for (uint32_t i = 0u; (i < size) && (nvim->requests.ring) && (!collision); i++) {
+			struct request *const req = nvim->requests.ring[i];
+			if (!req)
+				continue;
+			if (ring[req->uid & mask])
+				collision = EINA_TRUE;
+			else
+				ring[req->uid & mask] = req;
+		}
+		if (!collision) {
+			free(nvim->requests.ring);
+			nvim->requests.ring = ring;
+			nvim->requests.mask = mask;
+			DBG("Ring of pending requests resized to %" PRIu32 " slots", new_size);
+			return EINA_TRUE;
+		}
+		free(ring);
+	}
+	CRI("Too many pending requests");
+	return EINA_FALSE;
+}
+
+static Eina_Bool _requests_timeout_cb(void *const data)
+{
+	struct nvim *const nvim = data;
+	const double now = ecore_time_get();
+
+	/* Freeing the last request deletes the timer. This one is running, so
+	 * detach it while requests are dropped. */
+	Ecore_Timer *const timer = nvim->requests.timer;
+	nvim->requests.timer = NULL;
+
+	for (uint32_t i = 0u; i <= nvim->requests.mask; i++) {
+		struct request *const req = nvim->requests.ring[i];
+		if (req && (now - req->sent_at >= NVIM_REQUEST_TIMEOUT)) {
+			ERR("Request '%s' (id %" PRIu32 ") was not answered after %.1f seconds. "
+			    "Dropping it. %u requests are still waiting for a response.",
+			    req->name, req->uid, now - req->sent_at, nvim->requests.in_flight - 1u);
+			nvim_api_request_free(nvim, req);
+		}
+	}
+
+	if (nvim->requests.in_flight == 0u)
+		return ECORE_CALLBACK_CANCEL;
+	nvim->requests.timer = timer;
+	return ECORE_CALLBACK_RENEW;
+}
+
+static Eina_Bool _request_register(struct nvim *const nvim, struct request *const req)
+{
+	if ((!nvim->requests.ring) || (nvim->requests.ring[req->uid & nvim->requests.mask])) {
+		if (EINA_UNLIKELY(!_requests_ring_grow(nvim)))
+			return EINA_FALSE;
+	}
+	nvim->requests.ring[req->uid & nvim->requests.mask] = req;
+
+	/* Watch for timeouts only while requests are in flight, so an idle
+	 * eovim is not woken up for nothing */
+	if (nvim->requests.in_flight++ == 0u) {
+		nvim->requests.timer =
+			ecore_timer_add(NVIM_REQUEST_TIMEOUT, &_requests_timeout_cb, nvim);
+		if (EINA_UNLIKELY(!nvim->requests.timer))
+			ERR("Failed to create timer. Requests will not time out.");
+	}
+	return EINA_TRUE;
+}
+
+static struct request *_request_prepare(struct nvim *nvim, const char *rpc_name,
+					size_t rpc_name_len)
 {
 	struct request *const req = eina_mempool_calloc(_mempool, sizeof(struct request));
 	if (EINA_UNLIKELY(!req)) {
@@ -27,17 +120,17 @@ static struct request *_request_new(struct nvim *nvim, const char *rpc_name, siz
 	}
 
 	req->uid = nvim_next_uid_get(nvim);
+	req->sent_at = ecore_time_get();
+	const size_t name_len = MIN(rpc_name_len, sizeof(req->name) - 1u);
+	memcpy(req->name, rpc_name, name_len);
+	req->name[name_len] = '\0';
 	DBG("Preparing request '%s' with id %" PRIu32, rpc_name, req->uid);
 
-	/* The buffer MUST be empty before preparing another request. If this is not
-    * the case, something went very wrong! Discard the buffer and keep going */
-	if (EINA_UNLIKELY(nvim->sbuffer.size != 0u)) {
-		ERR("The buffer is not empty. I've messed up somewhere");
-		msgpack_sbuffer_clear(&nvim->sbuffer);
-	}
-
 	/* Keep the request around */
-	nvim->requests = eina_inlist_append(nvim->requests, EINA_INLIST_GET(req));
+	if (EINA_UNLIKELY(!_request_register(nvim, req))) {
+		eina_mempool_free(_mempool, req);
+		return NULL;
+	}
 
 	msgpack_packer *const pk = &nvim->packer;
 	/*
@@ -57,32 +150,59 @@ static struct request *_request_new(struct nvim *nvim, const char *rpc_name, siz
 	return req;
 }
 
-static Eina_Bool _request_send(struct nvim *nvim, struct request *req)
+static struct request *_request_new(struct nvim *nvim, const char *rpc_name, size_t rpc_name_len)
 {
-	/* Finally, send that to the slave neovim process */
-	if (EINA_UNLIKELY(!nvim_flush(nvim))) {
-		nvim_api_request_free(nvim, req);
-		return EINA_FALSE;
-	}
+	/* Inputs that are still pending were issued before this request. They
+	 * must reach neovim first. */
+	nvim_api_input_pack(nvim);
+	return _request_prepare(nvim, rpc_name, rpc_name_len);
+}
+
+static Eina_Bool _request_send(struct nvim *nvim, struct request *req EINA_UNUSED)
+{
+	/* The request is sent to the slave neovim process along with the other
+	 * messages of this main loop iteration. If the write fails, the request
+	 * will time out. */
+	nvim_flush_schedule(nvim);
 	return EINA_TRUE;
 }
 
 struct request *nvim_api_request_find(const struct nvim *nvim, uint32_t req_id)
 {
-	struct request *req;
-
-	EINA_INLIST_FOREACH (nvim->requests, req)
-		if (req->uid == req_id)
-			return req;
-	return NULL;
+	if (EINA_UNLIKELY(!nvim->requests.ring))
+		return NULL;
+	struct request *const req = nvim->requests.ring[req_id & nvim->requests.mask];
+	return ((req != NULL) && (req->uid == req_id)) ? req : NULL;
 }
 
 void nvim_api_request_free(struct nvim *nvim, struct request *req)
 {
-	nvim->requests = eina_inlist_remove(nvim->requests, EINA_INLIST_GET(req));
+	if (req->cb.free)
+		req->cb.free(req->cb.data);
+	struct request **const slot = &(nvim->requests.ring[req->uid & nvim->requests.mask]);
+	if (EINA_LIKELY(*slot == req)) {
+		*slot = NULL;
+		if ((--nvim->requests.in_flight == 0u) && nvim->requests.timer) {
+			ecore_timer_del(nvim->requests.timer);
+			nvim->requests.timer = NULL;
+		}
+	}
 	eina_mempool_free(_mempool, req);
 }
 
+void nvim_api_requests_free(struct nvim *const nvim)
+{
+	if (nvim->requests.in_flight != 0u)
+		INF("Dropping %u requests that are still pending", nvim->requests.in_flight);
+	for (uint32_t i = 0u; (nvim->requests.ring) && (i <= nvim->requests.mask); i++) {
+		if (nvim->requests.ring[i])
+			nvim_api_request_free(nvim, nvim->requests.ring[i]);
+	}
+	free(nvim->requests.ring);
+	nvim->requests.ring = NULL;
+	nvim->requests.mask = 0u;
+}
+
 void nvim_api_request_call(struct nvim *nvim, const struct request *req,
 			   const msgpack_object *result)
 {
@@ -268,19 +388,257 @@ Eina_Bool nvim_api_command(struct nvim *nvim, const char *input, size_t input_si
 	return _request_send(nvim, req);
 }
 
-Eina_Bool nvim_api_input(struct nvim *nvim, const char *input, size_t input_size)
+Eina_Bool nvim_api_exec(struct nvim *nvim, const char *src, size_t src_size, f_nvim_api_cb func,
+			void *func_data)
 {
-	const char api[] = "nvim_input";
+	const char api[] = "nvim_exec";
 	struct request *const req = _request_new(nvim, api, sizeof(api) - 1);
 	if (EINA_UNLIKELY(!req)) {
 		CRI("Failed to create request");
 		return EINA_FALSE;
 	}
+	req->cb.func = func;
+	req->cb.data = func_data;
 
+	msgpack_packer *const pk = &nvim->packer;
+	msgpack_pack_array(pk, 2);
+	msgpack_pack_str(pk, src_size);
+	msgpack_pack_str_body(pk, src, src_size);
+	msgpack_pack_false(pk); /* Don't capture the output */
+
+	return _request_send(nvim, req);
+}
+
+/*============================================================================*
+ *                                  Batches                                   *
+ *============================================================================*/
+
+struct batch_call {
+	const char *method;
+	f_nvim_api_cb func;
+	void *data;
+	Eina_Bool skip_nil; /**< Don't call func when the result is nil */
+};
+
+struct nvim_api_batch {
+	struct nvim *nvim;
+	msgpack_sbuffer sbuffer; /**< The calls, packed one after the other */
+	msgpack_packer packer;
+	Eina_Inarray *calls; /**< Array of struct batch_call, in the same order */
+};
+
+static void _batch_free(void *const data)
+{
+	struct nvim_api_batch *const batch = data;
+	msgpack_sbuffer_destroy(&batch->sbuffer);
+	eina_inarray_free(batch->calls);
+	free(batch);
+}
+
+static void _batch_response_cb(struct nvim *const nvim, void *const data,
+			       const msgpack_object *const result)
+{
+	const struct nvim_api_batch *const batch = data;
+
+	/* nvim_call_atomic() answers [results, error]. The calls after the one
+	 * that failed (if any) were not run, and give no result */
+	if (EINA_UNLIKELY((result->type != MSGPACK_OBJECT_ARRAY) || (result->via.array.size != 2u) ||
+			  (result->via.array.ptr[0].type != MSGPACK_OBJECT_ARRAY))) {
+		ERR("Unexpected result of nvim_call_atomic");
+		return;
+	}
+	const msgpack_object_array *const results = &(result->via.array.ptr[0].via.array);
+	const msgpack_object *const error = &(result->via.array.ptr[1]);
+
+	const unsigned int count = MIN(results->size, eina_inarray_count(batch->calls));
+	for (unsigned int i = 0u; i < count; i++) {
+		const struct batch_call *const call = eina_inarray_nth(batch->calls, i);
+		const msgpack_object *const res = &(results->ptr[i]);
+		if (call->func && !(call->skip_nil && (res->type == MSGPACK_OBJECT_NIL)))
+			call->func(nvim, call->data, res);
+	}
+
+	if (error->type == MSGPACK_OBJECT_ARRAY && (error->via.array.size == 3u) &&
+	    (error->via.array.ptr[0].type == MSGPACK_OBJECT_POSITIVE_INTEGER) &&
+	    (error->via.array.ptr[2].type == MSGPACK_OBJECT_STR)) {
+		const uint64_t index = error->via.array.ptr[0].via.u64;
+		const msgpack_object_str *const msg = &(error->via.array.ptr[2].via.str);
+		const struct batch_call *const call =
+			(index < eina_inarray_count(batch->calls)) ?
+				eina_inarray_nth(batch->calls, (unsigned int)index) :
+				NULL;
+		ERR("Call %" PRIu64 " (%s) of the batch failed: %.*s. The next ones were dropped",
+		    index, (call) ? call->method : "?", (int)msg->size, msg->ptr);
+	}
+}
+
+struct nvim_api_batch *nvim_api_batch_new(struct nvim *nvim)
+{
+	struct nvim_api_batch *const batch = calloc(1, sizeof(*batch));
+	if (EINA_UNLIKELY(!batch)) {
+		CRI("Failed to allocate memory");
+		return NULL;
+	}
+	batch->calls = eina_inarray_new(sizeof(struct batch_call), 16);
+	if (EINA_UNLIKELY(!batch->calls)) {
+		CRI("Failed to create inline array");
+		free(batch);
+		return NULL;
+	}
+	batch->nvim = nvim;
+	msgpack_sbuffer_init(&batch->sbuffer);
+	msgpack_packer_init(&batch->packer, &batch->sbuffer, msgpack_sbuffer_write);
+	return batch;
+}
+
+msgpack_packer *nvim_api_batch_call(struct nvim_api_batch *batch, const char *method,
+				    uint32_t args_count, f_nvim_api_cb func, void *func_data)
+{
+	const struct batch_call call = {
+		.method = method,
+		.func = func,
+		.data = func_data,
+	};
+	if (EINA_UNLIKELY(eina_inarray_push(batch->calls, &call) < 0)) {
+		CRI("Failed to add call to the batch");
+		return NULL;
+	}
+
+	/* Each call is an array of two items: the method, and its arguments */
+	const size_t len = strlen(method);
+	msgpack_packer *const pk = &batch->packer;
+	msgpack_pack_array(pk, 2);
+	msgpack_pack_str(pk, len);
+	msgpack_pack_str_body(pk, method, len);
+	msgpack_pack_array(pk, args_count);
+	return pk;
+}
+
+Eina_Bool nvim_api_batch_get_var(struct nvim_api_batch *batch, const char *var, f_nvim_api_cb func,
+				 void *func_data)
+{
+	/* nvim_get_var() fails when the variable is not set, which would abort
+	 * all the calls that come after it. Evaluate get() instead, which gives
+	 * nil, and ignore it. */
+	char expr[256];
+	const int len = snprintf(expr, sizeof(expr), "get(g:, '%s', v:null)", var);
+	if (EINA_UNLIKELY((len < 0) || ((size_t)len >= sizeof(expr)))) {
+		ERR("Variable name '%s' is too long", var);
+		return EINA_FALSE;
+	}
+	msgpack_packer *const pk = nvim_api_batch_call(batch, "nvim_eval", 1u, func, func_data);
+	if (EINA_UNLIKELY(!pk))
+		return EINA_FALSE;
+	struct batch_call *const call =
+		eina_inarray_nth(batch->calls, eina_inarray_count(batch->calls) - 1u);
+	call->skip_nil = EINA_TRUE;
+	msgpack_pack_str(pk, (size_t)len);
+	msgpack_pack_str_body(pk, expr, (size_t)len);
+	return EINA_TRUE;
+}
+
+Eina_Bool nvim_api_batch_send(struct nvim_api_batch *batch)
+{
+	struct nvim *const nvim = batch->nvim;
+	const unsigned int count = eina_inarray_count(batch->calls);
+	if (count == 0u) {
+		_batch_free(batch);
+		return EINA_TRUE;
+	}
+
+	const char api[] = "nvim_call_atomic";
+	struct request *const req = _request_new(nvim, api, sizeof(api) - 1);
+	if (EINA_UNLIKELY(!req)) {
+		CRI("Failed to create request");
+		_batch_free(batch);
+		return EINA_FALSE;
+	}
+	req->cb.func = &_batch_response_cb;
+	req->cb.data = batch;
+	req->cb.free = &_batch_free;
+
+	/* The calls were already packed: they are copied as they are */
 	msgpack_packer *const pk = &nvim->packer;
 	msgpack_pack_array(pk, 1);
-	msgpack_pack_str(pk, input_size);
-	msgpack_pack_str_body(pk, input, input_size);
+	msgpack_pack_array(pk, count);
+	msgpack_sbuffer_write(&nvim->sbuffer, batch->sbuffer.data, batch->sbuffer.size);
+	msgpack_sbuffer_destroy(&batch->sbuffer);
+	msgpack_sbuffer_init(&batch->sbuffer);
+
+	return _request_send(nvim, req);
+}
+
+void nvim_api_input_pack(struct nvim *nvim)
+{
+	Eina_Strbuf *const buf = nvim->input.pending;
+	const size_t size = eina_strbuf_length_get(buf);
+	if (size == 0u)
+		return;
+
+	const char api[] = "nvim_input";
+	struct request *const req = _request_prepare(nvim, api, sizeof(api) - 1);
+	if (EINA_UNLIKELY(!req)) {
+		CRI("Failed to create request");
+	} else {
+		msgpack_packer *const pk = &nvim->packer;
+		msgpack_pack_array(pk, 1);
+		msgpack_pack_str(pk, size);
+		msgpack_pack_str_body(pk, eina_strbuf_string_get(buf), size);
+	}
+	eina_strbuf_reset(buf);
+	nvim->input.has_motion = EINA_FALSE;
+}
+
+Eina_Bool nvim_api_input(struct nvim *nvim, const char *input, size_t input_size)
+{
+	/* Inputs of the same main loop iteration (key repeat, wheel scrolling,
+	 * ...) are merged and sent as a single nvim_input request */
+	if (EINA_UNLIKELY(!eina_strbuf_append_length(nvim->input.pending, input, input_size))) {
+		CRI("Failed to append input");
+		return EINA_FALSE;
+	}
+	nvim->input.has_motion = EINA_FALSE;
+	nvim_flush_schedule(nvim);
+	return EINA_TRUE;
+}
+
+Eina_Bool nvim_api_input_motion(struct nvim *nvim, const char *input, size_t input_size)
+{
+	Eina_Strbuf *const buf = nvim->input.pending;
+	if (nvim->input.has_motion)
+		eina_strbuf_remove(buf, nvim->input.motion_at, eina_strbuf_length_get(buf));
+
+	const size_t at = eina_strbuf_length_get(buf);
+	if (EINA_UNLIKELY(!nvim_api_input(nvim, input, input_size)))
+		return EINA_FALSE;
+	nvim->input.motion_at = at;
+	nvim->input.has_motion = EINA_TRUE;
+	return EINA_TRUE;
+}
+
+Eina_Bool nvim_api_input_mouse(struct nvim *nvim, const char *button, const char *action,
+			       t_int grid, unsigned int row, unsigned int col)
+{
+	const char api[] = "nvim_input_mouse";
+	struct request *const req = _request_new(nvim, api, sizeof(api) - 1);
+	if (EINA_UNLIKELY(!req)) {
+		CRI("Failed to create request");
+		return EINA_FALSE;
+	}
+
+	const size_t button_size = strlen(button);
+	const size_t action_size = strlen(action);
+
+	msgpack_packer *const pk = &nvim->packer;
+	msgpack_pack_array(pk, 6);
+	msgpack_pack_str(pk, button_size);
+	msgpack_pack_str_body(pk, button, button_size);
+	msgpack_pack_str(pk, action_size);
+	msgpack_pack_str_body(pk, action, action_size);
+	msgpack_pack_str(pk, 0); /* No modifier */
+	msgpack_pack_int64(pk, grid);
+	msgpack_pack_uint32(pk, row);
+	msgpack_pack_uint32(pk, col);
 
 	return _request_send(nvim, req);
 }
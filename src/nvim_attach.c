@@ -6,10 +6,14 @@
 #include <eovim/nvim_api.h>
 #include <eovim/nvim_event.h>
 #include <eovim/nvim_helper.h>
+#include <eovim/nvim_cache.h>
 #include <eovim/nvim_request.h>
 #include <eovim/msgpack_helper.h>
 #include <eovim/log.h>
 #include <eovim/main.h>
+#include <eovim/profile.h>
+
+#include <limits.h>
 
 static unsigned int _version_fragment_decode(const msgpack_object *version)
 {
@@ -93,25 +97,18 @@ static void _ui_options_decode(struct nvim *nvim, const msgpack_object *args)
 		nvim->features.tabline |= (_MSGPACK_STREQ(opt, "ext_tabline"));
 		nvim->features.popupmenu |= (_MSGPACK_STREQ(opt, "ext_popupmenu"));
 	}
-
-	if (EINA_UNLIKELY(!nvim->features.linegrid)) {
-		gui_die(&nvim->gui,
-			"You are running neovim %u.%u.%u, which does not provide support "
-			"for the 'ext_linegrid' feature. Please upgrade neovim.",
-			nvim->version.major, nvim->version.minor, nvim->version.patch);
-	}
-
 	return;
 fail:
 	ERR("Failed to decode ui_options API");
 }
 
 /******************************************************************************
- *                                  - 5 -
+ *                                  - 3 -
  *
- * The UI is now attached. The init.vim has been sourced. We will start by
- * fetching configuration variables, that will impact the theme and external
- * UI features.
+ * The UI is now attached. The init.vim has been sourced, and the VimEnter
+ * autocmd registered by our runtime sent us the "vimenter" request. We will
+ * start by fetching configuration variables, that will impact the theme and
+ * external UI features.
  *
  * This is a bit tricky, though... Indeed neovim has just sent a BLOCKING
  * request. That is: nothing will be displayed to the user until we answer the
@@ -140,78 +137,83 @@ static Eina_Bool _ui_attached_cb(struct nvim *const nvim,
 	return EINA_TRUE;
 }
 
-/******************************************************************************
- *                                  - 4 -
- *
- * This is called after the VimEnter autocmd has been registered.
- * We will now really attach to nvim. It is the vimenter request that will
- * trigger the _ui_attached_cb handler
- *****************************************************************************/
-static void _vimenter_registered_cb(struct nvim *const nvim, void *const data EINA_UNUSED,
-				    const msgpack_object *const result EINA_UNUSED)
-{
-	const Eina_Rectangle *const geo = &nvim->opts->geometry;
-	nvim_api_ui_attach(nvim, (unsigned)geo->w, (unsigned)geo->h, NULL, NULL);
-}
-
-/******************************************************************************
- *                                  - 3 -
- *
- * This is called after we send our custom vim runtime. We will now register
- * a vimenter autocmd.
- *****************************************************************************/
-static void _eovim_runtime_loaded_cb(struct nvim *const nvim, void *const data,
-				     const msgpack_object *const result EINA_UNUSED)
+/* A server may run on another host, that does not have our runtime file. Its
+ * content is sent instead of its path. The server has already started, so
+ * the VimEnter autocmd it registers never fires. */
+static void _nvim_runtime_send(struct nvim *const nvim, const char *const dir)
 {
-	/* We re-use the strbuf previously used to compose the command that allows the
-	 * registration of the VimEnter autocmd */
-	Eina_Strbuf *const buf = data;
-
-	eina_strbuf_reset(buf);
-	eina_strbuf_append_printf(
-		buf, "autocmd VimEnter * call rpcrequest(%" PRIu64 ", 'vimenter')", nvim->channel);
-
-	/* Create the vimenter request handler, so we can be notified after
-	 * nvim_ui_attached has been processed */
-	nvim_request_add("vimenter", _ui_attached_cb);
-
-	/* Request the registration of the vimenter autocmd */
-	nvim_api_command(nvim, eina_strbuf_string_get(buf),
-			 (unsigned int)eina_strbuf_length_get(buf), &_vimenter_registered_cb, NULL);
+	char path[PATH_MAX];
+	snprintf(path, sizeof(path), "%s/vim/runtime.vim", dir);
 
-	eina_strbuf_free(buf);
+	Eina_File *const file = eina_file_open(path, EINA_FALSE);
+	if (EINA_UNLIKELY(!file)) {
+		ERR("Failed to open '%s'", path);
+		return;
+	}
+	const char *const src = eina_file_map_all(file, EINA_FILE_SEQUENTIAL);
+	if (EINA_LIKELY(src != NULL)) {
+		nvim_api_exec(nvim, src, eina_file_size_get(file), NULL, NULL);
+		eina_file_map_free(file, (void *)src);
+	} else
+		ERR("Failed to map '%s'", path);
+	eina_file_close(file);
 }
 
 /******************************************************************************
  *                                  - 2 -
  *
- * This is called after we have collected neovim's capabilities. We now send
- * our own vim runtime to neovim, before init.vim is sourced
+ * Our own vim runtime is sent to neovim, before init.vim is sourced. It also
+ * registers the VimEnter autocmd that sends us the "vimenter" request.
  *****************************************************************************/
 static void _nvim_runtime_load(struct nvim *const nvim)
 {
+	const char *const dir = (main_in_tree_is()) ? SOURCE_DATA_DIR : elm_app_data_dir_get();
+	if (nvim->opts->server) {
+		_nvim_runtime_send(nvim, dir);
+		return;
+	}
+
 	Eina_Strbuf *const buf = eina_strbuf_new();
 	if (EINA_UNLIKELY(!buf)) {
 		CRI("Failed to allocate string buffer");
 		return;
 	}
-	eina_strbuf_append(buf, ":source ");
 
 	/* Compose the path to the runtime file */
-	const char *const dir = (main_in_tree_is()) ? SOURCE_DATA_DIR : elm_app_data_dir_get();
+	eina_strbuf_append(buf, ":source ");
 	eina_strbuf_append_printf(buf, "%s/vim/runtime.vim", dir);
 	eina_strbuf_append_printf(buf, "| let &rtp.=',%s/vim'", dir);
 
-	/* Send it to neovim */
+	/* Send it to neovim. The command is packed right away */
 	nvim_api_command(nvim, eina_strbuf_string_get(buf),
-			 (unsigned int)eina_strbuf_length_get(buf), &_eovim_runtime_loaded_cb, buf);
+			 (unsigned int)eina_strbuf_length_get(buf), NULL, NULL);
+	eina_strbuf_free(buf);
 }
 
 /******************************************************************************
  *                                  - 1 -
  *
- * This is called when neovim sends us its capabilities
+ * We know what neovim can do, either because it told us, or because the same
+ * program told a previous instance of eovim (see nvim_cache.h)
  *****************************************************************************/
+static void _capabilities_use(struct nvim *const nvim)
+{
+	INF("Running Neovim version %u.%u.%u", nvim->version.major, nvim->version.minor,
+	    nvim->version.patch);
+
+	if (EINA_UNLIKELY(!nvim->features.linegrid)) {
+		gui_die(&nvim->gui,
+			"You are running neovim %u.%u.%u, which does not provide support "
+			"for the 'ext_linegrid' feature. Please upgrade neovim.",
+			nvim->version.major, nvim->version.minor, nvim->version.patch);
+	}
+
+	/* Okay, start running the GUI! */
+	nvim->startup.answered = profile_time_get();
+	gui_ready_set(&nvim->gui);
+}
+
+/* This is called when neovim sends us its capabilities */
 static void _api_decode_cb(struct nvim *nvim, void *data EINA_UNUSED, const msgpack_object *result)
 {
 	/* We expect two arguments:
@@ -260,18 +262,19 @@ static void _api_decode_cb(struct nvim *nvim, void *data EINA_UNUSED, const msgp
 	}
 
 	/****************************************************************************
-	 * Now that we have decoded the API information, use them!
+	 * Now that we have decoded the API information, use them! They are
+	 * cached, so the next instances don't have to ask again. A server is not
+	 * the program the cache describes: its runtime is told the channel to
+	 * send the :Eovim commands to instead.
 	 *****************************************************************************/
-	INF("Running Neovim version %u.%u.%u", nvim->version.major, nvim->version.minor,
-	    nvim->version.patch);
-
-	/* Okay, start running the GUI! */
-	gui_ready_set(&nvim->gui);
-
-	/****************************************************************************
-	 * Now that we are done with neovim's capabilities, time to load our initial
-	 * vimscript runtime, before the init.vim is sourced ***********************/
-	_nvim_runtime_load(nvim);
+	if (nvim->opts->server) {
+		char cmd[64];
+		const int len = snprintf(cmd, sizeof(cmd), "let g:eovim_channel = %" PRIu64,
+					 nvim->channel);
+		nvim_api_command(nvim, cmd, (size_t)len, NULL, NULL);
+	} else
+		nvim_cache_save(nvim);
+	_capabilities_use(nvim);
 }
 
 /******************************************************************************
@@ -284,9 +287,32 @@ static void _api_decode_cb(struct nvim *nvim, void *data EINA_UNUSED, const msgp
  * We also want to query some variable set from vimscript, to use or not some
  * externalized UI features.
  *
+ * Neovim handles the requests in the order they were sent. None of them
+ * depends on the answer to the previous one, so they all go out at once, in
+ * a single write, as soon as neovim has been spawned. Neovim then boots
+ * while the window is being created. When the capabilities of neovim are
+ * cached, they are not even requested.
+ *
+ * A server (--server) has already entered vim and sourced its init.vim: it
+ * will never send the "vimenter" request, so the configuration is loaded
+ * right after attaching.
  *****************************************************************************/
 void nvim_attach(struct nvim *const nvim)
 {
-	/* We first start be querying neovim's capabilities */
-	nvim_api_get_api_info(nvim, _api_decode_cb, NULL);
+	const Eina_Rectangle *const geo = &nvim->opts->geometry;
+	const Eina_Bool server = (nvim->opts->server != NULL);
+
+	if (!server)
+		nvim_request_add("vimenter", _ui_attached_cb);
+	if ((!server) && nvim_cache_load(nvim))
+		_capabilities_use(nvim);
+	else
+		nvim_api_get_api_info(nvim, _api_decode_cb, NULL);
+	_nvim_runtime_load(nvim);
+	nvim_api_ui_attach(nvim, (unsigned)geo->w, (unsigned)geo->h, NULL, NULL);
+	if (server) {
+		nvim_helper_config_reload(nvim);
+		nvim_helper_autocmd_do(nvim, "EovimReady", NULL, NULL);
+	}
+	nvim_flush(nvim);
 }
@@ -0,0 +1,202 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#include "eovim/nvim_cache.h"
+#include "eovim/nvim.h"
+#include "eovim/log.h"
+
+#include <Eet.h>
+#include <Ecore_File.h>
+
+#include <limits.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/* Bump this when the layout of the cache entry changes */
+#define CACHE_FORMAT 1u
+
+/* The cache holds a single entry, named after the path of the program it
+ * describes. It is written in a temporary file that then replaces the cache,
+ * so concurrent instances of eovim never see a partial file. */
+struct cache_entry {
+	unsigned int format;
+	long long size; /**< Size of the neovim program */
+	long long mtime; /**< Modification time of the neovim program */
+	unsigned int major;
+	unsigned int minor;
+	unsigned int patch;
+	unsigned char linegrid;
+	unsigned char multigrid;
+	unsigned char cmdline;
+	unsigned char tabline;
+	unsigned char popupmenu;
+};
+
+static Eet_Data_Descriptor *_edd = NULL;
+
+/**
+ * Find the program that runs as neovim, as the shell would. @p path is set
+ * to the path of the program, which is described by @p st.
+ */
+static Eina_Bool _program_find(const char *const program, char path[PATH_MAX],
+			       struct stat *const st)
+{
+	if (strchr(program, '/')) {
+		if (EINA_UNLIKELY(!realpath(program, path)))
+			return EINA_FALSE;
+		return (stat(path, st) == 0);
+	}
+
+	const char *dir = getenv("PATH");
+	while (dir && *dir) {
+		const char *end = strchr(dir, ':');
+		if (!end)
+			end = dir + strlen(dir);
+		char candidate[PATH_MAX];
+		const int len =
+			snprintf(candidate, sizeof(candidate), "%.*s/%s", (int)(end - dir), dir, program);
+		if ((len > 0) && ((size_t)len < sizeof(candidate)) && (access(candidate, X_OK) == 0))
+			return (realpath(candidate, path) && (stat(path, st) == 0));
+		dir = (*end == ':') ? end + 1 : NULL;
+	}
+	return EINA_FALSE;
+}
+
+Eina_Bool nvim_cache_file_get(const char *const name, char file[PATH_MAX], char dir[PATH_MAX])
+{
+	const char *const xdg = getenv("XDG_CACHE_HOME");
+	const char *const home = getenv("HOME");
+	int len;
+
+	if (xdg && *xdg)
+		len = snprintf(dir, PATH_MAX, "%s/eovim", xdg);
+	else if (home && *home)
+		len = snprintf(dir, PATH_MAX, "%s/.cache/eovim", home);
+	else
+		return EINA_FALSE;
+	if (EINA_UNLIKELY((len < 0) || (len >= PATH_MAX)))
+		return EINA_FALSE;
+
+	len = snprintf(file, PATH_MAX, "%s/%s", dir, name);
+	return (len > 0) && (len < PATH_MAX);
+}
+
+Eina_Bool nvim_cache_load(struct nvim *const nvim)
+{
+	char program[PATH_MAX], file[PATH_MAX], dir[PATH_MAX];
+	struct stat st;
+
+	if (!_program_find(nvim->opts->nvim, program, &st) ||
+	    !nvim_cache_file_get("api-info.eet", file, dir))
+		return EINA_FALSE;
+
+	Eet_File *const ef = eet_open(file, EET_FILE_MODE_READ);
+	if (!ef)
+		return EINA_FALSE;
+	struct cache_entry *const entry = eet_data_read(ef, _edd, program);
+	eet_close(ef);
+	if (!entry) {
+		INF("No cached capabilities for '%s'", program);
+		return EINA_FALSE;
+	}
+
+	const Eina_Bool valid = (entry->format == CACHE_FORMAT) &&
+				(entry->size == (long long)st.st_size) &&
+				(entry->mtime == (long long)st.st_mtime);
+	if (valid) {
+		nvim->version.major = entry->major;
+		nvim->version.minor = entry->minor;
+		nvim->version.patch = entry->patch;
+		nvim->features.linegrid = !!entry->linegrid;
+		nvim->features.multigrid = !!entry->multigrid;
+		nvim->features.cmdline = !!entry->cmdline;
+		nvim->features.tabline = !!entry->tabline;
+		nvim->features.popupmenu = !!entry->popupmenu;
+		INF("Using the cached capabilities of '%s'", program);
+	} else
+		INF("The cached capabilities of '%s' are outdated", program);
+	free(entry);
+	return valid;
+}
+
+void nvim_cache_save(const struct nvim *const nvim)
+{
+	char program[PATH_MAX], file[PATH_MAX], dir[PATH_MAX], tmp[PATH_MAX];
+	struct stat st;
+
+	if (!_program_find(nvim->opts->nvim, program, &st) ||
+	    !nvim_cache_file_get("api-info.eet", file, dir))
+		return;
+	const int len = snprintf(tmp, sizeof(tmp), "%s.%i", file, (int)getpid());
+	if (EINA_UNLIKELY((len < 0) || ((size_t)len >= sizeof(tmp))))
+		return;
+	if (EINA_UNLIKELY(!ecore_file_mkpath(dir))) {
+		ERR("Failed to create directory '%s'", dir);
+		return;
+	}
+
+	const struct cache_entry entry = {
+		.format = CACHE_FORMAT,
+		.size = (long long)st.st_size,
+		.mtime = (long long)st.st_mtime,
+		.major = nvim->version.major,
+		.minor = nvim->version.minor,
+		.patch = nvim->version.patch,
+		.linegrid = nvim->features.linegrid,
+		.multigrid = nvim->features.multigrid,
+		.cmdline = nvim->features.cmdline,
+		.tabline = nvim->features.tabline,
+		.popupmenu = nvim->features.popupmenu,
+	};
+
+	Eet_File *const ef = eet_open(tmp, EET_FILE_MODE_WRITE);
+	if (EINA_UNLIKELY(!ef)) {
+		ERR("Failed to open '%s' for writing", tmp);
+		return;
+	}
+	const int written = eet_data_write(ef, _edd, program, &entry, EINA_FALSE);
+	if ((eet_close(ef) != EET_ERROR_NONE) || (written <= 0) || (rename(tmp, file) != 0)) {
+		ERR("Failed to write the cache '%s'", file);
+		unlink(tmp);
+	}
+}
+
+Eina_Bool nvim_cache_init(void)
+{
+	if (EINA_UNLIKELY(eet_init() <= 0)) {
+		CRI("Failed to initialize Eet");
+		return EINA_FALSE;
+	}
+
+	Eet_Data_Descriptor_Class eddc;
+	EET_EINA_FILE_DATA_DESCRIPTOR_CLASS_SET(&eddc, struct cache_entry);
+	_edd = eet_data_descriptor_file_new(&eddc);
+	if (EINA_UNLIKELY(!_edd)) {
+		CRI("Failed to create data descriptor");
+		eet_shutdown();
+		return EINA_FALSE;
+	}
+
+#define ADD_BASIC(Field, Type)                                                                     \
+	EET_DATA_DESCRIPTOR_ADD_BASIC(_edd, struct cache_entry, #Field, Field, Type)
+	ADD_BASIC(format, EET_T_UINT);
+	ADD_BASIC(size, EET_T_LONG_LONG);
+	ADD_BASIC(mtime, EET_T_LONG_LONG);
+	ADD_BASIC(major, EET_T_UINT);
+	ADD_BASIC(minor, EET_T_UINT);
+	ADD_BASIC(patch, EET_T_UINT);
+	ADD_BASIC(linegrid, EET_T_UCHAR);
+	ADD_BASIC(multigrid, EET_T_UCHAR);
+	ADD_BASIC(cmdline, EET_T_UCHAR);
+	ADD_BASIC(tabline, EET_T_UCHAR);
+	ADD_BASIC(popupmenu, EET_T_UCHAR);
+#undef ADD_BASIC
+
+	return EINA_TRUE;
+}
+
+void nvim_cache_shutdown(void)
+{
+	eet_data_descriptor_free(_edd);
+	_edd = NULL;
+	eet_shutdown();
+}
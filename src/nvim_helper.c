@@ -111,39 +111,46 @@ static void parse_styles_map(struct nvim *const nvim, void *const data,
 			continue;
 		}
 	}
-	termview_style_update(nvim->gui.termview);
+	termview_kind_styles_changed(nvim->gui.termview);
 }
 
 Eina_Bool nvim_helper_config_reload(struct nvim *const nvim)
 {
 	struct gui *const gui = &nvim->gui;
+	struct nvim_api_batch *const batch = nvim_api_batch_new(nvim);
+	if (EINA_UNLIKELY(!batch))
+		return EINA_FALSE;
 
 	/* Retrive theme-oriented configuration */
-	nvim_api_get_var(nvim, "eovim_theme_bell_enabled", &parse_theme_config_bool,
-			 &gui->theme.bell_enabled);
-	nvim_api_get_var(nvim, "eovim_theme_react_to_key_presses", &parse_theme_config_bool,
-			 &gui->theme.react_to_key_presses);
-	nvim_api_get_var(nvim, "eovim_theme_react_to_caps_lock", &parse_theme_config_bool,
-			 &gui->theme.react_to_caps_lock);
-
-	nvim_api_get_var(nvim, "eovim_cursor_cuts_ligatures", &parse_theme_config_bool,
-			 &gui->theme.cursor_cuts_ligatures);
-	nvim_api_get_var(nvim, "eovim_cursor_animated", &parse_theme_config_bool,
-			 &gui->theme.cursor_animated);
-	nvim_api_get_var(nvim, "eovim_cursor_animation_duration", &parse_theme_config_double,
-			 &gui->theme.cursor_animation_duration);
-	nvim_api_get_var(nvim, "eovim_cursor_animation_style", &parse_theme_config_animation_style,
-			 &gui->theme.cursor_animation_style);
-
-	nvim_api_get_var(nvim, "eovim_ext_tabline", &parse_ext_config, "ext_tabline");
-	nvim_api_get_var(nvim, "eovim_ext_popupmenu", &parse_ext_config, "ext_popupmenu");
-	nvim_api_get_var(nvim, "eovim_ext_cmdline", &parse_ext_config, "ext_cmdline");
-
-	nvim_api_get_var(nvim, "eovim_theme_completion_styles", &parse_styles_map,
-			 nvim->kind_styles);
-	nvim_api_get_var(nvim, "eovim_theme_cmdline_styles", &parse_styles_map,
-			 nvim->cmdline_styles);
-	//nvim_api_get_var(nvim, "eovim_ext_multigrid",
-	//  &parse_config_boolean, &gui->ext.multigrid);
-	return EINA_TRUE;
+	nvim_api_batch_get_var(batch, "eovim_theme_bell_enabled", &parse_theme_config_bool,
+			       &gui->theme.bell_enabled);
+	nvim_api_batch_get_var(batch, "eovim_theme_react_to_key_presses", &parse_theme_config_bool,
+			       &gui->theme.react_to_key_presses);
+	nvim_api_batch_get_var(batch, "eovim_theme_react_to_caps_lock", &parse_theme_config_bool,
+			       &gui->theme.react_to_caps_lock);
+
+	nvim_api_batch_get_var(batch, "eovim_cursor_cuts_ligatures", &parse_theme_config_bool,
+			       &gui->theme.cursor_cuts_ligatures);
+	nvim_api_batch_get_var(batch, "eovim_cursor_animated", &parse_theme_config_bool,
+			       &gui->theme.cursor_animated);
+	nvim_api_batch_get_var(batch, "eovim_cursor_animation_duration",
+			       &parse_theme_config_double, &gui->theme.cursor_animation_duration);
+	nvim_api_batch_get_var(batch, "eovim_cursor_animation_style",
+			       &parse_theme_config_animation_style,
+			       &gui->theme.cursor_animation_style);
+	nvim_api_batch_get_var(batch, "eovim_render_immediately", &parse_theme_config_bool,
+			       &gui->theme.render_immediately);
+
+	nvim_api_batch_get_var(batch, "eovim_ext_tabline", &parse_ext_config, "ext_tabline");
+	nvim_api_batch_get_var(batch, "eovim_ext_popupmenu", &parse_ext_config, "ext_popupmenu");
+	nvim_api_batch_get_var(batch, "eovim_ext_cmdline", &parse_ext_config, "ext_cmdline");
+	nvim_api_batch_get_var(batch, "eovim_ext_multigrid", &parse_ext_config, "ext_multigrid");
+
+	nvim_api_batch_get_var(batch, "eovim_theme_completion_styles", &parse_styles_map,
+			       nvim->kind_styles);
+	nvim_api_batch_get_var(batch, "eovim_theme_cmdline_styles", &parse_styles_map,
+			       nvim->cmdline_styles);
+
+	/* All the settings are fetched with a single request */
+	return nvim_api_batch_send(batch);
 }
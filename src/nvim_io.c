@@ -0,0 +1,281 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#include "eovim/nvim_io.h"
+#include "eovim/nvim.h"
+#include "eovim/msgpack_reader.h"
+#include "eovim/log.h"
+#include "eovim/profile.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+
+/* How many bytes the thread is willing to read at once from neovim */
+#define IO_READ_SIZE 65536u
+
+/* Chunks the ring can hold. This must be a power of two */
+#define IO_RING_SIZE 1024u
+
+/* Chunks the main loop processes before it lets other events in. Only
+ * inputs are expected to be interleaved: a redraw flood is still processed in
+ * order. */
+#define IO_BATCH_MAX 64u
+
+/* The whole messages that were cut from one read, one after the other. The
+ * main loop decodes them, in place for the redraw notifications, and frees
+ * the chunk once they have been processed. */
+struct chunk {
+	char *data;
+	size_t size;
+};
+
+struct nvim_io {
+	struct nvim *nvim;
+	Eina_Thread thread;
+	int fd;
+
+	/* The thread wakes the main loop up through the pipe when it pushes in
+	 * an empty ring, and the main loop stops the thread through stop_fds */
+	Ecore_Pipe *wakeup;
+	int stop_fds[2];
+	Eina_Bool stop;
+	Eina_Bool closed; /**< The thread will not push anything anymore */
+
+	/* The ring. head is written by the main loop only, and tail by the
+	 * thread only. They wrap around, and the slot of an index is
+	 * (index & (IO_RING_SIZE - 1)). */
+	struct chunk ring[IO_RING_SIZE];
+	unsigned int head;
+	unsigned int tail;
+	Eina_Bool signaled; /**< The main loop was woken up, and did not run yet */
+	Eina_Bool waiting; /**< The thread waits for room in the ring */
+	Eina_Semaphore room;
+
+	uint64_t received; /**< Bytes received since the main loop last ran */
+
+	/* Only used by the thread */
+	struct mpack_stream stream;
+};
+
+/*============================================================================*
+ *                               Consumer Side                                *
+ *============================================================================*/
+
+static void _wakeup_cb(void *const data, void *const buffer EINA_UNUSED,
+		       const unsigned int size EINA_UNUSED)
+{
+	struct nvim_io *const io = data;
+
+	/* Anything pushed from now on wakes us up again */
+	__atomic_store_n(&io->signaled, EINA_FALSE, __ATOMIC_SEQ_CST);
+	nvim_io_stats_update(io->nvim, __atomic_exchange_n(&io->received, 0u, __ATOMIC_RELAXED),
+			     0u);
+
+	unsigned int head = io->head;
+	const unsigned int tail = __atomic_load_n(&io->tail, __ATOMIC_ACQUIRE);
+	unsigned int processed = 0u;
+	for (; (head != tail) && (processed < IO_BATCH_MAX); head++, processed++) {
+		struct chunk *const chunk = &io->ring[head & (IO_RING_SIZE - 1u)];
+		if (EINA_UNLIKELY(!nvim_messages_handle(io->nvim, chunk->data, chunk->size)))
+			ERR("Failed to process %zu bytes received from neovim", chunk->size);
+		free(chunk->data);
+
+		/* Make room as soon as possible, so the thread never waits long */
+		__atomic_store_n(&io->head, head + 1u, __ATOMIC_RELEASE);
+		if (__atomic_exchange_n(&io->waiting, EINA_FALSE, __ATOMIC_SEQ_CST))
+			eina_semaphore_release(&io->room, 1);
+	}
+
+	/* Let the other events of this iteration in, and come back after them */
+	if ((head != tail) && (!__atomic_exchange_n(&io->signaled, EINA_TRUE, __ATOMIC_SEQ_CST)))
+		ecore_pipe_write(io->wakeup, "", 1u);
+	else if ((head == __atomic_load_n(&io->tail, __ATOMIC_ACQUIRE)) &&
+		 __atomic_exchange_n(&io->closed, EINA_FALSE, __ATOMIC_SEQ_CST))
+		nvim_output_closed(io->nvim);
+}
+
+/*============================================================================*
+ *                               Producer Side                                *
+ *============================================================================*/
+
+static Eina_Bool _push(struct nvim_io *const io, const struct chunk *const chunk)
+{
+	const unsigned int tail = io->tail;
+
+	/* Wait for the main loop to make room. It is told that we wait before we
+	 * check again, so a release cannot be missed. */
+	while (tail - __atomic_load_n(&io->head, __ATOMIC_ACQUIRE) >= IO_RING_SIZE) {
+		__atomic_store_n(&io->waiting, EINA_TRUE, __ATOMIC_SEQ_CST);
+		if (tail - __atomic_load_n(&io->head, __ATOMIC_SEQ_CST) < IO_RING_SIZE)
+			break;
+		eina_semaphore_lock(&io->room);
+		if (__atomic_load_n(&io->stop, __ATOMIC_ACQUIRE))
+			return EINA_FALSE;
+	}
+
+	io->ring[tail & (IO_RING_SIZE - 1u)] = *chunk;
+	__atomic_store_n(&io->tail, tail + 1u, __ATOMIC_RELEASE);
+	if (!__atomic_exchange_n(&io->signaled, EINA_TRUE, __ATOMIC_SEQ_CST))
+		ecore_pipe_write(io->wakeup, "", 1u);
+	return EINA_TRUE;
+}
+
+/* Cut the messages that were received entirely, and hand them over. The
+ * scan validates them, so the main loop only gets whole msgpack objects. */
+static Eina_Bool _messages_push(struct nvim_io *const io)
+{
+	struct mpack_stream *const stream = &io->stream;
+	const char *first = NULL, *msg;
+	size_t total = 0u, size;
+	enum mpack_scan_status status;
+
+	/* The messages are contiguous in the stream */
+	while ((status = mpack_stream_next(stream, &msg, &size)) == MPACK_SCAN_DONE) {
+		if (!first)
+			first = msg;
+		total += size;
+	}
+	if (EINA_UNLIKELY(status == MPACK_SCAN_INVALID)) {
+		ERR("Invalid data received from neovim, at byte %zu of a message",
+		    stream->scan.offset);
+		return EINA_FALSE;
+	}
+	if (total == 0u)
+		return EINA_TRUE;
+
+	/* A single copy for all the messages of the read */
+	const struct chunk chunk = { .data = malloc(total), .size = total };
+	if (EINA_UNLIKELY(!chunk.data)) {
+		CRI("Failed to allocate %zu bytes", total);
+		return EINA_FALSE;
+	}
+	memcpy(chunk.data, first, total);
+	if (EINA_UNLIKELY(!_push(io, &chunk))) {
+		free(chunk.data);
+		return EINA_FALSE;
+	}
+	return EINA_TRUE;
+}
+
+static void *_io_thread(void *const data, Eina_Thread thread EINA_UNUSED)
+{
+	struct nvim_io *const io = data;
+	struct pollfd fds[2] = {
+		{ .fd = io->fd, .events = POLLIN },
+		{ .fd = io->stop_fds[0], .events = POLLIN },
+	};
+
+	/* This thread does nothing else */
+	profile_scope_enter(PROFILE_SCOPE_UNPACK);
+
+	for (;;) {
+		if (poll(fds, EINA_C_ARRAY_LENGTH(fds), -1) < 0) {
+			if (errno == EINTR)
+				continue;
+			ERR("Failed to wait for neovim: %s", strerror(errno));
+			break;
+		}
+		if (fds[1].revents != 0)
+			break; /* Stopped */
+		if (fds[0].revents == 0)
+			continue;
+
+		size_t capacity;
+		char *const buf = mpack_stream_reserve(&io->stream, IO_READ_SIZE, &capacity);
+		if (EINA_UNLIKELY(!buf)) {
+			ERR("Memory reallocation of %u bytes failed", IO_READ_SIZE);
+			break;
+		}
+		const ssize_t len = read(io->fd, buf, capacity);
+		if (len > 0) {
+			nvim_record(io->nvim, buf, (size_t)len);
+			mpack_stream_consumed(&io->stream, (size_t)len);
+			__atomic_fetch_add(&io->received, (uint64_t)len, __ATOMIC_RELAXED);
+			if (!_messages_push(io))
+				break;
+		} else if (len == 0) {
+			break; /* Closed */
+		} else if ((errno != EINTR) && (errno != EAGAIN) && (errno != EWOULDBLOCK)) {
+			ERR("Failed to read from neovim: %s", strerror(errno));
+			break;
+		}
+	}
+
+	/* Unless we were stopped, nothing will be read anymore. The main loop is
+	 * told once it has processed what was already pushed. */
+	if (!__atomic_load_n(&io->stop, __ATOMIC_ACQUIRE)) {
+		__atomic_store_n(&io->closed, EINA_TRUE, __ATOMIC_SEQ_CST);
+		ecore_pipe_write(io->wakeup, "", 1u);
+	}
+	return NULL;
+}
+
+/*============================================================================*
+ *                                 Public API                                 *
+ *============================================================================*/
+
+struct nvim_io *nvim_io_new(struct nvim *const nvim, const int fd)
+{
+	struct nvim_io *const io = calloc(1, sizeof(*io));
+	if (EINA_UNLIKELY(!io)) {
+		CRI("Failed to allocate memory");
+		return NULL;
+	}
+	io->nvim = nvim;
+	io->fd = fd;
+
+	mpack_stream_init(&io->stream);
+	if (EINA_UNLIKELY(pipe(io->stop_fds) != 0)) {
+		CRI("Failed to create pipe: %s", strerror(errno));
+		goto free_io;
+	}
+	for (size_t i = 0u; i < EINA_C_ARRAY_LENGTH(io->stop_fds); i++)
+		fcntl(io->stop_fds[i], F_SETFD, FD_CLOEXEC);
+	if (EINA_UNLIKELY(!eina_semaphore_new(&io->room, 0))) {
+		CRI("Failed to create semaphore");
+		goto close_pipe;
+	}
+	io->wakeup = ecore_pipe_add(&_wakeup_cb, io);
+	if (EINA_UNLIKELY(!io->wakeup)) {
+		CRI("Failed to create Ecore_Pipe");
+		goto del_semaphore;
+	}
+	if (EINA_UNLIKELY(!eina_thread_create(&io->thread, EINA_THREAD_NORMAL, -1, &_io_thread,
+					      io))) {
+		CRI("Failed to create the I/O thread");
+		goto del_wakeup;
+	}
+	INF("Neovim's output is read and cut into messages in a thread");
+	return io;
+
+del_wakeup:
+	ecore_pipe_del(io->wakeup);
+del_semaphore:
+	eina_semaphore_free(&io->room);
+close_pipe:
+	close(io->stop_fds[0]);
+	close(io->stop_fds[1]);
+free_io:
+	free(io);
+	return NULL;
+}
+
+void nvim_io_free(struct nvim_io *const io)
+{
+	/* The thread may wait for neovim, or for room in the ring */
+	__atomic_store_n(&io->stop, EINA_TRUE, __ATOMIC_RELEASE);
+	if (EINA_UNLIKELY(write(io->stop_fds[1], "", 1u) != 1))
+		ERR("Failed to stop the I/O thread: %s", strerror(errno));
+	eina_semaphore_release(&io->room, 1);
+	eina_thread_join(io->thread);
+
+	for (unsigned int i = io->head; i != io->tail; i++)
+		free(io->ring[i & (IO_RING_SIZE - 1u)].data);
+	ecore_pipe_del(io->wakeup);
+	eina_semaphore_free(&io->room);
+	close(io->stop_fds[0]);
+	close(io->stop_fds[1]);
+	mpack_stream_flush(&io->stream);
+	free(io);
+}
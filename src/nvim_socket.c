@@ -0,0 +1,238 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#include "eovim/nvim_socket.h"
+#include "eovim/nvim.h"
+#include "eovim/log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/* Size requested for the kernel buffers of the socket. A redraw flood then
+ * fills a whole window of a high latency link, instead of stalling on it. */
+#define SOCKET_BUFFER_SIZE (1 << 20)
+
+struct socket {
+	/* Duplicate of the socket, so the main loop can watch it for writing
+	 * independently of the handler that reads from it */
+	int fd;
+	Ecore_Fd_Handler *handler; /**< Set while bytes are queued */
+	Eina_Binbuf *pending; /**< What the socket could not take yet */
+};
+
+/* Returns how many bytes were written, zero if the socket is full, or -1 on
+ * failure */
+static ssize_t _socket_write(const int fd, const void *const bytes, const size_t size)
+{
+	for (;;) {
+		const ssize_t len = send(fd, bytes, size, MSG_NOSIGNAL);
+		if (len >= 0)
+			return len;
+		if (errno == EINTR)
+			continue;
+		if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+			return 0;
+		ERR("Failed to write to neovim: %s", strerror(errno));
+		return -1;
+	}
+}
+
+static Eina_Bool _socket_writable_cb(void *const data, Ecore_Fd_Handler *const handler EINA_UNUSED)
+{
+	struct socket *const s = data;
+	const size_t size = eina_binbuf_length_get(s->pending);
+	const ssize_t len = _socket_write(s->fd, eina_binbuf_string_get(s->pending), size);
+
+	if (EINA_UNLIKELY(len < 0)) {
+		eina_binbuf_reset(s->pending);
+	} else {
+		eina_binbuf_remove(s->pending, 0u, (size_t)len);
+		if ((size_t)len < size)
+			return ECORE_CALLBACK_RENEW;
+	}
+	s->handler = NULL;
+	return ECORE_CALLBACK_CANCEL;
+}
+
+static Eina_Bool _socket_send(void *const data, const void *const bytes, const size_t size)
+{
+	struct socket *const s = data;
+	size_t sent = 0u;
+
+	/* When bytes are queued, they must go first */
+	if (!s->handler) {
+		const ssize_t len = _socket_write(s->fd, bytes, size);
+		if (EINA_UNLIKELY(len < 0))
+			return EINA_FALSE;
+		sent = (size_t)len;
+		if (sent == size)
+			return EINA_TRUE;
+	}
+
+	if (EINA_UNLIKELY(!eina_binbuf_append_length(s->pending, (const unsigned char *)bytes + sent,
+						     size - sent))) {
+		CRI("Failed to queue %zu bytes", size - sent);
+		return EINA_FALSE;
+	}
+	if (!s->handler) {
+		s->handler = ecore_main_fd_handler_add(s->fd, ECORE_FD_WRITE, &_socket_writable_cb,
+						       s, NULL, NULL);
+		if (EINA_UNLIKELY(!s->handler)) {
+			CRI("Failed to wait for the socket to be writable");
+			eina_binbuf_reset(s->pending);
+			return EINA_FALSE;
+		}
+	}
+	return EINA_TRUE;
+}
+
+static void _socket_free(void *const data)
+{
+	struct socket *const s = data;
+
+	/* Give what is still queued (e.g. :quitall!) a last chance */
+	if (s->handler) {
+		const size_t size = eina_binbuf_length_get(s->pending);
+		if (_socket_write(s->fd, eina_binbuf_string_get(s->pending), size) != (ssize_t)size)
+			WRN("%zu bytes could not be sent to neovim", size);
+		ecore_main_fd_handler_del(s->handler);
+	}
+	eina_binbuf_free(s->pending);
+	close(s->fd);
+	free(s);
+}
+
+/* The buffers are sized before connecting, because the TCP window scale is
+ * negotiated by the handshake */
+static int _socket_new(const int domain, const int type, const int protocol)
+{
+	const int fd = socket(domain, type | SOCK_CLOEXEC, protocol);
+	if (EINA_UNLIKELY(fd < 0))
+		return -1;
+
+	const int size = SOCKET_BUFFER_SIZE;
+	if ((setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) != 0) ||
+	    (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) != 0))
+		WRN("Failed to resize the socket buffers: %s", strerror(errno));
+	return fd;
+}
+
+static int _unix_connect(const char *const path)
+{
+	struct sockaddr_un sun = { .sun_family = AF_UNIX };
+	const size_t len = strlen(path);
+	if (EINA_UNLIKELY(len >= sizeof(sun.sun_path))) {
+		ERR("The socket path '%s' is too long", path);
+		return -1;
+	}
+	memcpy(sun.sun_path, path, len + 1u);
+
+	const int fd = _socket_new(AF_UNIX, SOCK_STREAM, 0);
+	if (EINA_UNLIKELY((fd < 0) || (connect(fd, (struct sockaddr *)&sun, sizeof(sun)) != 0))) {
+		ERR("Failed to connect to '%s': %s", path, strerror(errno));
+		if (fd >= 0)
+			close(fd);
+		return -1;
+	}
+	return fd;
+}
+
+static int _tcp_connect(const char *const addr)
+{
+	/* Split HOST:PORT, where the host may be an IPv6 address in brackets.
+	 * An empty host stands for the loopback interface. */
+	const char *const colon = strrchr(addr, ':');
+	const char *begin = addr;
+	size_t len = (size_t)(colon - addr);
+	if ((len >= 2u) && (addr[0] == '[') && (colon[-1] == ']')) {
+		begin++;
+		len -= 2u;
+	}
+	char host[NI_MAXHOST];
+	if (EINA_UNLIKELY(len >= sizeof(host))) {
+		ERR("The host of '%s' is too long", addr);
+		return -1;
+	}
+	memcpy(host, begin, len);
+	host[len] = '\0';
+
+	const struct addrinfo hints = { .ai_family = AF_UNSPEC, .ai_socktype = SOCK_STREAM };
+	struct addrinfo *res;
+	const int err = getaddrinfo((len) ? host : NULL, colon + 1, &hints, &res);
+	if (EINA_UNLIKELY(err != 0)) {
+		ERR("Failed to resolve '%s': %s", addr, gai_strerror(err));
+		return -1;
+	}
+
+	int fd = -1;
+	int error = 0;
+	for (const struct addrinfo *ai = res; ai && (fd < 0); ai = ai->ai_next) {
+		fd = _socket_new(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+		if ((fd >= 0) && (connect(fd, ai->ai_addr, ai->ai_addrlen) != 0)) {
+			error = errno;
+			close(fd);
+			fd = -1;
+		}
+	}
+	freeaddrinfo(res);
+	if (EINA_UNLIKELY(fd < 0)) {
+		ERR("Failed to connect to '%s': %s", addr, strerror(error));
+		return -1;
+	}
+
+	/* The messages are already batched once per main loop iteration. Holding
+	 * them back again would only add the latency of the link. */
+	const int one = 1;
+	if (setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) != 0)
+		WRN("Failed to disable Nagle's algorithm: %s", strerror(errno));
+	return fd;
+}
+
+int nvim_socket_connect(const char *const addr, struct nvim_transport *const transport)
+{
+	const Eina_Bool unix_socket = (strchr(addr, '/') != NULL) || (strrchr(addr, ':') == NULL);
+	const int fd = (unix_socket) ? _unix_connect(addr) : _tcp_connect(addr);
+	if (fd < 0)
+		return -1;
+
+	const int flags = fcntl(fd, F_GETFL);
+	if (EINA_UNLIKELY((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0))) {
+		ERR("Failed to configure the socket: %s", strerror(errno));
+		goto close_fd;
+	}
+
+	struct socket *const s = calloc(1, sizeof(*s));
+	if (EINA_UNLIKELY(!s)) {
+		CRI("Failed to allocate memory");
+		goto close_fd;
+	}
+	s->fd = fcntl(fd, F_DUPFD_CLOEXEC, 0);
+	if (EINA_UNLIKELY(s->fd < 0)) {
+		ERR("Failed to duplicate the socket: %s", strerror(errno));
+		goto free_socket;
+	}
+	s->pending = eina_binbuf_new();
+	if (EINA_UNLIKELY(!s->pending)) {
+		CRI("Failed to create binbuf");
+		goto close_dup;
+	}
+
+	transport->send = &_socket_send;
+	transport->free = &_socket_free;
+	transport->data = s;
+	INF("Connected to neovim at '%s'", addr);
+	return fd;
+
+close_dup:
+	close(s->fd);
+free_socket:
+	free(s);
+close_fd:
+	close(fd);
+	return -1;
+}
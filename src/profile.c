@@ -0,0 +1,328 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+#include <eovim/profile.h>
+#include <eovim/log.h>
+
+#include <time.h>
+
+Eina_Bool _profile_enabled = EINA_FALSE;
+
+/* Samples are gathered in histograms of 64 buckets. Bucket N holds the
+ * samples that lasted between 2^N and 2^(N+1) nanoseconds. Percentiles are
+ * therefore approximated to the upper bound of their bucket, which is more
+ * than enough to tell where time goes. */
+#define PROFILE_BUCKETS 64u
+
+struct profile_stats {
+	const char *name;
+	uint64_t count;
+	uint64_t total; /**< Nanoseconds */
+	uint64_t max; /**< Nanoseconds */
+	uint64_t buckets[PROFILE_BUCKETS];
+};
+
+/** Map of probe names (by address) to their statistics */
+static Eina_Hash *_stats;
+static uint64_t _counters[PROFILE_COUNTER_LAST];
+static uint64_t _render_start;
+static enum profile_scope _render_scope;
+static uint64_t _since;
+
+static const char *const _counter_names[PROFILE_COUNTER_LAST] = {
+	[PROFILE_COUNTER_BYTES_RECEIVED] = "bytes received",
+	[PROFILE_COUNTER_CELLS_WRITTEN] = "cells written",
+	[PROFILE_COUNTER_EVENTS] = "events decoded",
+	[PROFILE_COUNTER_WAKEUPS] = "main loop wakeups",
+	[PROFILE_COUNTER_BATCHES] = "batches decoded",
+	[PROFILE_COUNTER_BATCHES_ALLOCATING] = "batches that allocated",
+};
+
+static const char *const _scope_names[PROFILE_SCOPE_LAST] = {
+	[PROFILE_SCOPE_OTHER] = "allocs (other)",
+	[PROFILE_SCOPE_UNPACK] = "allocs (unpack)",
+	[PROFILE_SCOPE_DECODE] = "allocs (decode)",
+	[PROFILE_SCOPE_FLUSH] = "allocs (flush)",
+	[PROFILE_SCOPE_RENDER] = "allocs (render)",
+};
+
+/*============================================================================*
+ *                            Allocations Counting                            *
+ *============================================================================*/
+
+static uint64_t _allocations[PROFILE_SCOPE_LAST];
+static __thread enum profile_scope _scope = PROFILE_SCOPE_OTHER;
+static __thread uint64_t _thread_allocations;
+
+#if defined(EOVIM_ALLOC_PROFILE) && defined(__GLIBC__)
+/* The executable interposes the allocator of the whole process, the EFL
+ * included, and forwards to the glibc's. Nothing is counted unless the
+ * profiler is enabled. This is only built in eovim-bench, or when eovim is
+ * configured with WITH_ALLOC_PROFILE: sanitizers and preloaded allocators
+ * must be able to replace the allocator of release builds. free() is not
+ * counted, so it is left alone. */
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static inline void _allocation_count(void)
+{
+	if (EINA_UNLIKELY(_profile_enabled)) {
+		__atomic_fetch_add(&_allocations[_scope], 1u, __ATOMIC_RELAXED);
+		_thread_allocations++;
+	}
+}
+
+void *malloc(size_t size)
+{
+	_allocation_count();
+	return __libc_malloc(size);
+}
+
+void *calloc(size_t nmemb, size_t size)
+{
+	_allocation_count();
+	return __libc_calloc(nmemb, size);
+}
+
+void *realloc(void *ptr, size_t size)
+{
+	_allocation_count();
+	return __libc_realloc(ptr, size);
+}
+#endif
+
+enum profile_scope profile_scope_enter(const enum profile_scope scope)
+{
+	const enum profile_scope previous = _scope;
+	_scope = scope;
+	return previous;
+}
+
+void profile_scope_leave(const enum profile_scope previous)
+{
+	_scope = previous;
+}
+
+Eina_Bool profile_allocations_counted(void)
+{
+#if defined(EOVIM_ALLOC_PROFILE) && defined(__GLIBC__)
+	return EINA_TRUE;
+#else
+	return EINA_FALSE;
+#endif
+}
+
+uint64_t profile_allocations_get(const enum profile_scope scope)
+{
+	if (scope != PROFILE_SCOPE_LAST)
+		return __atomic_load_n(&_allocations[scope], __ATOMIC_RELAXED);
+
+	uint64_t total = 0u;
+	for (unsigned int i = 0u; i < PROFILE_SCOPE_LAST; i++)
+		total += __atomic_load_n(&_allocations[i], __ATOMIC_RELAXED);
+	return total;
+}
+
+/* Batches do not nest, so the scope to restore can be kept aside */
+static enum profile_scope _batch_scope;
+
+uint64_t profile_batch_begin(void)
+{
+	_batch_scope = profile_scope_enter(PROFILE_SCOPE_DECODE);
+	return _thread_allocations;
+}
+
+void profile_batch_end(const uint64_t begin)
+{
+	profile_scope_leave(_batch_scope);
+	_counters[PROFILE_COUNTER_BATCHES]++;
+	if (_thread_allocations != begin)
+		_counters[PROFILE_COUNTER_BATCHES_ALLOCATING]++;
+}
+
+/*============================================================================*
+ *                                   Probes                                   *
+ *============================================================================*/
+
+uint64_t profile_time_get(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * UINT64_C(1000000000) + (uint64_t)ts.tv_nsec;
+}
+
+void profile_enable(void)
+{
+	_profile_enabled = EINA_TRUE;
+}
+
+void profile_record(const char *const name, const uint64_t start)
+{
+	struct profile_stats *stats = eina_hash_find(_stats, &name);
+	if (EINA_UNLIKELY(!stats)) {
+		stats = calloc(1, sizeof(*stats));
+		if (EINA_UNLIKELY(!stats)) {
+			CRI("Failed to allocate memory");
+			return;
+		}
+		stats->name = name;
+		if (EINA_UNLIKELY(!eina_hash_direct_add(_stats, &stats->name, stats))) {
+			CRI("Failed to add item in hash");
+			free(stats);
+			return;
+		}
+	}
+
+	const uint64_t duration = profile_time_get() - start;
+	const unsigned int bucket = 63u - (unsigned int)__builtin_clzll(duration | UINT64_C(1));
+	stats->count++;
+	stats->total += duration;
+	stats->buckets[bucket]++;
+	if (duration > stats->max)
+		stats->max = duration;
+}
+
+void profile_count(const enum profile_counter counter, const uint64_t value)
+{
+	_counters[counter] += value;
+}
+
+uint64_t profile_counter_get(const enum profile_counter counter)
+{
+	return _counters[counter];
+}
+
+Eina_Bool profile_probe_get(const char *const name, uint64_t *const count, uint64_t *const total)
+{
+	*count = *total = 0u;
+	if (!_stats)
+		return EINA_FALSE;
+
+	/* Probes are keyed by address, and the same literal may have several */
+	Eina_Iterator *const it = eina_hash_iterator_data_new(_stats);
+	const struct profile_stats *stats;
+	EINA_ITERATOR_FOREACH(it, stats)
+	{
+		if (!strcmp(stats->name, name)) {
+			*count += stats->count;
+			*total += stats->total;
+		}
+	}
+	eina_iterator_free(it);
+	return (*count != 0u);
+}
+
+static void _render_pre_cb(void *const data EINA_UNUSED, Evas *const evas EINA_UNUSED,
+			   void *const info EINA_UNUSED)
+{
+	_render_start = profile_time_get();
+	_render_scope = profile_scope_enter(PROFILE_SCOPE_RENDER);
+}
+
+static void _render_post_cb(void *const data EINA_UNUSED, Evas *const evas EINA_UNUSED,
+			    void *const info EINA_UNUSED)
+{
+	if (_render_start != 0u)
+		profile_record("evas render", _render_start);
+	_render_start = 0u;
+	profile_scope_leave(_render_scope);
+}
+
+void profile_evas_attach(Evas *const evas)
+{
+	if (!_profile_enabled)
+		return;
+	evas_event_callback_add(evas, EVAS_CALLBACK_RENDER_PRE, &_render_pre_cb, NULL);
+	evas_event_callback_add(evas, EVAS_CALLBACK_RENDER_POST, &_render_post_cb, NULL);
+}
+
+/** @return The upper bound (in microseconds) of the @p percent percentile */
+static double _stats_percentile(const struct profile_stats *const stats, const double percent)
+{
+	const double rank = (double)stats->count * percent;
+	uint64_t seen = 0u;
+	for (unsigned int i = 0u; i < PROFILE_BUCKETS; i++) {
+		seen += stats->buckets[i];
+		if ((double)seen >= rank) {
+			/* Never report more than what was actually observed */
+			const double bound = (double)(UINT64_C(2) << i);
+			return MIN(bound, (double)stats->max) / 1000.0;
+		}
+	}
+	return (double)stats->max / 1000.0;
+}
+
+static int _stats_cmp(const void *const a, const void *const b)
+{
+	const struct profile_stats *const sa = *(const struct profile_stats *const *)a;
+	const struct profile_stats *const sb = *(const struct profile_stats *const *)b;
+	return (sa->total < sb->total) - (sa->total > sb->total);
+}
+
+void profile_dump(void)
+{
+	if (!_profile_enabled) {
+		WRN("The profiler is not enabled. Run eovim with --profile");
+		return;
+	}
+
+	/* Sort the probes by decreasing total time, so the heaviest come first */
+	const unsigned int count = (unsigned int)eina_hash_population(_stats);
+	const struct profile_stats **const sorted = malloc(MAX(count, 1u) * sizeof(*sorted));
+	if (EINA_UNLIKELY(!sorted)) {
+		CRI("Failed to allocate memory");
+		return;
+	}
+	Eina_Iterator *const it = eina_hash_iterator_data_new(_stats);
+	const struct profile_stats *stats;
+	unsigned int i = 0u;
+	EINA_ITERATOR_FOREACH(it, stats)
+	{
+		sorted[i++] = stats;
+	}
+	eina_iterator_free(it);
+	qsort(sorted, count, sizeof(*sorted), &_stats_cmp);
+
+	const double elapsed = (double)(profile_time_get() - _since) / 1e9;
+	fprintf(stderr, "\nEovim profile, over %.3f seconds (timings in microseconds):\n", elapsed);
+	fprintf(stderr, "  %-24s %10s %12s %10s %10s %10s\n", "probe", "count", "total", "p50",
+		"p99", "max");
+	for (i = 0u; i < count; i++) {
+		stats = sorted[i];
+		fprintf(stderr, "  %-24s %10" PRIu64 " %12.1f %10.1f %10.1f %10.1f\n", stats->name,
+			stats->count, (double)stats->total / 1000.0,
+			_stats_percentile(stats, 0.50), _stats_percentile(stats, 0.99),
+			(double)stats->max / 1000.0);
+	}
+	for (i = 0u; i < PROFILE_COUNTER_LAST; i++)
+		fprintf(stderr, "  %-24s %10" PRIu64 "\n", _counter_names[i], _counters[i]);
+	for (i = 0u; profile_allocations_counted() && (i < PROFILE_SCOPE_LAST); i++)
+		fprintf(stderr, "  %-24s %10" PRIu64 "\n", _scope_names[i],
+			profile_allocations_get((enum profile_scope)i));
+	free(sorted);
+}
+
+Eina_Bool profile_init(void)
+{
+	if (!_profile_enabled)
+		return EINA_TRUE;
+
+	_stats = eina_hash_pointer_new(EINA_FREE_CB(free));
+	if (EINA_UNLIKELY(!_stats)) {
+		CRI("Failed to create hash table");
+		_profile_enabled = EINA_FALSE;
+		return EINA_FALSE;
+	}
+	_since = profile_time_get();
+	return EINA_TRUE;
+}
+
+void profile_shutdown(void)
+{
+	if (!_profile_enabled)
+		return;
+
+	profile_dump();
+	eina_hash_free(_stats);
+	_stats = NULL;
+}
@@ -0,0 +1,411 @@
+/* This file is part of Eovim, which is under the MIT License ****************/
+
+/* eovim-stress writes synthetic redraw streams, in the format of the streams
+ * recorded with "eovim --record FILE", so they can be replayed by eovim-bench.
+ * Each frame is a redraw notification closed by a flush. The shape of the
+ * frames is set from the command-line: how many cells each line has, how
+ * many styles they go through, how often the grid scrolls, how many styles
+ * are redefined and how many items the popupmenu shows. The streams are
+ * generated from a seed: the same options always give the same stream, so
+ * the results of eovim-bench can be compared from one build to another. */
+
+#include <eovim/version.h>
+#include <eovim/log.h>
+
+#include <Eina.h>
+#include <Ecore_Getopt.h>
+#include <msgpack.h>
+
+#include <errno.h>
+#include <limits.h>
+
+/* How many styles are defined before the first frame, and later redefined
+ * in turn by --hl-attrs. The lines draw with the first --styles of them. */
+#define STRESS_PALETTE_SIZE 256u
+
+int _eovim_log_domain = -1;
+
+struct workload {
+	unsigned int frames;
+	unsigned int columns;
+	unsigned int rows;
+	unsigned int line_width; /**< Cells of each grid_line */
+	unsigned int lines; /**< Lines drawn by each frame */
+	unsigned int styles; /**< Style runs in each line */
+	unsigned int scrolls; /**< Rows scrolled by each frame */
+	unsigned int hl_attrs; /**< Styles redefined by each frame */
+	unsigned int popupmenu; /**< Items of the popupmenu, shown on each frame */
+	unsigned int seed;
+};
+
+struct stress {
+	const struct workload *work;
+	msgpack_packer pk;
+	uint32_t rand;
+	unsigned int next_row; /**< Row drawn by the next grid_line */
+	unsigned int next_attr; /**< Style redefined next by hl_attr_define */
+};
+
+static const Ecore_Getopt options_desc = {
+	"eovim-stress",
+	"%prog [options] file",
+	EOVIM_VERSION,
+	"(c) 2017-2020 Jean Guyomarc'h and others",
+	"MIT",
+	"Write a synthetic redraw stream, to be replayed by eovim-bench.",
+	EINA_TRUE,
+	{ ECORE_GETOPT_STORE_UINT('n', "frames", "How many frames (i.e. flushes) are written"),
+	  ECORE_GETOPT_CALLBACK_ARGS('g', "geometry", "Size of the grid, in cells (e.g. 120x40)",
+				     "COLUMNSxROWS", &ecore_getopt_callback_size_parse, NULL),
+	  ECORE_GETOPT_STORE_UINT('w', "line-width",
+				  "Cells of each line, at most the width of the grid (default)"),
+	  ECORE_GETOPT_STORE_UINT('l', "lines", "Lines drawn by each frame"),
+	  ECORE_GETOPT_STORE_UINT('s', "styles", "Style changes within each line"),
+	  ECORE_GETOPT_STORE_UINT('\0', "scrolls", "Rows scrolled by each frame"),
+	  ECORE_GETOPT_STORE_UINT('\0', "hl-attrs", "Styles redefined by each frame"),
+	  ECORE_GETOPT_STORE_UINT('\0', "popupmenu",
+				  "Items of the popupmenu shown on each frame (none by default)"),
+	  ECORE_GETOPT_STORE_UINT('\0', "seed", "Seed of the pseudo-random generator"),
+	  ECORE_GETOPT_VERSION('V', "version"), ECORE_GETOPT_HELP('h', "help"),
+	  ECORE_GETOPT_SENTINEL }
+};
+
+/*============================================================================*
+ *                                 Generation                                 *
+ *============================================================================*/
+
+/* xorshift32: the streams must not depend on the libc */
+static uint32_t _random(struct stress *const s)
+{
+	uint32_t x = s->rand;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	s->rand = x;
+	return x;
+}
+
+static void _pack_str(msgpack_packer *const pk, const char *const str, const size_t len)
+{
+	msgpack_pack_str(pk, len);
+	msgpack_pack_str_body(pk, str, len);
+}
+#define PACK_LITERAL(Pk, Str) _pack_str(Pk, "" Str, sizeof(Str) - 1u)
+
+static void _pack_bool(msgpack_packer *const pk, const Eina_Bool value)
+{
+	if (value)
+		msgpack_pack_true(pk);
+	else
+		msgpack_pack_false(pk);
+}
+
+static void _pack_word(struct stress *const s, const unsigned int len)
+{
+	char word[16];
+	for (unsigned int i = 0u; i < len; i++)
+		word[i] = (char)('a' + _random(s) % 26u);
+	_pack_str(&s->pk, word, len);
+}
+
+/* Events are written as [name, args...]: the caller packs the @p count args */
+static void _event_begin(msgpack_packer *const pk, const char *const name, const size_t len,
+			 const unsigned int count)
+{
+	msgpack_pack_array(pk, count + 1u);
+	_pack_str(pk, name, len);
+}
+#define EVENT_BEGIN(Pk, Name, Count) _event_begin(Pk, "" Name, sizeof(Name) - 1u, Count)
+
+static void _hl_attr_define(struct stress *const s, const unsigned int count)
+{
+	msgpack_packer *const pk = &s->pk;
+
+	EVENT_BEGIN(pk, "hl_attr_define", count);
+	for (unsigned int i = 0u; i < count; i++) {
+		const uint32_t bits = _random(s);
+
+		/* [id, rgb_attr, cterm_attr, info]. The styles are numbered from 1:
+		 * style 0 is the default one */
+		msgpack_pack_array(pk, 4);
+		msgpack_pack_unsigned_int(pk, s->next_attr + 1u);
+		s->next_attr = (s->next_attr + 1u) % STRESS_PALETTE_SIZE;
+
+		msgpack_pack_map(pk, 3);
+		PACK_LITERAL(pk, "foreground");
+		msgpack_pack_uint32(pk, bits & 0xffffffu);
+		PACK_LITERAL(pk, "bold");
+		_pack_bool(pk, (bits >> 24u) & 1u);
+		PACK_LITERAL(pk, "italic");
+		_pack_bool(pk, (bits >> 25u) & 1u);
+
+		msgpack_pack_map(pk, 0);
+		msgpack_pack_array(pk, 0);
+	}
+}
+
+static void _grid_line(struct stress *const s, const unsigned int row)
+{
+	const struct workload *const work = s->work;
+	msgpack_packer *const pk = &s->pk;
+	const unsigned int runs = MAX(MIN(work->styles, work->line_width), 1u);
+
+	/* [grid, row, col_start, cells]. Each run of cells starts with its
+	 * style, and ends with blanks, which neovim sends as a repeated cell */
+	msgpack_pack_array(pk, 4);
+	msgpack_pack_unsigned_int(pk, 1);
+	msgpack_pack_unsigned_int(pk, row);
+	msgpack_pack_unsigned_int(pk, 0);
+
+	unsigned int cells = 0u;
+	for (unsigned int i = 0u; i < runs; i++) {
+		const unsigned int len = work->line_width / runs + (i < work->line_width % runs);
+		cells += len - len / 4u + (len >= 4u);
+	}
+	msgpack_pack_array(pk, cells);
+	for (unsigned int i = 0u; i < runs; i++) {
+		const unsigned int len = work->line_width / runs + (i < work->line_width % runs);
+		const unsigned int blanks = len / 4u;
+		const unsigned int style = 1u + _random(s) % MIN(MAX(work->styles, 1u),
+								 STRESS_PALETTE_SIZE);
+
+		for (unsigned int j = 0u; j < len - blanks; j++) {
+			msgpack_pack_array(pk, (j == 0u) ? 2 : 1);
+			_pack_word(s, 1u);
+			if (j == 0u)
+				msgpack_pack_unsigned_int(pk, style);
+		}
+		if (blanks) {
+			msgpack_pack_array(pk, 3);
+			PACK_LITERAL(pk, " ");
+			msgpack_pack_unsigned_int(pk, style);
+			msgpack_pack_unsigned_int(pk, blanks);
+		}
+	}
+}
+
+static void _scroll(struct stress *const s)
+{
+	const struct workload *const work = s->work;
+	msgpack_packer *const pk = &s->pk;
+
+	/* [grid, top, bot, left, right, rows, cols]: one row up, and the row
+	 * that appears at the bottom is drawn */
+	EVENT_BEGIN(pk, "grid_scroll", 1);
+	msgpack_pack_array(pk, 7);
+	msgpack_pack_unsigned_int(pk, 1);
+	msgpack_pack_unsigned_int(pk, 0);
+	msgpack_pack_unsigned_int(pk, work->rows);
+	msgpack_pack_unsigned_int(pk, 0);
+	msgpack_pack_unsigned_int(pk, work->columns);
+	msgpack_pack_int(pk, 1);
+	msgpack_pack_int(pk, 0);
+
+	EVENT_BEGIN(pk, "grid_line", 1);
+	_grid_line(s, work->rows - 1u);
+}
+
+static void _popupmenu_show(struct stress *const s)
+{
+	const struct workload *const work = s->work;
+	msgpack_packer *const pk = &s->pk;
+
+	/* [items, selected, row, col, grid], where items are 4-tuples:
+	 * [word, kind, menu, info] */
+	EVENT_BEGIN(pk, "popupmenu_show", 1);
+	msgpack_pack_array(pk, 5);
+	msgpack_pack_array(pk, work->popupmenu);
+	for (unsigned int i = 0u; i < work->popupmenu; i++) {
+		msgpack_pack_array(pk, 4);
+		_pack_word(s, 4u + _random(s) % 12u);
+		PACK_LITERAL(pk, "v");
+		_pack_word(s, _random(s) % 8u);
+		PACK_LITERAL(pk, "");
+	}
+	msgpack_pack_int(pk, (int)(_random(s) % work->popupmenu));
+	msgpack_pack_unsigned_int(pk, _random(s) % work->rows);
+	msgpack_pack_unsigned_int(pk, _random(s) % work->columns);
+	msgpack_pack_unsigned_int(pk, 1);
+}
+
+static void _cursor_goto_flush(struct stress *const s, const unsigned int row,
+			       const unsigned int col)
+{
+	msgpack_packer *const pk = &s->pk;
+
+	EVENT_BEGIN(pk, "grid_cursor_goto", 1);
+	msgpack_pack_array(pk, 3);
+	msgpack_pack_unsigned_int(pk, 1);
+	msgpack_pack_unsigned_int(pk, row);
+	msgpack_pack_unsigned_int(pk, col);
+
+	EVENT_BEGIN(pk, "flush", 1);
+	msgpack_pack_array(pk, 0);
+}
+
+/* Notifications are written as [type = 2, method, params] */
+static void _redraw_begin(msgpack_packer *const pk, const unsigned int events)
+{
+	msgpack_pack_array(pk, 3);
+	msgpack_pack_int(pk, 2);
+	PACK_LITERAL(pk, "redraw");
+	msgpack_pack_array(pk, events);
+}
+
+/* The colors and the whole palette are defined, and the grid is created */
+static void _preamble_write(struct stress *const s)
+{
+	const struct workload *const work = s->work;
+	msgpack_packer *const pk = &s->pk;
+
+	_redraw_begin(pk, 5);
+	EVENT_BEGIN(pk, "default_colors_set", 1);
+	msgpack_pack_array(pk, 5);
+	msgpack_pack_uint32(pk, 0xffffffu);
+	msgpack_pack_uint32(pk, 0x000000u);
+	msgpack_pack_uint32(pk, 0xff0000u);
+	msgpack_pack_int(pk, 0);
+	msgpack_pack_int(pk, 0);
+
+	_hl_attr_define(s, STRESS_PALETTE_SIZE);
+
+	EVENT_BEGIN(pk, "grid_resize", 1);
+	msgpack_pack_array(pk, 3);
+	msgpack_pack_unsigned_int(pk, 1);
+	msgpack_pack_unsigned_int(pk, work->columns);
+	msgpack_pack_unsigned_int(pk, work->rows);
+
+	_cursor_goto_flush(s, 0u, 0u);
+}
+
+static void _frame_write(struct stress *const s, const unsigned int frame)
+{
+	const struct workload *const work = s->work;
+	msgpack_packer *const pk = &s->pk;
+	const Eina_Bool hide = (work->popupmenu != 0u) && (frame + 1u == work->frames);
+
+	/* Styles first, as neovim does: the lines may use them */
+	_redraw_begin(pk, (work->hl_attrs != 0u) + 2u * work->scrolls + (work->lines != 0u) +
+				  (work->popupmenu != 0u) + hide + 2u);
+	if (work->hl_attrs)
+		_hl_attr_define(s, work->hl_attrs);
+	for (unsigned int i = 0u; i < work->scrolls; i++)
+		_scroll(s);
+	if (work->lines) {
+		EVENT_BEGIN(pk, "grid_line", work->lines);
+		for (unsigned int i = 0u; i < work->lines; i++) {
+			_grid_line(s, s->next_row);
+			s->next_row = (s->next_row + 1u) % work->rows;
+		}
+	}
+	if (work->popupmenu) {
+		_popupmenu_show(s);
+		if (hide) {
+			EVENT_BEGIN(pk, "popupmenu_hide", 1);
+			msgpack_pack_array(pk, 0);
+		}
+	}
+	_cursor_goto_flush(s, s->next_row, _random(s) % work->columns);
+}
+
+static Eina_Bool _stream_write(const struct workload *const work, const char *const path)
+{
+	FILE *const file = fopen(path, "wb");
+	if (EINA_UNLIKELY(!file)) {
+		CRI("Failed to open '%s': %s", path, strerror(errno));
+		return EINA_FALSE;
+	}
+
+	/* xorshift32 never leaves 0 */
+	struct stress s = {
+		.work = work,
+		.rand = (work->seed) ? work->seed : 1u,
+	};
+	msgpack_packer_init(&s.pk, file, &msgpack_fbuffer_write);
+
+	_preamble_write(&s);
+	for (unsigned int i = 0u; i < work->frames; i++)
+		_frame_write(&s, i);
+
+	const Eina_Bool ok = !ferror(file);
+	if (EINA_UNLIKELY((fclose(file) != 0) || !ok)) {
+		CRI("Failed to write '%s'", path);
+		return EINA_FALSE;
+	}
+	return EINA_TRUE;
+}
+
+/*============================================================================*
+ *                                    Main                                    *
+ *============================================================================*/
+
+int main(int argc, char **argv)
+{
+	Eina_Rectangle geometry = { 0, 0, 120, 40 };
+	struct workload work = {
+		.frames = 1000u,
+		.styles = 8u,
+		.seed = 0x5eed,
+	};
+	unsigned int line_width = 0u;
+	unsigned int lines = UINT_MAX;
+	Eina_Bool quit = EINA_FALSE;
+	Ecore_Getopt_Value values[] = { ECORE_GETOPT_VALUE_UINT(work.frames),
+					ECORE_GETOPT_VALUE_PTR_CAST(geometry),
+					ECORE_GETOPT_VALUE_UINT(line_width),
+					ECORE_GETOPT_VALUE_UINT(lines),
+					ECORE_GETOPT_VALUE_UINT(work.styles),
+					ECORE_GETOPT_VALUE_UINT(work.scrolls),
+					ECORE_GETOPT_VALUE_UINT(work.hl_attrs),
+					ECORE_GETOPT_VALUE_UINT(work.popupmenu),
+					ECORE_GETOPT_VALUE_UINT(work.seed),
+					ECORE_GETOPT_VALUE_BOOL(quit),
+					ECORE_GETOPT_VALUE_BOOL(quit),
+					ECORE_GETOPT_VALUE_NONE };
+	int return_code = EXIT_FAILURE;
+
+	if (EINA_UNLIKELY(!eina_init())) {
+		EINA_LOG_CRIT("Failed to initialize Eina");
+		goto end;
+	}
+	_eovim_log_domain = eina_log_domain_register("eovim-stress", EINA_COLOR_RED);
+	if (EINA_UNLIKELY(_eovim_log_domain < 0)) {
+		EINA_LOG_CRIT("Failed to create log domain");
+		goto eina_shutdown;
+	}
+
+	const int args = ecore_getopt_parse(&options_desc, values, argc, argv);
+	if (args < 0) {
+		CRI("Failed to parser command-line options");
+		goto log_unregister;
+	}
+	if (quit) {
+		return_code = EXIT_SUCCESS;
+		goto log_unregister;
+	}
+	if (args + 1 != argc) {
+		CRI("Exactly one file to write is expected");
+		goto log_unregister;
+	}
+	if (EINA_UNLIKELY((geometry.w <= 0) || (geometry.h <= 0))) {
+		CRI("Invalid geometry %ix%i", geometry.w, geometry.h);
+		goto log_unregister;
+	}
+
+	/* Lines and rows are capped by the grid */
+	work.columns = (unsigned int)geometry.w;
+	work.rows = (unsigned int)geometry.h;
+	work.line_width = (line_width) ? MIN(line_width, work.columns) : work.columns;
+	work.lines = MIN(lines, work.rows);
+	work.scrolls = MIN(work.scrolls, work.rows);
+
+	if (_stream_write(&work, argv[args]))
+		return_code = EXIT_SUCCESS;
+
+log_unregister:
+	eina_log_domain_unregister(_eovim_log_domain);
+eina_shutdown:
+	eina_shutdown();
+end:
+	return return_code;
+}